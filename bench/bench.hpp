@@ -0,0 +1,108 @@
+/**
+ * Copyright 2020 Lorenzo Rai
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This file contains a minimal throughput benchmark harness.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include <nlane/transactional/transactional.hpp>
+
+namespace nlane_bench {
+
+// Global benchmark settings. Can be changed from the command line.
+struct Settings {
+    size_t num_threads{ 0u };
+    std::chrono::milliseconds duration{ 500 };
+};
+
+extern Settings settings;
+
+/**
+ * Runs func repeatedly on settings.num_threads threads for settings.duration.
+ * func is called with the index of the calling thread. Each thread is initialized for
+ * transactional memory before the measurement starts.
+ *
+ * \returns The number of completed calls per second over all threads.
+ */
+template<class _Cl>
+inline double RunThroughput(_Cl func);
+
+// Prints a single result line
+inline void Report(const char* suite, const char* name, double ops_per_second);
+
+void RunTransactionalBenchmarks();
+
+
+//
+// Inline function definitions
+//
+
+template<class _Cl>
+inline double RunThroughput(_Cl func) {
+    const size_t num_threads{ settings.num_threads };
+
+    std::atomic<bool> run{ false };
+    std::atomic<bool> stop{ false };
+    std::vector<uint64_t> counts(num_threads * 8u, 0u); // Padded to prevent false sharing
+    std::vector<std::thread> threads;
+
+    for(size_t t{ 0 }; t < num_threads; t++) {
+        threads.emplace_back([&, t]() {
+            nlane::tr::ThreadInit();
+
+            while(!run.load()) {
+            }
+
+            uint64_t count{ 0u };
+            while(!stop.load(std::memory_order_relaxed)) {
+                func(t);
+                count++;
+            }
+            counts[t * 8u] = count;
+        });
+    }
+
+    auto start{ std::chrono::steady_clock::now() };
+    run.store(true);
+    std::this_thread::sleep_for(settings.duration);
+    stop.store(true);
+
+    for(std::thread& t : threads) {
+        t.join();
+    }
+    std::chrono::duration<double> elapsed{ std::chrono::steady_clock::now() - start };
+
+    uint64_t total{ 0u };
+    for(size_t t{ 0 }; t < num_threads; t++) {
+        total += counts[t * 8u];
+    }
+    return static_cast<double>(total) / elapsed.count();
+}
+
+inline void Report(const char* suite, const char* name, double ops_per_second) {
+    std::printf("%-16s %-40s %14.0f ops/s\n", suite, name, ops_per_second);
+}
+
+} // namespace nlane_bench
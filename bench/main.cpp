@@ -0,0 +1,44 @@
+/**
+ * Copyright 2020 Lorenzo Rai
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdlib>
+
+#include "bench.hpp"
+
+namespace nlane_bench {
+Settings settings;
+}
+
+// Usage: nlane_bench [num_threads] [duration_ms]
+int main(int argc, char **argv) {
+    using namespace nlane_bench;
+
+    settings.num_threads = std::thread::hardware_concurrency();
+    if(argc > 1) {
+        settings.num_threads = std::strtoul(argv[1], nullptr, 10);
+    }
+    if(argc > 2) {
+        settings.duration = std::chrono::milliseconds{ std::strtoul(argv[2], nullptr, 10) };
+    }
+    if(settings.num_threads == 0u) {
+        settings.num_threads = 1u;
+    }
+
+    std::printf("threads: %zu, duration: %lldms\n", settings.num_threads, static_cast<long long>(settings.duration.count()));
+
+    RunTransactionalBenchmarks();
+    return 0;
+}
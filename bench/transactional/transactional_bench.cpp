@@ -0,0 +1,198 @@
+/**
+ * Copyright 2020 Lorenzo Rai
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+
+#include <nlane/transactional/transactional.hpp>
+#include <nlane/util/numa.hpp>
+#include <nlane/util/random.hpp>
+
+#include "bench.hpp"
+
+namespace nlane_bench {
+
+using namespace nlane;
+
+namespace {
+
+constexpr size_t kNumWords{ 1024u };
+
+struct Algorithm {
+    const char* name;
+    tr::Algorithm algorithm;
+};
+
+constexpr Algorithm kAlgorithms[]{
+    { "lock_table", tr::Algorithm::LOCK_TABLE },
+    { "ring", tr::Algorithm::RING },
+    { "seq_lock", tr::Algorithm::SEQ_LOCK },
+    { "serial", tr::Algorithm::SERIAL },
+};
+
+/**
+ * Every transaction reads num_reads random words. One in write_period transactions
+ * additionally moves a value between two words.
+ */
+double ReadMostly(uint64_t* words, size_t num_reads, uint64_t write_period) {
+    return RunThroughput([=](size_t) {
+        const bool write{ (util::Rand() % write_period) == 0u };
+        const size_t first{ util::Rand() % kNumWords };
+
+        tr::Atomic([&]() {
+            uint64_t sum{ 0u };
+            for(size_t i{ 0 }; i < num_reads; i++) {
+                sum += tr::Read(words + ((first + i * 7u) % kNumWords));
+            }
+
+            if(write) {
+                uint64_t v{ tr::Read(words + first) };
+                tr::Write(words + first, v - 1u);
+                tr::Write(words + ((first + 1u) % kNumWords), sum - v + 1u);
+            }
+        });
+    });
+}
+
+/**
+ * Like ReadMostly without writes but all reads go through the transaction handle.
+ */
+double ReadOnlyHandle(uint64_t* words, size_t num_reads) {
+    return RunThroughput([=](size_t) {
+        const size_t first{ util::Rand() % kNumWords };
+
+        tr::AtomicRead([&](tr::Transaction& tx) {
+            uint64_t sum{ 0u };
+            for(size_t i{ 0 }; i < num_reads; i++) {
+                sum += tx.Read(words + ((first + i * 7u) % kNumWords));
+            }
+            (void)sum;
+        });
+    });
+}
+
+/**
+ * Every transaction moves a value between two random words.
+ */
+double Transfer(uint64_t* words) {
+    return RunThroughput([=](size_t) {
+        const size_t e1{ util::Rand() % kNumWords };
+        const size_t e2{ (e1 + 1u + util::Rand() % (kNumWords - 1u)) % kNumWords };
+
+        tr::Atomic([&]() {
+            uint64_t v1{ tr::Read(words + e1) };
+            uint64_t v2{ tr::Read(words + e2) };
+            tr::Write(words + e1, v1 - 1u);
+            tr::Write(words + e2, v2 + 1u);
+        });
+    });
+}
+
+/**
+ * Every transaction increments all words of a random contiguous block of block_words words.
+ */
+double BulkUpdate(uint64_t* words, size_t block_words) {
+    return RunThroughput([=](size_t) {
+        uint64_t* block{ words + (util::Rand() % (kNumWords / block_words)) * block_words };
+
+        tr::Atomic([&]() {
+            for(size_t i{ 0 }; i < block_words; i++) {
+                tr::Write(block + i, tr::Read(block + i) + 1u);
+            }
+        });
+    });
+}
+
+/**
+ * Every call moves values between group_size pairs of random words, either with one transaction
+ * per pair or through a batch.
+ */
+double GroupedTransfer(uint64_t* words, size_t group_size, bool batched) {
+    return RunThroughput([=](size_t) {
+        thread_local tr::Batch batch{ group_size };
+        for(size_t n{ 0 }; n < group_size; n++) {
+            const size_t e1{ util::Rand() % kNumWords };
+            const size_t e2{ (e1 + 1u + util::Rand() % (kNumWords - 1u)) % kNumWords };
+
+            auto transfer{ [=]() {
+                uint64_t v1{ tr::Read(words + e1) };
+                uint64_t v2{ tr::Read(words + e2) };
+                tr::Write(words + e1, v1 - 1u);
+                tr::Write(words + e2, v2 + 1u);
+            } };
+
+            if(batched) {
+                batch.Add(transfer);
+            } else {
+                tr::Atomic(transfer);
+            }
+        }
+        batch.Flush();
+    });
+}
+
+/**
+ * Runs the transfer workload from node 0 on words placed on node. The words get their own domain
+ * whose locks are placed on the same node.
+ */
+double NumaTransfer(const char* domain_name, size_t node) {
+    const size_t size{ kNumWords * sizeof(uint64_t) };
+    uint64_t* words{ static_cast<uint64_t*>(util::AllocateOnNode(size, node)) };
+
+    const tr::Domain domain{ tr::CreateDomain(domain_name, kNumWords) };
+    tr::AssignDomain(domain, words, size);
+    tr::SetDomainNode(domain, node);
+
+    // The benchmark threads inherit the affinity of this thread
+    util::RunOnNode(0u);
+    const double ops{ Transfer(words) };
+    util::RunOnNode(util::kAnyNode);
+
+    util::Free(words, size);
+    return ops;
+}
+
+} // namespace
+
+void RunTransactionalBenchmarks() {
+    // One extra cache line so the words can start at a cache line boundary
+    std::unique_ptr<uint64_t[]> storage{ new uint64_t[kNumWords + 8u]{} };
+
+    void* aligned{ storage.get() };
+    size_t space{ (kNumWords + 8u) * sizeof(uint64_t) };
+    uint64_t* words{ static_cast<uint64_t*>(std::align(64u, kNumWords * sizeof(uint64_t), aligned, space)) };
+
+    for(const Algorithm& algorithm : kAlgorithms) {
+        tr::SetAlgorithm(algorithm.algorithm);
+
+        Report(algorithm.name, "read_only_32", ReadMostly(words, 32u, ~static_cast<uint64_t>(0u)));
+        Report(algorithm.name, "read_only_32_handle", ReadOnlyHandle(words, 32u));
+        Report(algorithm.name, "read_mostly_32", ReadMostly(words, 32u, 50u));
+        Report(algorithm.name, "read_mostly_128", ReadMostly(words, 128u, 50u));
+        Report(algorithm.name, "transfer", Transfer(words));
+        Report(algorithm.name, "bulk_update_32", BulkUpdate(words, 32u));
+    }
+
+    tr::SetAlgorithm(tr::Algorithm::LOCK_TABLE);
+
+    Report("batch", "transfer_8_single", GroupedTransfer(words, 8u, false));
+    Report("batch", "transfer_8_batched", GroupedTransfer(words, 8u, true));
+
+    // On single node systems both run locally
+    Report("numa", "transfer_local", NumaTransfer("numa_local", 0u));
+    Report("numa", "transfer_remote", NumaTransfer("numa_remote", util::GetNumNodes() - 1u));
+}
+
+} // namespace nlane_bench
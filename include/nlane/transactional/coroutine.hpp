@@ -0,0 +1,519 @@
+/**
+ * Copyright 2020 Lorenzo Rai
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This file contains transactions that run inside C++20 coroutines.
+ *
+ * The transactions of Atomic are bound to the engine of their thread and can not survive a
+ * suspension. The transaction of CoAtomic is bound to a detached engine owned by its coroutine
+ * frame instead, so the coroutine may suspend inside it and resume on any other thread. Detached
+ * engines always use the lock table algorithm.
+ *
+ * The library itself is built as C++17. The detached transaction interface below is always
+ * available, the coroutine types only if the including code is compiled with coroutine support.
+ */
+
+#pragma once
+
+#include "transactional.hpp"
+
+namespace nlane::transactional {
+
+// Continues a coroutine woken from Retry by calling resume with frame, on any thread
+using ResumeExecutor = void (*)(void (*resume)(void* frame), void* frame);
+
+/**
+ * Hands the coroutines woken from Retry to executor instead of resuming them on the committing
+ * thread, so commits do not run the woken coroutines themselves. Executors must not throw and
+ * must not block on transactions. nullptr restores the default.
+ */
+void SetResumeExecutor(ResumeExecutor executor);
+
+} // namespace nlane::transactional
+
+namespace nlane::transactional::detail {
+
+// A transaction bound to a coroutine frame instead of a thread
+struct DetachedTransaction;
+
+// Takes a detached transaction from the pool. Allocates and registers a new engine if the pool is empty.
+DetachedTransaction* CreateDetached();
+
+// Ends the running transaction of detached and returns it to the pool
+void DestroyDetached(DetachedTransaction* detached) noexcept;
+
+/**
+ * Starts a new transaction on detached or restarts it after an abort.
+ *
+ * \throw TransactionError If the lock table is not the active algorithm or the calling thread is
+ * running a transaction itself.
+ */
+void BeginDetached(DetachedTransaction& detached);
+
+// Commits the transaction of detached and wakes the waiters of the written locations up
+void CommitDetached(DetachedTransaction& detached);
+
+// Rolls the transaction of detached back if it is running
+void EndDetached(DetachedTransaction& detached) noexcept;
+
+Word DetachedReadWord(DetachedTransaction& detached, void* address);
+void DetachedWriteWord(DetachedTransaction& detached, void* address, Word data, Word mask);
+
+// Aborts the transaction of detached with a retry error and remembers that Retry has been called
+[[noreturn]] void RetryDetached(DetachedTransaction& detached);
+
+// Returns true if RetryDetached has been called since the transaction has been started and resets the request
+bool TakeDetachedRetryRequest(DetachedTransaction& detached);
+
+/**
+ * Ends the transaction of detached and registers it as waiting for the locations it has read.
+ * The first commit to one of them hands resume and frame to the resume executor once its
+ * transaction has finished. Without an executor it calls resume with frame itself, after the
+ * outer most deferral of the committing thread has ended.
+ *
+ * \returns False if a location has already changed, the caller must then restart right away.
+ */
+bool SuspendDetached(DetachedTransaction& detached, void (*resume)(void* frame), void* frame);
+
+} // namespace nlane::transactional::detail
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+
+namespace nlane::transactional {
+
+template<class _Ty = void>
+class CoTask;
+
+namespace detail {
+
+// Transfers control to the awaiting coroutine once a task has finished
+struct FinalAwaiter {
+	inline bool await_ready() const noexcept;
+
+	template<class _Promise>
+	inline std::coroutine_handle<> await_suspend(std::coroutine_handle<_Promise> handle) const noexcept;
+
+	inline void await_resume() const noexcept;
+};
+
+class CoPromiseBase {
+  private:
+	std::coroutine_handle<> continuation_{ std::noop_coroutine() };
+	std::exception_ptr error_;
+
+  public:
+	inline std::suspend_always initial_suspend() const noexcept;
+	inline FinalAwaiter final_suspend() const noexcept;
+	inline void unhandled_exception() noexcept;
+
+	inline void SetContinuation(std::coroutine_handle<> continuation) noexcept;
+	inline std::coroutine_handle<> GetContinuation() const noexcept;
+
+	// Rethrows the exception the task has finished with, if any
+	inline void RethrowError() const;
+};
+
+template<class _Ty>
+class CoPromise : public CoPromiseBase {
+  private:
+	std::optional<_Ty> value_;
+
+  public:
+	inline CoTask<_Ty> get_return_object() noexcept;
+
+	template<class _Value>
+	inline void return_value(_Value&& value);
+
+	inline _Ty TakeResult();
+};
+
+template<>
+class CoPromise<void> : public CoPromiseBase {
+  public:
+	inline CoTask<void> get_return_object() noexcept;
+	inline void return_void() const noexcept;
+	inline void TakeResult() const;
+};
+
+// Owns a pooled detached transaction for the lifetime of the coroutine frame of CoAtomic
+class DetachedHolder {
+  private:
+	DetachedTransaction* detached_;
+
+  public:
+	inline DetachedHolder();
+	inline ~DetachedHolder();
+
+	DetachedHolder(const DetachedHolder&) = delete;
+	DetachedHolder& operator=(const DetachedHolder&) = delete;
+
+	inline DetachedTransaction& Get() const;
+};
+
+// Returned by CoTransaction::Retry. Awaiting it aborts the transaction.
+struct [[nodiscard]] RetryRequest {
+	DetachedTransaction& detached;
+
+	inline bool await_ready() const noexcept;
+	inline void await_suspend(std::coroutine_handle<>) const noexcept;
+	[[noreturn]] inline void await_resume() const;
+};
+
+// Suspends the coroutine of CoAtomic until a location read by the transaction has been written
+struct RetryAwaiter {
+	DetachedTransaction& detached;
+
+	inline bool await_ready() const noexcept;
+	inline bool await_suspend(std::coroutine_handle<> handle) const;
+	inline void await_resume() const noexcept;
+
+	static inline void Resume(void* frame);
+};
+
+} // namespace detail
+
+/**
+ * A lazily started coroutine producing a value of type _Ty. Starts when it is awaited and resumes
+ * the awaiting coroutine once it has finished. Exceptions are rethrown to the awaiting coroutine.
+ */
+template<class _Ty>
+class [[nodiscard]] CoTask {
+  public:
+	using promise_type = detail::CoPromise<_Ty>;
+	using ResultType = _Ty;
+
+  private:
+	std::coroutine_handle<promise_type> handle_;
+
+  public:
+	inline explicit CoTask(std::coroutine_handle<promise_type> handle) noexcept;
+	inline CoTask(CoTask&& other) noexcept;
+	inline ~CoTask();
+
+	CoTask(const CoTask&) = delete;
+	CoTask& operator=(const CoTask&) = delete;
+	CoTask& operator=(CoTask&&) = delete;
+
+	inline bool await_ready() const noexcept;
+	inline std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) const noexcept;
+	inline _Ty await_resume() const;
+};
+
+/**
+ * A handle to the transaction of CoAtomic. Passed to its function and valid until the task
+ * returned by the function has finished, on whichever thread it is resumed.
+ */
+class CoTransaction {
+  private:
+	detail::DetachedTransaction* detached_;
+
+  public:
+	// Created by CoAtomic
+	inline explicit CoTransaction(detail::DetachedTransaction& detached);
+
+	CoTransaction(const CoTransaction&) = delete;
+	CoTransaction& operator=(const CoTransaction&) = delete;
+
+	/**
+	 * Atomically reads the word at specified address. See tr::ReadWord.
+	 *
+	 * \throw TransactionError If an error occured. Must be forwarded so the transaction can restart.
+	 */
+	inline Word ReadWord(void* address);
+
+	/**
+	 * Atomically writes the bits in mask of the word at specified address. See tr::WriteWord.
+	 *
+	 * \throw TransactionError If an error occured. Must be forwarded so the transaction can restart.
+	 */
+	inline void WriteWord(void* address, Word data, Word mask);
+
+	// Atomically reads the variable at specified address. See tr::Read.
+	template<typename _Ty, std::enable_if_t<!std::is_pointer_v<_Ty>, int> = 0>
+	inline _Ty Read(_Ty* addr);
+
+	// Atomically writes the variable at specified address. See tr::Write.
+	template<typename _Ty, std::enable_if_t<!std::is_pointer_v<_Ty>, int> = 0>
+	inline void Write(_Ty* addr, _Ty data);
+
+	// Atomically reads the pointer at specified address. See tr::Read.
+	template<typename _Ty>
+	inline _Ty* Read(_Ty** addr);
+
+	// Atomically writes the pointer at specified address. See tr::Write.
+	template<typename _Ty>
+	inline void Write(_Ty** addr, _Ty* data);
+
+	/**
+	 * Like tr::Retry, but the coroutine is suspended instead of blocking its thread. Must be
+	 * awaited: co_await transaction.Retry(); aborts the transaction and the coroutine is resumed
+	 * by the first commit that writes a location the transaction has read. It runs on the
+	 * committing thread once the committing Atomic has returned, or on the executor set with
+	 * SetResumeExecutor. The transaction then restarts.
+	 */
+	inline detail::RetryRequest Retry();
+};
+
+/**
+ * Atomically executes the task returned by func(CoTransaction&), which may suspend and resume on
+ * other threads. The task is recreated for every restart so func may be called multiple times.
+ * Returns a task producing the result of the last attempt. Only one of its attempts is ever
+ * committed.
+ *
+ * - Detached transactions always run on the lock table algorithm. Starting one while another
+ *   algorithm is active throws, so adaptive algorithm selection should be disabled.
+ * - Memory is only accessed through the CoTransaction handle. Thread transactions, Allocate,
+ *   registered regions and deferred actions are not part of the transaction, and CoAtomic must
+ *   not be awaited inside the function of another CoAtomic.
+ * - Every running transaction occupies a thread id. Locks acquired at encounter time and the
+ *   activity that delays algorithm switches and privatization fences are held across suspensions,
+ *   so coroutines should only suspend briefly inside a transaction. Version rollovers, stripe
+ *   remapping and adaptive switches are postponed while detached transactions are running.
+ * - The task must not be destroyed while it is suspended in Retry.
+ *
+ * \throw TransactionError If the transaction fails with an error that can not be retried.
+ */
+template<class _Cl>
+std::invoke_result_t<_Cl&, CoTransaction&> CoAtomic(_Cl func);
+
+
+//
+// Inline function definitions
+//
+
+namespace detail {
+
+bool FinalAwaiter::await_ready() const noexcept {
+	return false;
+}
+
+template<class _Promise>
+std::coroutine_handle<> FinalAwaiter::await_suspend(std::coroutine_handle<_Promise> handle) const noexcept {
+	return handle.promise().GetContinuation();
+}
+
+void FinalAwaiter::await_resume() const noexcept {
+}
+
+std::suspend_always CoPromiseBase::initial_suspend() const noexcept {
+	return {};
+}
+
+FinalAwaiter CoPromiseBase::final_suspend() const noexcept {
+	return {};
+}
+
+void CoPromiseBase::unhandled_exception() noexcept {
+	error_ = std::current_exception();
+}
+
+void CoPromiseBase::SetContinuation(std::coroutine_handle<> continuation) noexcept {
+	continuation_ = continuation;
+}
+
+std::coroutine_handle<> CoPromiseBase::GetContinuation() const noexcept {
+	return continuation_;
+}
+
+void CoPromiseBase::RethrowError() const {
+	if (error_) {
+		std::rethrow_exception(error_);
+	}
+}
+
+template<class _Ty>
+CoTask<_Ty> CoPromise<_Ty>::get_return_object() noexcept {
+	return CoTask<_Ty>{ std::coroutine_handle<CoPromise>::from_promise(*this) };
+}
+
+template<class _Ty>
+template<class _Value>
+void CoPromise<_Ty>::return_value(_Value&& value) {
+	value_.emplace(std::forward<_Value>(value));
+}
+
+template<class _Ty>
+_Ty CoPromise<_Ty>::TakeResult() {
+	RethrowError();
+	return std::move(*value_);
+}
+
+CoTask<void> CoPromise<void>::get_return_object() noexcept {
+	return CoTask<void>{ std::coroutine_handle<CoPromise>::from_promise(*this) };
+}
+
+void CoPromise<void>::return_void() const noexcept {
+}
+
+void CoPromise<void>::TakeResult() const {
+	RethrowError();
+}
+
+DetachedHolder::DetachedHolder() : detached_{ CreateDetached() } {
+}
+
+DetachedHolder::~DetachedHolder() {
+	DestroyDetached(detached_);
+}
+
+DetachedTransaction& DetachedHolder::Get() const {
+	return *detached_;
+}
+
+bool RetryRequest::await_ready() const noexcept {
+	return true;
+}
+
+void RetryRequest::await_suspend(std::coroutine_handle<>) const noexcept {
+}
+
+void RetryRequest::await_resume() const {
+	RetryDetached(detached);
+}
+
+bool RetryAwaiter::await_ready() const noexcept {
+	return false;
+}
+
+bool RetryAwaiter::await_suspend(std::coroutine_handle<> handle) const {
+	// The coroutine may be resumed on another thread before this returns
+	return SuspendDetached(detached, Resume, handle.address());
+}
+
+void RetryAwaiter::await_resume() const noexcept {
+}
+
+void RetryAwaiter::Resume(void* frame) {
+	std::coroutine_handle<>::from_address(frame).resume();
+}
+
+} // namespace detail
+
+template<class _Ty>
+CoTask<_Ty>::CoTask(std::coroutine_handle<promise_type> handle) noexcept : handle_{ handle } {
+}
+
+template<class _Ty>
+CoTask<_Ty>::CoTask(CoTask&& other) noexcept : handle_{ std::exchange(other.handle_, nullptr) } {
+}
+
+template<class _Ty>
+CoTask<_Ty>::~CoTask() {
+	if (handle_) {
+		handle_.destroy();
+	}
+}
+
+template<class _Ty>
+bool CoTask<_Ty>::await_ready() const noexcept {
+	return false;
+}
+
+template<class _Ty>
+std::coroutine_handle<> CoTask<_Ty>::await_suspend(std::coroutine_handle<> awaiting) const noexcept {
+	handle_.promise().SetContinuation(awaiting);
+	return handle_;
+}
+
+template<class _Ty>
+_Ty CoTask<_Ty>::await_resume() const {
+	return handle_.promise().TakeResult();
+}
+
+CoTransaction::CoTransaction(detail::DetachedTransaction& detached) : detached_{ &detached } {
+}
+
+Word CoTransaction::ReadWord(void* address) {
+	return detail::DetachedReadWord(*detached_, address);
+}
+
+void CoTransaction::WriteWord(void* address, Word data, Word mask) {
+	detail::DetachedWriteWord(*detached_, address, data, mask);
+}
+
+template<typename _Ty, std::enable_if_t<!std::is_pointer_v<_Ty>, int>>
+_Ty CoTransaction::Read(_Ty* addr) {
+	return detail::ReadVariable(*this, addr);
+}
+
+template<typename _Ty, std::enable_if_t<!std::is_pointer_v<_Ty>, int>>
+void CoTransaction::Write(_Ty* addr, _Ty data) {
+	detail::WriteVariable(*this, addr, data);
+}
+
+template<typename _Ty>
+_Ty* CoTransaction::Read(_Ty** addr) {
+	return reinterpret_cast<_Ty*>(Read<size_t>(reinterpret_cast<size_t*>(addr)));
+}
+
+template<typename _Ty>
+void CoTransaction::Write(_Ty** addr, _Ty* data) {
+	Write<size_t>(reinterpret_cast<size_t*>(addr), reinterpret_cast<size_t>(data));
+}
+
+detail::RetryRequest CoTransaction::Retry() {
+	return detail::RetryRequest{ *detached_ };
+}
+
+template<class _Cl>
+std::invoke_result_t<_Cl&, CoTransaction&> CoAtomic(_Cl func) {
+	using Result = typename std::invoke_result_t<_Cl&, CoTransaction&>::ResultType;
+
+	detail::DetachedHolder holder{};
+	detail::DetachedTransaction& detached{ holder.Get() };
+	CoTransaction transaction{ detached };
+
+	while (true) {
+		detail::BeginDetached(detached);
+
+		// Coroutines can not suspend inside a handler so the wait happens after it
+		bool wait{ false };
+		try {
+			if constexpr (std::is_void_v<Result>) {
+				co_await func(transaction);
+				detail::CommitDetached(detached);
+				co_return;
+			} else {
+				Result result{ co_await func(transaction) };
+				detail::CommitDetached(detached);
+				co_return result;
+			}
+		}
+		catch (TransactionError& error) {
+			if (!error.shouldRetry()) {
+				detail::EndDetached(detached);
+				throw;
+			}
+			wait = detail::TakeDetachedRetryRequest(detached);
+		}
+		catch (...) {
+			detail::EndDetached(detached);
+			throw;
+		}
+
+		if (wait) {
+			co_await detail::RetryAwaiter{ detached };
+		}
+	}
+}
+
+} // namespace nlane::transactional
+
+#endif
@@ -0,0 +1,163 @@
+/**
+ * Copyright 2020 Lorenzo Rai
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This file contains the runtime dispatch of transactional operations to the engine of the
+ * active algorithm as well as the adaptive algorithm selection.
+ *
+ * The active algorithm is only ever switched at quiescent points, i.e. while no transaction
+ * is running on any thread. A transaction therefore always sees the same dispatch table.
+ * Version rollovers are performed at the same quiescent points.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "transactional.hpp"
+
+namespace nlane::transactional::detail {
+
+/**
+ * The operations of an algorithm. Every call through the table costs exactly one indirect call,
+ * the engine code itself is inlined into the table functions.
+ */
+struct Dispatch {
+	Algorithm algorithm;
+
+	PromotionState (*is_read_write_compatible)();
+	PromotionState (*is_read_only_compatible)();
+
+	void (*begin_read_write)();
+	void (*begin_read_only)();
+	void (*begin_elastic)();
+	void (*begin_snapshot)();
+
+	void (*commit)();
+	void (*end)();
+
+	Word (*read_word)(void* address);
+	void (*write_word)(void* address, Word data, Word mask);
+	void (*release)(void* address);
+
+	// Used by Transaction handles which look up the thread engine once
+	void* (*get_engine)();
+	Word (*engine_read_word)(void* engine, void* address);
+	void (*engine_write_word)(void* engine, void* address, Word data, Word mask);
+};
+
+/**
+ * Statistics measured by the adaptive runtime.
+ */
+struct AlgorithmStats {
+	uint64_t commits{ 0u };
+	uint64_t aborts{ 0u };
+	uint64_t reads{ 0u };
+	uint64_t writes{ 0u };
+};
+
+// The number of wait stripes. Threads blocked in Retry wait for commits to the stripes they have read.
+constexpr size_t kWaitStripes{ 1024u };
+
+// The number of bytes covered by each wait stripe
+constexpr size_t kWaitStripeBytes{ 64u };
+
+// Returns the wait stripe of address
+inline size_t GetWaitStripe(const void* address);
+
+// The number of transactions after which a thread publishes its statistics
+constexpr uint64_t kStatsSampleInterval{ 256u };
+
+// The number of transactions over all threads after which the algorithm is reevaluated
+constexpr uint64_t kStatsWindow{ 16384u };
+
+extern std::atomic<const Dispatch*> active_dispatch;
+
+// Returns the dispatch table of the active algorithm
+inline const Dispatch& GetDispatch();
+
+/**
+ * Selects the algorithm best suited for the measured workload.
+ *
+ * - Transactions that mostly abort and write a lot are serialized.
+ * - Read mostly workloads use the ring if transactions read a lot and the sequence lock otherwise.
+ * - Everything else uses the lock table.
+ */
+Algorithm SelectAlgorithm(const AlgorithmStats& stats);
+
+/**
+ * Must be called before a transaction is started or restarted on this thread.
+ * Blocks while the active algorithm is being switched or the versions are rolled over.
+ * Performs a pending rollover before new transactions are started. Runs the abort actions of the
+ * previous attempt on restarts.
+ *
+ * \param read_only True if the transaction can not write.
+ */
+void OnTransactionBegin(bool read_only);
+
+/**
+ * Must be called after a transaction has terminated on this thread. Runs the privatization fence
+ * after committed writing transactions if automatic privatization is enabled, then the deferred
+ * actions of the transaction.
+ *
+ * \param committed True if the transaction has committed successfully.
+ */
+void OnTransactionEnd(bool committed);
+
+/**
+ * Aborts the running transaction with a retry error if the write trap of this thread is enabled.
+ * See SetWriteTrap.
+ *
+ * \throw TransactionError
+ */
+void TrapWrite();
+
+/**
+ * Waits until every transaction that was running on another thread when it was called has
+ * committed or aborted. Transactions started afterwards are not waited for.
+ *
+ * \throw TransactionError If called from within a transaction.
+ */
+void PrivatizationFence();
+
+/**
+ * Returns true if address lies in memory allocated with Allocate by the running transaction of
+ * this thread. Such memory is private until the transaction commits so accesses to it bypass the engine.
+ */
+bool IsCaptured(const void* address);
+
+/**
+ * Switches the active algorithm. Waits until no transaction is running on any thread.
+ *
+ * \throw TransactionError If called from within a transaction.
+ */
+void SwitchAlgorithm(Algorithm algorithm);
+
+
+//
+// Inline function definitions
+//
+
+const Dispatch& GetDispatch() {
+	return *active_dispatch.load(std::memory_order_relaxed);
+}
+
+size_t GetWaitStripe(const void* address) {
+	return (reinterpret_cast<size_t>(address) / kWaitStripeBytes) % kWaitStripes;
+}
+
+} // namespace nlane::transactional::detail
@@ -0,0 +1,452 @@
+/**
+ * Copyright 2020 Lorenzo Rai
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This file contains the per thread engine of the RingSTM algorithm.
+ *
+ * Instead of per stripe locks every writer publishes a bloom filter of its write set into
+ * a global ring when it commits. Readers only track a bloom filter of their read set and
+ * validate by intersecting it with all ring entries that were published since they started.
+ * Validation cost therefore only depends on the number of concurrent commits and not on
+ * the size of the read set. Commits are serialized (single writer variant).
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <thread>
+
+#include "transactional.hpp"
+#include "transaction_data.hpp"
+
+namespace nlane::transactional::detail {
+
+class RingEngine;
+
+// The per thread ring engine
+extern thread_local RingEngine thread_ring_engine;
+
+// The base 2 logarithm of the number of bits in a read or write signature
+constexpr size_t kSignatureBitsLog2{ 10u };
+
+// The number of bits in a read or write signature
+constexpr size_t kSignatureBits{ static_cast<size_t>(1u) << kSignatureBitsLog2 };
+
+// The number of entries in the global commit ring
+constexpr size_t kRingSize{ 1024u };
+
+// Using a bitmask for indexing requires power of 2 size
+static_assert((kRingSize & (kRingSize - 1u)) == 0);
+
+constexpr size_t kRingMask{ kRingSize - 1u };
+
+/**
+ * A bloom filter over word addresses. May report false positives but never false negatives.
+ */
+class Signature {
+  public:
+	static constexpr size_t kNumWords{ kSignatureBits / 64u };
+
+  private:
+	uint64_t bits_[kNumWords]{};
+
+	// Returns the index of the bit representing the word containing address
+	static inline size_t GetBit(const void* address);
+
+  public:
+	inline void Clear();
+
+	inline void Add(const void* address);
+
+	// Returns true if the address may have been added to the signature
+	inline bool Contains(const void* address) const;
+
+	inline uint64_t GetWord(size_t index) const noexcept;
+};
+
+/**
+ * A published write signature. The signature words may be overwritten at any time once
+ * the ring wraps around, so readers must check the sequence number before and after reading.
+ */
+class alignas(64) RingEntry {
+  private:
+	// The commit number of the signature stored in this entry or kInvalid if it is being written
+	std::atomic<Version> seq_{ 0u };
+
+	// The highest commit number of this entry whose write back has completed
+	std::atomic<Version> done_{ 0u };
+
+	std::atomic<uint64_t> bits_[Signature::kNumWords]{};
+
+  public:
+	static constexpr Version kInvalid{ std::numeric_limits<Version>::max() };
+
+	// Stores the signature for the specified commit number. Must only be called by the committer
+	inline void Publish(Version seq, const Signature& signature);
+
+	// Marks the write back of the specified commit number as done
+	inline void Complete(Version seq);
+
+	/**
+	 * Tests if the signature of the specified commit number intersects other.
+	 * Waits until the signature is published.
+	 *
+	 * \returns False if the entry has already been overwritten by a newer commit.
+	 */
+	inline bool Intersects(Version seq, const Signature& other, bool& result) const;
+
+	// Waits until the write back of the specified commit number has completed
+	inline void WaitComplete(Version seq) const;
+};
+
+// Returns a pointer to the beginning of the commit ring.
+RingEntry* GetCommitRing();
+
+// Returns the commit number of the most recently published ring entry
+std::atomic<Version>& GetRingIndex();
+
+class alignas(64) RingEngine {
+  private:
+	RingEntry* ring_;
+	State state_{ State::UNINITIALIZED };
+
+	// The commit number up to which the read signature has been validated
+	Version start_{ 0u };
+
+	uint16_t cm_backoff_{ 0u };
+
+	Signature read_sig_;
+	Signature write_sig_;
+
+	PooledList<WriteData, 255> write_data_;
+
+	Xoroshiro128pp rng_;
+
+	inline void CommitData(WriteData& data);
+
+	// Validates the read signature against all ring entries up to and including seq
+	inline bool Validate(Version seq);
+
+	// Validates the read signature if new commits have been published
+	inline void Check();
+
+	inline void Rollback();
+
+	inline void CmOnRestart();
+
+	inline void Begin(State state);
+
+  public:
+	RingEngine();
+	~RingEngine();
+
+	RingEngine(const RingEngine&) = delete;
+	RingEngine(RingEngine&&) = delete;
+	RingEngine& operator=(const RingEngine&) = delete;
+	RingEngine& operator=(RingEngine&&) = delete;
+
+	void Init();
+
+	// Returns the number of bytes allocated for the logs of this engine, excluding the engine itself
+	size_t GetAllocatedBytes() const;
+
+	inline PromotionState IsReadWriteCompatible() const;
+	inline PromotionState IsReadOnlyCompatible() const;
+
+	inline void BeginReadWrite();
+	inline void BeginReadOnly();
+
+	// Reads are tracked in a signature which entries can not be removed from. Same as BeginReadWrite.
+	inline void BeginElastic();
+
+	// Every read is validated as soon as new commits are published so commits can not skip the
+	// read signature. Same as BeginReadWrite.
+	inline void BeginSnapshot();
+
+	inline void Commit();
+	inline void End();
+
+	inline Word ReadWord(void* address);
+	inline void WriteWord(void* address, Word data, Word mask);
+
+	// Does nothing. Bits can not be removed from the read signature.
+	inline void Release(void* address);
+
+	static inline RingEngine& GetThreadEngine();
+};
+
+
+//
+// Inline function definitions
+//
+
+size_t Signature::GetBit(const void* address) {
+	constexpr uint64_t kMul{ 0x9E3779B97F4A7C15u };
+	constexpr size_t kShift{ 64u - kSignatureBitsLog2 };
+
+	return static_cast<size_t>(((reinterpret_cast<size_t>(address) >> 3u) * kMul) >> kShift);
+}
+
+void Signature::Clear() {
+	for (uint64_t& w : bits_) {
+		w = 0u;
+	}
+}
+
+void Signature::Add(const void* address) {
+	const size_t bit{ GetBit(address) };
+	bits_[bit / 64u] |= static_cast<uint64_t>(1u) << (bit % 64u);
+}
+
+bool Signature::Contains(const void* address) const {
+	const size_t bit{ GetBit(address) };
+	return (bits_[bit / 64u] & (static_cast<uint64_t>(1u) << (bit % 64u))) != 0u;
+}
+
+uint64_t Signature::GetWord(size_t index) const noexcept {
+	return bits_[index];
+}
+
+void RingEntry::Publish(Version seq, const Signature& signature) {
+	seq_.store(kInvalid, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	for (size_t i{ 0 }; i < Signature::kNumWords; i++) {
+		bits_[i].store(signature.GetWord(i), std::memory_order_relaxed);
+	}
+
+	seq_.store(seq, std::memory_order_release);
+}
+
+void RingEntry::Complete(Version seq) {
+	done_.store(seq, std::memory_order_release);
+}
+
+bool RingEntry::Intersects(Version seq, const Signature& other, bool& result) const {
+	Version current{ seq_.load(std::memory_order_acquire) };
+	while (current != seq) {
+		if (current != kInvalid && current > seq) {
+			return false;
+		}
+		current = seq_.load(std::memory_order_acquire);
+	}
+
+	uint64_t hit{ 0u };
+	for (size_t i{ 0 }; i < Signature::kNumWords; i++) {
+		hit |= bits_[i].load(std::memory_order_relaxed) & other.GetWord(i);
+	}
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (seq_.load(std::memory_order_relaxed) != seq) {
+		return false;
+	}
+
+	result = hit != 0u;
+	return true;
+}
+
+void RingEntry::WaitComplete(Version seq) const {
+	while (done_.load(std::memory_order_acquire) < seq) {
+	}
+}
+
+void RingEngine::CommitData(WriteData& data) {
+	void* addr{ reinterpret_cast<void*>(data.GetAddress()) };
+	StoreWord(addr, (LoadWord(addr) & ~(data.GetMask())) | (data.GetData() & data.GetMask()));
+}
+
+bool RingEngine::Validate(Version seq) {
+	if (seq - start_ >= kRingSize) {
+		// The entries we would need have already been overwritten
+		return false;
+	}
+
+	for (Version i{ start_ + 1u }; i <= seq; i++) {
+		const RingEntry& entry{ ring_[i & kRingMask] };
+
+		bool conflict;
+		if (!entry.Intersects(i, read_sig_, conflict) || conflict) {
+			return false;
+		}
+
+		// Later reads must not observe a partial write back
+		entry.WaitComplete(i);
+		start_ = i;
+	}
+	return true;
+}
+
+void RingEngine::Check() {
+	Version seq{ GetRingIndex().load(std::memory_order_acquire) };
+	if (seq != start_) {
+		if (!Validate(seq)) {
+			Rollback();
+			throw TransactionError{ "Read inconsistent state", true };
+		}
+	}
+}
+
+void RingEngine::Rollback() {
+	write_data_.Clear();
+}
+
+void RingEngine::CmOnRestart() {
+	uint16_t rand = static_cast<uint16_t>(rng_.Next() & 0xF);
+
+	cm_backoff_ += rand;
+	std::this_thread::sleep_for(std::chrono::nanoseconds(cm_backoff_));
+	cm_backoff_ = cm_backoff_ << 1u;
+}
+
+void RingEngine::Begin(State state) {
+	if (state_ == state) {
+		CmOnRestart();
+	}
+	else {
+		assert(state_ == State::INITIALIZED);
+		cm_backoff_ = 0;
+	}
+
+	start_ = GetRingIndex().load(std::memory_order_acquire);
+	ring_[start_ & kRingMask].WaitComplete(start_);
+
+	read_sig_.Clear();
+	write_sig_.Clear();
+	write_data_.Clear();
+
+	state_ = state;
+}
+
+PromotionState RingEngine::IsReadWriteCompatible() const {
+	return ReadWriteCompatibility(state_);
+}
+
+PromotionState RingEngine::IsReadOnlyCompatible() const {
+	return ReadOnlyCompatibility(state_);
+}
+
+void RingEngine::BeginReadWrite() {
+	Begin(State::READ_WRITE_RUNNING);
+}
+
+void RingEngine::BeginReadOnly() {
+	Begin(State::READ_ONLY_RUNNING);
+}
+
+void RingEngine::BeginElastic() {
+	Begin(State::READ_WRITE_RUNNING);
+}
+
+void RingEngine::BeginSnapshot() {
+	Begin(State::READ_WRITE_RUNNING);
+}
+
+void RingEngine::Commit() {
+	assert((state_ & State::RUNNING_bit) == State::RUNNING_bit);
+
+	// Every read has already been validated against all commits up to start_
+	if (state_ == State::READ_ONLY_RUNNING || write_data_.Empty()) {
+		state_ = State::INITIALIZED;
+		return;
+	}
+
+	std::atomic<Version>& ring_index{ GetRingIndex() };
+
+	Version seq{ ring_index.load(std::memory_order_acquire) };
+	while (true) {
+		if (seq != start_ && !Validate(seq)) {
+			Rollback();
+			throw TransactionError{ "Failed to validate read signature", true };
+		}
+
+		if (ring_index.compare_exchange_weak(seq, seq + 1u)) {
+			break;
+		}
+	}
+
+	seq++;
+	RingEntry& entry{ ring_[seq & kRingMask] };
+	entry.Publish(seq, write_sig_);
+
+	// Readers that observe any of the following stores must also observe the new ring index
+	std::atomic_thread_fence(std::memory_order_release);
+
+	for (WriteData& data : write_data_) {
+		CommitData(data);
+	}
+
+	entry.Complete(seq);
+
+	write_data_.Clear();
+	state_ = State::INITIALIZED;
+}
+
+void RingEngine::End() {
+	assert((state_ & State::RUNNING_bit) == State::RUNNING_bit);
+
+	write_data_.Clear();
+	state_ = State::INITIALIZED;
+}
+
+Word RingEngine::ReadWord(void* address) {
+	if (write_sig_.Contains(address)) {
+		WriteData* entry{ write_data_.Get(reinterpret_cast<size_t>(address)) };
+		if (entry != nullptr) {
+			return entry->GetData();
+		}
+	}
+
+	read_sig_.Add(address);
+
+	Word data{ LoadWord(address) };
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	Check();
+
+	return data;
+}
+
+void RingEngine::WriteWord(void* address, Word data, Word mask) {
+	WriteData* entry{ nullptr };
+	if (write_sig_.Contains(address)) {
+		entry = write_data_.Get(reinterpret_cast<size_t>(address));
+	}
+
+	if (entry != nullptr) {
+		entry->Extend(data, mask);
+		return;
+	}
+
+	if (mask != ~static_cast<Word>(0)) {
+		// The remaining bits are read from memory so they have to be validated like any other read
+		data = (data & mask) | (ReadWord(address) & ~mask);
+	}
+
+	write_sig_.Add(address);
+	entry = write_data_.Create(reinterpret_cast<size_t>(address));
+	entry->Set(data, mask);
+}
+
+void RingEngine::Release(void*) {
+}
+
+RingEngine& RingEngine::GetThreadEngine() {
+	return thread_ring_engine;
+}
+
+} // namespace nlane::transactional::detail
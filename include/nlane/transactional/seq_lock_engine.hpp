@@ -0,0 +1,285 @@
+/**
+ * Copyright 2020 Lorenzo Rai
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This file contains the per thread engine of the sequence lock algorithm as described by NOrec.
+ *
+ * All commits are serialized by a single global sequence lock. Readers log the values they have
+ * read and only validate them (by value) if the sequence lock changed since the last validation.
+ * Has no per stripe metadata at all which makes it very cheap for read mostly workloads with
+ * few concurrent writers.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+
+#include "transactional.hpp"
+#include "transaction_data.hpp"
+#include "transaction_policies.hpp"
+
+namespace nlane::transactional::detail {
+
+class SeqLockEngine;
+
+// The per thread sequence lock engine
+extern thread_local SeqLockEngine thread_seq_lock_engine;
+
+// Returns the global sequence lock. The lock is held while its value is odd.
+std::atomic<Version>& GetSequenceLock();
+
+class alignas(64) SeqLockEngine {
+  public:
+	// The number of most recent reads an elastic transaction keeps in its read log
+	static constexpr size_t kElasticWindow{ 2u };
+
+  private:
+	State state_{ State::UNINITIALIZED };
+
+	// The last value of the sequence lock the read log has been validated against
+	Version snapshot_{ 0u };
+
+	uint16_t cm_backoff_{ 0u };
+
+	// True while an elastic transaction has not written yet. Only the last kElasticWindow reads are logged.
+	bool elastic_{ false };
+
+	PooledList<ReadValueEntry, 255> read_log_;
+	PooledList<WriteData, 255> write_data_;
+
+	Xoroshiro128pp rng_;
+
+	inline void CommitData(WriteData& data);
+
+	// Waits until the sequence lock is free and then validates the read log. Returns the new snapshot.
+	inline Version Validate();
+
+	inline void Rollback();
+
+	inline void Begin(State state);
+
+  public:
+	SeqLockEngine();
+	~SeqLockEngine();
+
+	SeqLockEngine(const SeqLockEngine&) = delete;
+	SeqLockEngine(SeqLockEngine&&) = delete;
+	SeqLockEngine& operator=(const SeqLockEngine&) = delete;
+	SeqLockEngine& operator=(SeqLockEngine&&) = delete;
+
+	void Init();
+
+	// Returns the number of bytes allocated for the logs of this engine, excluding the engine itself
+	size_t GetAllocatedBytes() const;
+
+	inline PromotionState IsReadWriteCompatible() const;
+	inline PromotionState IsReadOnlyCompatible() const;
+
+	inline void BeginReadWrite();
+	inline void BeginReadOnly();
+	inline void BeginElastic();
+
+	// Reads are validated by value whenever the sequence lock changes, not only at commit. Same as BeginReadWrite.
+	inline void BeginSnapshot();
+
+	inline void Commit();
+	inline void End();
+
+	inline Word ReadWord(void* address);
+	inline void WriteWord(void* address, Word data, Word mask);
+
+	// Removes all reads of address from the read log
+	inline void Release(void* address);
+
+	static inline SeqLockEngine& GetThreadEngine();
+};
+
+
+//
+// Inline function definitions
+//
+
+void SeqLockEngine::CommitData(WriteData& data) {
+	void* addr{ reinterpret_cast<void*>(data.GetAddress()) };
+	StoreWord(addr, (LoadWord(addr) & ~(data.GetMask())) | (data.GetData() & data.GetMask()));
+}
+
+Version SeqLockEngine::Validate() {
+	std::atomic<Version>& seq_lock{ GetSequenceLock() };
+
+	while (true) {
+		Version time{ seq_lock.load(std::memory_order_acquire) };
+		if (time & 1u) {
+			continue;
+		}
+
+		for (ReadValueEntry& entry : read_log_) {
+			if (LoadWord(reinterpret_cast<void*>(entry.GetAddress())) != entry.GetData()) {
+				Rollback();
+				throw TransactionError{ "Read inconsistent state", true };
+			}
+		}
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (seq_lock.load(std::memory_order_relaxed) == time) {
+			return time;
+		}
+	}
+}
+
+void SeqLockEngine::Rollback() {
+	read_log_.Clear();
+	write_data_.Clear();
+}
+
+void SeqLockEngine::Begin(State state) {
+	if (state_ == state) {
+		Backoff(cm_backoff_, rng_);
+	}
+	else {
+		assert(state_ == State::INITIALIZED);
+		cm_backoff_ = 0;
+	}
+
+	std::atomic<Version>& seq_lock{ GetSequenceLock() };
+	do {
+		snapshot_ = seq_lock.load(std::memory_order_acquire);
+	} while (snapshot_ & 1u);
+
+	Rollback();
+	elastic_ = false;
+	state_ = state;
+}
+
+PromotionState SeqLockEngine::IsReadWriteCompatible() const {
+	return ReadWriteCompatibility(state_);
+}
+
+PromotionState SeqLockEngine::IsReadOnlyCompatible() const {
+	return ReadOnlyCompatibility(state_);
+}
+
+void SeqLockEngine::BeginReadWrite() {
+	Begin(State::READ_WRITE_RUNNING);
+}
+
+void SeqLockEngine::BeginReadOnly() {
+	Begin(State::READ_ONLY_RUNNING);
+}
+
+void SeqLockEngine::BeginElastic() {
+	Begin(State::READ_WRITE_RUNNING);
+	elastic_ = true;
+}
+
+void SeqLockEngine::BeginSnapshot() {
+	Begin(State::READ_WRITE_RUNNING);
+}
+
+void SeqLockEngine::Commit() {
+	assert((state_ & State::RUNNING_bit) == State::RUNNING_bit);
+
+	// Every read has already been validated against snapshot_
+	if (write_data_.Empty()) {
+		read_log_.Clear();
+		state_ = State::INITIALIZED;
+		return;
+	}
+
+	std::atomic<Version>& seq_lock{ GetSequenceLock() };
+	while (!seq_lock.compare_exchange_weak(snapshot_, snapshot_ + 1u)) {
+		snapshot_ = Validate();
+	}
+
+	// Readers that see data written below must also see the odd sequence lock
+	std::atomic_thread_fence(std::memory_order_release);
+
+	for (WriteData& data : write_data_) {
+		CommitData(data);
+	}
+
+	seq_lock.store(snapshot_ + 2u, std::memory_order_release);
+
+	Rollback();
+	state_ = State::INITIALIZED;
+}
+
+void SeqLockEngine::End() {
+	assert((state_ & State::RUNNING_bit) == State::RUNNING_bit);
+
+	Rollback();
+	state_ = State::INITIALIZED;
+}
+
+Word SeqLockEngine::ReadWord(void* address) {
+	if (!write_data_.Empty()) {
+		WriteData* entry{ write_data_.Get(reinterpret_cast<size_t>(address)) };
+		if (entry != nullptr) {
+			return entry->GetData();
+		}
+	}
+
+	// Logged values have been validated against the current snapshot. Repeated reads must not
+	// grow the log which has a fixed capacity.
+	const ReadValueEntry* logged{ read_log_.Get(reinterpret_cast<size_t>(address)) };
+	if (logged != nullptr) {
+		return logged->GetData();
+	}
+
+	std::atomic<Version>& seq_lock{ GetSequenceLock() };
+
+	Word data{ LoadWord(address) };
+	std::atomic_thread_fence(std::memory_order_acquire);
+	while (seq_lock.load(std::memory_order_relaxed) != snapshot_) {
+		snapshot_ = Validate();
+		data = LoadWord(address);
+		std::atomic_thread_fence(std::memory_order_acquire);
+	}
+
+	read_log_.Create(reinterpret_cast<size_t>(address))->Set(data);
+	if (elastic_ && (read_log_.GetSize() > kElasticWindow)) {
+		read_log_.RemoveFirst();
+	}
+	return data;
+}
+
+void SeqLockEngine::WriteWord(void* address, Word data, Word mask) {
+	elastic_ = false;
+
+	WriteData* entry{ write_data_.Get(reinterpret_cast<size_t>(address)) };
+	if (entry != nullptr) {
+		entry->Extend(data, mask);
+		return;
+	}
+
+	if (mask != ~static_cast<Word>(0)) {
+		// The remaining bits have to be validated like any other read
+		data = (data & mask) | (ReadWord(address) & ~mask);
+	}
+
+	write_data_.Create(reinterpret_cast<size_t>(address))->Set(data, mask);
+}
+
+void SeqLockEngine::Release(void* address) {
+	read_log_.Remove(reinterpret_cast<size_t>(address));
+}
+
+SeqLockEngine& SeqLockEngine::GetThreadEngine() {
+	return thread_seq_lock_engine;
+}
+
+} // namespace nlane::transactional::detail
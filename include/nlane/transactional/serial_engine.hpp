@@ -0,0 +1,163 @@
+/**
+ * Copyright 2020 Lorenzo Rai
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This file contains the per thread engine of the irrevocable serial mode.
+ *
+ * Every transaction holds a global mutex for its whole duration and accesses memory directly.
+ * Transactions can therefore never conflict or abort. Writes are recorded in an undo log so
+ * that a transaction can still be terminated by an exception.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <mutex>
+
+#include "transactional.hpp"
+#include "transaction_data.hpp"
+#include "transaction_policies.hpp"
+
+namespace nlane::transactional::detail {
+
+class SerialEngine;
+
+// The per thread serial engine
+extern thread_local SerialEngine thread_serial_engine;
+
+// Returns the mutex that serializes all transactions
+std::mutex& GetSerialMutex();
+
+class alignas(64) SerialEngine {
+  private:
+	State state_{ State::UNINITIALIZED };
+
+	UndoLog log_;
+
+	inline void Begin(State state);
+
+  public:
+	SerialEngine();
+	~SerialEngine();
+
+	SerialEngine(const SerialEngine&) = delete;
+	SerialEngine(SerialEngine&&) = delete;
+	SerialEngine& operator=(const SerialEngine&) = delete;
+	SerialEngine& operator=(SerialEngine&&) = delete;
+
+	void Init();
+
+	// Returns the number of bytes allocated for the logs of this engine, excluding the engine itself
+	size_t GetAllocatedBytes() const;
+
+	inline PromotionState IsReadWriteCompatible() const;
+	inline PromotionState IsReadOnlyCompatible() const;
+
+	inline void BeginReadWrite();
+	inline void BeginReadOnly();
+
+	// Serial transactions never conflict. Same as BeginReadWrite.
+	inline void BeginElastic();
+	inline void BeginSnapshot();
+
+	inline void Commit();
+	inline void End();
+
+	inline Word ReadWord(void* address);
+	inline void WriteWord(void* address, Word data, Word mask);
+
+	// Does nothing. Nothing is tracked for reads.
+	inline void Release(void* address);
+
+	static inline SerialEngine& GetThreadEngine();
+};
+
+
+//
+// Inline function definitions
+//
+
+void SerialEngine::Begin(State state) {
+	if ((state_ & State::RUNNING_bit) == State::RUNNING_bit) {
+		// Restarted by the user. The mutex is still held.
+		log_.Undo();
+		log_.Clear();
+	}
+	else {
+		assert(state_ == State::INITIALIZED);
+		GetSerialMutex().lock();
+	}
+
+	state_ = state;
+}
+
+PromotionState SerialEngine::IsReadWriteCompatible() const {
+	return ReadWriteCompatibility(state_);
+}
+
+PromotionState SerialEngine::IsReadOnlyCompatible() const {
+	return ReadOnlyCompatibility(state_);
+}
+
+void SerialEngine::BeginReadWrite() {
+	Begin(State::READ_WRITE_RUNNING);
+}
+
+void SerialEngine::BeginReadOnly() {
+	Begin(State::READ_ONLY_RUNNING);
+}
+
+void SerialEngine::BeginElastic() {
+	Begin(State::READ_WRITE_RUNNING);
+}
+
+void SerialEngine::BeginSnapshot() {
+	Begin(State::READ_WRITE_RUNNING);
+}
+
+void SerialEngine::Commit() {
+	assert((state_ & State::RUNNING_bit) == State::RUNNING_bit);
+
+	log_.Clear();
+	state_ = State::INITIALIZED;
+	GetSerialMutex().unlock();
+}
+
+void SerialEngine::End() {
+	assert((state_ & State::RUNNING_bit) == State::RUNNING_bit);
+
+	log_.Undo();
+	log_.Clear();
+	state_ = State::INITIALIZED;
+	GetSerialMutex().unlock();
+}
+
+Word SerialEngine::ReadWord(void* address) {
+	return LoadWord(address);
+}
+
+void SerialEngine::WriteWord(void* address, Word data, Word mask) {
+	log_.Write(address, data, mask);
+}
+
+void SerialEngine::Release(void*) {
+}
+
+SerialEngine& SerialEngine::GetThreadEngine() {
+	return thread_serial_engine;
+}
+
+} // namespace nlane::transactional::detail
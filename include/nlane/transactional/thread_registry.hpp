@@ -0,0 +1,123 @@
+/**
+ * Copyright 2020 Lorenzo Rai
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This file contains the registry that assigns small dense ids to transaction engines.
+ *
+ * Lock words store the id of their owner instead of a pointer. The id fits into a few bits so
+ * lock entries can be packed much denser and the owner of a lock can be looked up in the
+ * registry table when needed, e.g. by contention managers.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "transactional.hpp"
+
+namespace nlane::transactional::detail {
+
+using ThreadId = uint32_t;
+
+// The id that is never assigned to any engine. Used to mark unowned locks.
+constexpr ThreadId kNoThread{ 0u };
+
+// The number of bits needed to store any thread id
+constexpr size_t kThreadIdBits{ 12u };
+
+// The number of ids including kNoThread. At most kMaxThreads - 1 engines can be registered at once.
+constexpr size_t kMaxThreads{ static_cast<size_t>(1u) << kThreadIdBits };
+
+/**
+ * Registers an engine and returns the smallest free id. Ids of unregistered engines are reused.
+ *
+ * \throw std::runtime_error If all ids are in use.
+ */
+ThreadId RegisterThread(void* engine);
+
+/**
+ * Unregisters the engine with the specified id and releases the id for reuse. Waits until the
+ * engine is no longer pinned so it can be destroyed afterwards.
+ */
+void UnregisterThread(ThreadId id);
+
+// Returns the engine registered with the specified id or nullptr if none is registered.
+// The engine may be destroyed at any time unless it is pinned, see PinnedEngine.
+inline void* GetRegisteredEngine(ThreadId id);
+
+// Returns the number of currently registered engines.
+size_t GetNumRegisteredThreads();
+
+// Returns an upper bound for all ids that have been assigned so far.
+inline size_t GetThreadIdBound();
+
+extern std::atomic<size_t> thread_id_bound;
+
+extern std::atomic<void*> registered_engines[kMaxThreads];
+
+// The number of PinnedEngine instances referencing the engine of every id
+extern std::atomic<uint32_t> engine_pins[kMaxThreads];
+
+/**
+ * Looks up the engine registered with an id and keeps it from being unregistered, and the id
+ * from being reused, until the pin is destroyed. Used to access the engine owning a lock which
+ * may terminate concurrently.
+ */
+class PinnedEngine {
+  private:
+	ThreadId id_;
+	void* engine_;
+
+  public:
+	inline explicit PinnedEngine(ThreadId id);
+	inline ~PinnedEngine();
+
+	PinnedEngine(const PinnedEngine&) = delete;
+	PinnedEngine& operator=(const PinnedEngine&) = delete;
+
+	// Returns the pinned engine or nullptr if no engine was registered with the id
+	inline void* Get() const;
+};
+
+
+//
+// Inline function definitions
+//
+
+void* GetRegisteredEngine(ThreadId id) {
+	return registered_engines[id].load(std::memory_order_acquire);
+}
+
+size_t GetThreadIdBound() {
+	return thread_id_bound.load(std::memory_order_acquire);
+}
+
+PinnedEngine::PinnedEngine(ThreadId id) : id_{ id } {
+	// Either UnregisterThread sees the pin or the lookup below sees the engine unregistered
+	engine_pins[id].fetch_add(1u);
+	engine_ = registered_engines[id].load();
+}
+
+PinnedEngine::~PinnedEngine() {
+	engine_pins[id_].fetch_sub(1u, std::memory_order_release);
+}
+
+void* PinnedEngine::Get() const {
+	return engine_;
+}
+
+} // namespace nlane::transactional::detail
@@ -0,0 +1,879 @@
+/**
+ * Copyright 2020 Lorenzo Rai
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software 
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. 
+ */
+
+
+/**
+ * This file contains the data structures used by the per thread transaction engines
+ * to keep track of running transactions.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#include "transactional.hpp"
+#include "transaction_support.hpp"
+
+namespace nlane::transactional::detail {
+
+// Returns the smallest multiple of align that is greater or equal to size
+constexpr size_t AlignedSize(const size_t size, const size_t align) {
+    assert((align && (align & (align - 1u)) == 0u));
+    return (size + align - 1u) & ~(align - 1u);
+}
+
+/**
+ * Datastructure used to keep track of transaction entries. Its a linear list
+ * that only supports append, clear, search and iteration.
+ * 
+ * _Ty needs to be default constructible, have a key type Key defined,
+ * the comparison operator with the key type as well as the assignment 
+ * operator with the key type defined.
+ */
+template<class _Ty, size_t kNumEntries = 256>
+class PooledList {
+  public:
+	static constexpr size_t kEntrySize{ AlignedSize(sizeof(_Ty), alignof(_Ty)) };
+	static constexpr size_t kPoolSizeBytes{ AlignedSize(kEntrySize * kNumEntries, 64u) };
+
+	using Key = typename _Ty::Key;
+
+  private:
+	void* main_pool_{ nullptr };
+	size_t next_index_{ 0 };
+
+    // Prevent unwanted sharing
+	struct alignas(64) PoolPage {
+		uint8_t data[kPoolSizeBytes];
+	};
+
+    // Sanity check
+	static_assert(sizeof(PoolPage) == kPoolSizeBytes);
+
+    // Returns the entry at specified index. Does not do any bounds checking.
+	_Ty* GetEntry(size_t index);
+
+	// Acquires the pool and constructs its entries. Called by the first Create.
+	void Allocate();
+
+  public:
+    // Does not allocate memory. The pool is acquired once the first entry is created.
+	inline PooledList();
+
+	// Returns the pool for reuse by lists created later
+	inline ~PooledList();
+
+    // Creates a new entry and sets its key
+	inline _Ty* Create(Key key);
+
+    // Attempts to find a entry. If it cant creates a new one and sets its key
+	inline _Ty* GetOrCreate(Key key);
+
+    // Searches for a entry.
+	inline _Ty* Get(Key key);
+
+    // Returns true if the list contains an entry with specified key.
+	inline bool Contains(Key key);
+
+    // Removes all entries with specified key. Keeps the order of the remaining entries
+	inline void Remove(Key key);
+
+    // Removes the oldest entry. Keeps the order of the remaining entries
+	inline void RemoveFirst();
+
+    // Clears the list
+	inline void Clear();
+
+    // Returns true if the list is empty
+	inline bool Empty() const;
+
+    // Returns the number of entrys currently in the list
+	inline size_t GetSize() const;
+
+	// Returns the number of bytes allocated for the entries
+	inline size_t GetAllocatedBytes() const;
+
+	class Iterator {
+	  public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = _Ty;
+		using pointer = _Ty*;
+		using reference = _Ty&;
+		using difference_type = size_t;
+
+	  private:
+		PooledList* list_;
+		size_t current_index_;
+
+	  public:
+		inline Iterator(PooledList& list, size_t start);
+
+		inline Iterator(const Iterator& other);
+		inline Iterator(Iterator&& other);
+
+		inline Iterator& operator=(const Iterator& other);
+		inline Iterator& operator=(Iterator&& other);
+
+		inline bool operator==(const Iterator& other) const;
+		inline bool operator!=(const Iterator& other) const;
+
+		inline Iterator& operator++();
+				
+		inline reference operator*();
+	};
+
+	inline Iterator begin();
+	inline Iterator end();
+};
+
+/**
+ * A class implementing the Xoroshiro128++ pseudo random number generator.
+ * See http://prng.di.unimi.it/ for more details.
+ */
+class Xoroshiro128pp {
+  private:
+	uint64_t s_[2];
+
+	static inline uint64_t Rotl(const uint64_t x, int k);
+
+  public:
+	inline Xoroshiro128pp();
+	inline Xoroshiro128pp(uint64_t s0, uint64_t s1);
+
+	inline uint64_t Next();
+    inline void Jump();
+
+	// Returns a generator whose state is derived from seed with splitmix64
+	static inline Xoroshiro128pp FromSeed(uint64_t seed);
+};
+
+// Returns a generator for a new engine. Every call uses a different seed.
+inline Xoroshiro128pp CreateEngineRng();
+
+class ReadSetEntry {
+  public:
+	using Key = LockIndex;
+
+  private:
+	Key index_;
+	Version old_version_;
+
+  public:
+	inline ReadSetEntry& operator=(const Key key);
+	inline bool operator==(const Key other) const;
+
+	inline void SetVersion(Version version) noexcept;
+
+	inline Key GetIndex() const noexcept;
+	inline Version GetVersion() const noexcept;
+};
+
+class WriteSetEntry {
+  public:
+	using Key = LockIndex;
+
+  private:
+	Key index_;
+	Version old_version_;
+
+  public:
+	inline WriteSetEntry& operator=(const Key key);
+	inline bool operator==(const Key other) const;
+
+	// Sets the version the stripe had when it was locked
+	inline void SetVersion(Version version) noexcept;
+
+	inline Key GetIndex() const noexcept;
+	inline Version GetVersion() const noexcept;
+};
+
+class WriteData {
+  public:
+	using Key = size_t;
+
+  private:
+	Key  address_;
+	Word data_;
+	Word mask_;
+
+  public:
+	inline WriteData& operator=(const Key key);
+	inline bool operator==(const Key other) const;
+
+	inline void Set(Word data, Word mask);
+	inline void Extend(Word data, Word mask);
+
+	inline Key GetAddress() const noexcept;
+	inline Word GetData() const noexcept;
+	inline Word GetMask() const noexcept;
+};
+
+class ReadValueEntry {
+  public:
+	using Key = size_t;
+
+  private:
+	Key  address_;
+	Word data_;
+
+  public:
+	inline ReadValueEntry& operator=(const Key key);
+	inline bool operator==(const Key other) const;
+
+	inline void Set(Word data);
+
+	inline Key GetAddress() const noexcept;
+	inline Word GetData() const noexcept;
+};
+
+/**
+ * The buffered writes to a single cache line. Words are always stored entirely, bits outside
+ * of the written mask hold the content the word had when it was first written.
+ */
+class alignas(64) LineData {
+  public:
+	using Key = size_t;
+
+	static constexpr size_t kLineSize{ 64u };
+	static constexpr size_t kWordsPerLine{ kLineSize / sizeof(Word) };
+
+	// The bitmask of address bits that select the offset within a line
+	static constexpr size_t kLineMask{ kLineSize - 1u };
+
+  private:
+	Word data_[kWordsPerLine];
+	Key address_;
+
+	// One bit per byte of the line that has been written
+	uint64_t byte_mask_;
+
+  public:
+	inline LineData& operator=(const Key key);
+	inline bool operator==(const Key other) const;
+
+	// Returns true if any byte of the word at index has been written
+	inline bool Contains(size_t index) const noexcept;
+
+	// Sets the word at index. data must contain the current content of all bits outside of mask
+	inline void Set(size_t index, Word data, Word mask) noexcept;
+
+	// Updates the bits in mask of a word that has already been written
+	inline void Extend(size_t index, Word data, Word mask) noexcept;
+
+	inline Key GetAddress() const noexcept;
+	inline const Word* GetData() const noexcept;
+	inline Word GetWord(size_t index) const noexcept;
+	inline uint64_t GetByteMask() const noexcept;
+
+	// Returns the index of the word at address within its line
+	static constexpr size_t GetWordIndex(size_t address);
+
+	// Returns the mask of all bytes that contain at least one bit of mask
+	static constexpr uint64_t GetByteMask(Word mask);
+};
+
+class UndoData {
+  public:
+	using Key = size_t;
+
+  private:
+	Key  address_;
+	Word data_;
+
+  public:
+	inline UndoData& operator=(const Key key);
+	inline bool operator==(const Key other) const;
+
+	inline void Set(Word data);
+
+	inline Key GetAddress() const noexcept;
+	inline Word GetData() const noexcept;
+};
+
+/**
+ * Published by a committing transaction once its write back may be performed by other threads.
+ * A reader or writer blocked by the commit can then finish the write back and release the
+ * stripes itself instead of waiting for the committer to be rescheduled.
+ *
+ * Every thread performing the write back, the committer included, enters the descriptor first
+ * and finishes it afterwards. The first finished write back closes the descriptor and the last
+ * thread to finish releases the stripes, so no thread can write after they have been released.
+ * A committer that is too late to enter leaves the release to the helpers. The write back of a
+ * committer that is preempted while it has entered can not be taken over, its stripes stay
+ * locked until it is rescheduled.
+ */
+class CommitDescriptor {
+  private:
+	// Set while threads may enter
+	static constexpr uint32_t kOpen{ static_cast<uint32_t>(1u) << 31u };
+
+	// Set once the stripes have been released
+	static constexpr uint32_t kReleased{ static_cast<uint32_t>(1u) << 30u };
+
+	static constexpr uint32_t kCountMask{ kReleased - 1u };
+
+	// The flags above and the number of threads that have entered but not finished yet
+	std::atomic<uint32_t> state_{ 0u };
+
+	// The versions the written stripes get, indexed by domain
+	const Version* versions_{ nullptr };
+
+  public:
+	// Allows threads to enter. The log and versions must not change until the stripes are released
+	inline void Publish(const Version* versions);
+
+	// Returns true if the caller may write back. Must be followed by a call to Finish in that case
+	inline bool Enter();
+
+	/**
+	 * Called after the write back. Prevents further threads from entering.
+	 *
+	 * \returns True if the caller was the last thread to finish. It must release the stripes and call MarkReleased.
+	 */
+	inline bool Finish();
+
+	inline void MarkReleased();
+
+	// Waits until the stripes have been released. Used by the committer if it did not release them itself.
+	inline void WaitReleased() const;
+
+	inline Version GetVersion(size_t domain) const noexcept;
+};
+
+enum class State : uint32_t {
+	NONE_mask				= 0,
+	ALL_mask				= ~(static_cast<uint32_t>(0)),
+
+	INITIALIZED_bit			= 0b0001,
+	RUNNING_bit				= 0b0010,
+	READ_ONLY_bit			= 0b0100,
+	SINGLE_bit				= 0b1000,
+
+	UNINITIALIZED			= 0x0,
+	INITIALIZED				= INITIALIZED_bit,
+	READ_WRITE_RUNNING		= INITIALIZED_bit | RUNNING_bit,
+	READ_ONLY_RUNNING		= INITIALIZED_bit | RUNNING_bit | READ_ONLY_bit,
+};
+
+inline State operator|(const State a, const State b) noexcept {
+	return static_cast<State>(static_cast<uint32_t>(a) | static_cast<uint32_t>(b));
+}
+
+inline State operator&(const State a, const State b) noexcept {
+	return static_cast<State>(static_cast<uint32_t>(a) & static_cast<uint32_t>(b));
+}
+
+inline State operator^(const State a, const State b) noexcept {
+	return static_cast<State>(static_cast<uint32_t>(a) ^ static_cast<uint32_t>(b));
+}
+
+// Returns if a read-write transaction can be embedded into an engine in the specified state
+inline PromotionState ReadWriteCompatibility(const State state) noexcept {
+	if ((state & State::RUNNING_bit) == State::NONE_mask) {
+		return PromotionState::NO_RUNNING;
+	}
+
+	if (state == State::READ_WRITE_RUNNING) {
+		return PromotionState::COMPATIBLE;
+	} else {
+		return PromotionState::INCOMPATIBLE;
+	}
+}
+
+// Returns if a read-only transaction can be embedded into an engine in the specified state
+inline PromotionState ReadOnlyCompatibility(const State state) noexcept {
+	if ((state & State::RUNNING_bit) == State::NONE_mask) {
+		return PromotionState::NO_RUNNING;
+	}
+
+	if ((state == State::READ_WRITE_RUNNING) || (state == State::READ_ONLY_RUNNING)) {
+		return PromotionState::COMPATIBLE;
+	} else {
+		return PromotionState::INCOMPATIBLE;
+	}
+}
+
+
+
+//
+// Inline function definitions
+//
+
+template<class _Ty, size_t _Cnt>
+inline _Ty* PooledList<_Ty, _Cnt>::GetEntry(size_t index) {
+	size_t pool = index / _Cnt;
+	size_t entry = index % _Cnt;
+
+	if (pool != 0) {
+		throw std::runtime_error{ "Out of memory" };
+	}
+
+	return reinterpret_cast<_Ty*>(reinterpret_cast<uint8_t*>(main_pool_) + (kEntrySize * entry));
+}
+
+template<class _Ty, size_t _Cnt>
+PooledList<_Ty, _Cnt>::PooledList() {
+}
+
+template<class _Ty, size_t _Cnt>
+PooledList<_Ty, _Cnt>::~PooledList() {
+	if(main_pool_ != nullptr) {
+		for (size_t i{ 0 }; i < _Cnt; i++) {
+			GetEntry(i)->~_Ty();
+		}
+
+		ReleaseStorage(main_pool_, sizeof(PoolPage));
+		main_pool_ = nullptr;
+	}
+}
+
+template<class _Ty, size_t _Cnt>
+void PooledList<_Ty, _Cnt>::Allocate() {
+	// Engines are used by their own thread so the pool is placed on its node
+	main_pool_ = AcquireStorage(sizeof(PoolPage));
+	for (size_t i{ 0 }; i < _Cnt; i++) {
+		new (GetEntry(i))_Ty{};
+	}
+}
+
+template<class _Ty, size_t _Cnt>
+_Ty* PooledList<_Ty, _Cnt>::Create(Key key) {
+	if (main_pool_ == nullptr) {
+		Allocate();
+	}
+
+	size_t index = next_index_++;
+	_Ty* entry{ GetEntry(index) };
+	*entry = key;
+	return entry;
+}
+
+template<class _Ty, size_t _Cnt>
+_Ty* PooledList<_Ty, _Cnt>::GetOrCreate(Key key) {
+	for (size_t i{ 0 }; i < next_index_; i++) {
+		_Ty* entry{ GetEntry(i) };
+		if (*entry == key) {
+			return entry;
+		}
+	}
+
+	// Create new entry
+	if (main_pool_ == nullptr) {
+		Allocate();
+	}
+
+	size_t index = next_index_++;
+	_Ty* entry{ GetEntry(index) };
+	*entry = key;
+	return entry;
+}
+
+template<class _Ty, size_t _Cnt>
+_Ty* PooledList<_Ty, _Cnt>::Get(Key key) {
+	for (size_t i{ 0 }; i < next_index_; i++) {
+		_Ty* entry{ GetEntry(i) };
+		if (*entry == key) {
+			return entry;
+		}
+	}
+	return nullptr;
+}
+
+template<class _Ty, size_t _Cnt>
+bool PooledList<_Ty, _Cnt>::Contains(Key key) {
+	for (size_t i{ 0 }; i < next_index_; i++) {
+		const _Ty* entry{ GetEntry(i) };
+		if (*entry == key) {
+			return true;
+		}
+	}
+	return false;
+}
+
+template<class _Ty, size_t _Cnt>
+void PooledList<_Ty, _Cnt>::Remove(Key key) {
+	size_t kept{ 0 };
+	for (size_t i{ 0 }; i < next_index_; i++) {
+		_Ty* entry{ GetEntry(i) };
+		if (*entry == key) {
+			continue;
+		}
+		if (kept != i) {
+			*GetEntry(kept) = *entry;
+		}
+		kept++;
+	}
+	next_index_ = kept;
+}
+
+template<class _Ty, size_t _Cnt>
+void PooledList<_Ty, _Cnt>::RemoveFirst() {
+	assert(next_index_ != 0);
+
+	for (size_t i{ 1 }; i < next_index_; i++) {
+		*GetEntry(i - 1u) = *GetEntry(i);
+	}
+	next_index_--;
+}
+
+template<class _Ty, size_t _Cnt>
+void PooledList<_Ty, _Cnt>::Clear() {
+	next_index_ = 0;
+}
+
+template<class _Ty, size_t _Cnt>
+bool PooledList<_Ty, _Cnt>::Empty() const {
+	return next_index_ == 0;
+}
+
+template<class _Ty, size_t _Cnt>
+size_t PooledList<_Ty, _Cnt>::GetSize() const {
+	return next_index_;
+}
+
+template<class _Ty, size_t _Cnt>
+size_t PooledList<_Ty, _Cnt>::GetAllocatedBytes() const {
+	return main_pool_ != nullptr ? sizeof(PoolPage) : 0u;
+}
+		
+template<class _Ty, size_t _Cnt>
+PooledList<_Ty, _Cnt>::Iterator::Iterator(PooledList& list, size_t start) : list_{ &list }, current_index_{ start } {
+}
+		
+template<class _Ty, size_t _Cnt>
+PooledList<_Ty, _Cnt>::Iterator::Iterator(const Iterator& other) : list_{ other.list }, current_index_{ other.current_index } {
+}
+
+template<class _Ty, size_t _Cnt>
+PooledList<_Ty, _Cnt>::Iterator::Iterator(Iterator&& other) : list_{ other.list }, current_index_{ other.currnet_index } {
+}
+
+template<class _Ty, size_t _Cnt>
+typename PooledList<_Ty, _Cnt>::Iterator& PooledList<_Ty, _Cnt>::Iterator::operator=(const Iterator& other) {
+	list_ = other.list_;
+	current_index_ = other.current_index_;
+	return *this;
+}
+
+template<class _Ty, size_t _Cnt>
+typename PooledList<_Ty, _Cnt>::Iterator& PooledList<_Ty, _Cnt>::Iterator::operator=(Iterator&& other) {
+	list_ = other.list_;
+	current_index_ = other.current_index_;
+	return *this;
+}
+
+template<class _Ty, size_t _Cnt>
+bool PooledList<_Ty, _Cnt>::Iterator::operator==(const Iterator& other) const {
+	return current_index_ == other.current_index_;
+}
+
+template<class _Ty, size_t _Cnt>
+bool PooledList<_Ty, _Cnt>::Iterator::operator!=(const Iterator& other) const {
+	return current_index_ != other.current_index_;
+}
+
+template<class _Ty, size_t _Cnt>
+typename PooledList<_Ty, _Cnt>::Iterator& PooledList<_Ty, _Cnt>::Iterator::operator++() {
+	current_index_++;
+	return *this;
+}
+
+template<class _Ty, size_t _Cnt>
+typename PooledList<_Ty, _Cnt>::Iterator::reference PooledList<_Ty, _Cnt>::Iterator::operator*() {
+	return *(list_->GetEntry(current_index_));
+}
+
+template<class _Ty, size_t _Cnt>
+typename PooledList<_Ty, _Cnt>::Iterator PooledList<_Ty, _Cnt>::begin() {
+	return Iterator{ *this, 0u };
+}
+
+template<class _Ty, size_t _Cnt>
+typename PooledList<_Ty, _Cnt>::Iterator PooledList<_Ty, _Cnt>::end() {
+	return Iterator{ *this, next_index_ };
+}
+
+uint64_t Xoroshiro128pp::Rotl(const uint64_t x, int k) {
+	return (x << k) | (x >> (64 - k));
+}
+
+Xoroshiro128pp::Xoroshiro128pp() {
+	s_[0] = 0xdad6490a0e036cbfu;
+	s_[1] = 0x282ef0c42968addcu;
+}
+
+Xoroshiro128pp::Xoroshiro128pp(uint64_t s0, uint64_t s1) : s_{ s0, s1 } {
+}
+
+uint64_t Xoroshiro128pp::Next() {
+	const uint64_t s0 = s_[0];
+	uint64_t s1 = s_[1];
+	const uint64_t result = Rotl(s0 + s1, 17) + s0;
+
+	s1 ^= s0;
+	s_[0] = Rotl(s0, 49) ^ s1 ^ (s1 << 21);
+	s_[1] = Rotl(s1, 28);
+
+	return result;
+}
+
+void Xoroshiro128pp::Jump() {
+    constexpr uint64_t kJump[] = { 0x2bd7a6a6e99c2ddc, 0x0992ccaf6a6fca05 };
+
+	uint64_t s0 = 0;
+	uint64_t s1 = 0;
+	for(int i = 0; i < sizeof kJump / sizeof *kJump; i++)
+		for(int b = 0; b < 64; b++) {
+			if (kJump[i] & static_cast<uint64_t>(1u) << b) {
+				s0 ^= s_[0];
+				s1 ^= s_[1];
+			}
+			Next();
+		}
+
+	s_[0] = s0;
+	s_[1] = s1;
+}
+
+Xoroshiro128pp Xoroshiro128pp::FromSeed(uint64_t seed) {
+	uint64_t state[2];
+	for (uint64_t& s : state) {
+		uint64_t z{ (seed += 0x9e3779b97f4a7c15u) };
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9u;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebu;
+		s = z ^ (z >> 31);
+	}
+	return Xoroshiro128pp{ state[0], state[1] };
+}
+
+Xoroshiro128pp CreateEngineRng() {
+	static std::atomic<uint64_t> next_seed{ 0u };
+	return Xoroshiro128pp::FromSeed(next_seed.fetch_add(1u, std::memory_order_relaxed));
+}
+
+ReadSetEntry& ReadSetEntry::operator=(Key nindex) {
+	index_ = nindex;
+	return *this;
+}
+
+bool ReadSetEntry::operator==(Key other) const {
+	return index_ == other;
+}
+
+void ReadSetEntry::SetVersion(Version new_version) noexcept {
+	old_version_ = new_version;
+}
+
+ReadSetEntry::Key ReadSetEntry::GetIndex() const noexcept {
+	return index_;
+}
+
+Version ReadSetEntry::GetVersion() const noexcept {
+	return old_version_;
+}
+
+WriteSetEntry& WriteSetEntry::operator=(Key new_index) {
+	index_ = new_index;
+	return *this;
+}
+
+bool WriteSetEntry::operator==(Key other) const {
+	return index_ == other;
+}
+
+void WriteSetEntry::SetVersion(Version version) noexcept {
+	old_version_ = version;
+}
+
+WriteSetEntry::Key WriteSetEntry::GetIndex() const noexcept {
+	return index_;
+}
+
+Version WriteSetEntry::GetVersion() const noexcept {
+	return old_version_;
+}
+
+
+WriteData& WriteData::operator=(Key new_addr) {
+	address_ = new_addr;
+	return *this;
+}
+
+bool WriteData::operator==(Key other) const {
+	return address_ == other;
+}
+
+void WriteData::Set(Word new_data, Word new_mask) {
+	data_ = new_data;
+	mask_ = new_mask;
+}
+
+void WriteData::Extend(Word new_data, Word new_mask) {
+	data_ = (data_ & ~new_mask) | (new_data & new_mask);
+	mask_ |= new_mask;
+}
+
+WriteData::Key WriteData::GetAddress() const noexcept {
+	return address_;
+}
+
+Word WriteData::GetData() const noexcept {
+	return data_;
+}
+
+Word WriteData::GetMask() const noexcept {
+	return mask_;
+}
+
+
+ReadValueEntry& ReadValueEntry::operator=(Key new_addr) {
+	address_ = new_addr;
+	return *this;
+}
+
+bool ReadValueEntry::operator==(Key other) const {
+	return address_ == other;
+}
+
+void ReadValueEntry::Set(Word new_data) {
+	data_ = new_data;
+}
+
+ReadValueEntry::Key ReadValueEntry::GetAddress() const noexcept {
+	return address_;
+}
+
+Word ReadValueEntry::GetData() const noexcept {
+	return data_;
+}
+
+LineData& LineData::operator=(Key new_addr) {
+	address_ = new_addr;
+	byte_mask_ = 0u;
+	return *this;
+}
+
+bool LineData::operator==(Key other) const {
+	return address_ == other;
+}
+
+bool LineData::Contains(size_t index) const noexcept {
+	return ((byte_mask_ >> (index * sizeof(Word))) & 0xFFu) != 0u;
+}
+
+void LineData::Set(size_t index, Word data, Word mask) noexcept {
+	data_[index] = data;
+	byte_mask_ |= GetByteMask(mask) << (index * sizeof(Word));
+}
+
+void LineData::Extend(size_t index, Word data, Word mask) noexcept {
+	data_[index] = (data_[index] & ~mask) | (data & mask);
+	byte_mask_ |= GetByteMask(mask) << (index * sizeof(Word));
+}
+
+LineData::Key LineData::GetAddress() const noexcept {
+	return address_;
+}
+
+const Word* LineData::GetData() const noexcept {
+	return data_;
+}
+
+Word LineData::GetWord(size_t index) const noexcept {
+	return data_[index];
+}
+
+uint64_t LineData::GetByteMask() const noexcept {
+	return byte_mask_;
+}
+
+constexpr size_t LineData::GetWordIndex(size_t address) {
+	return (address & kLineMask) / sizeof(Word);
+}
+
+constexpr uint64_t LineData::GetByteMask(Word mask) {
+	uint64_t byte_mask{ 0u };
+	for (size_t i{ 0 }; i < sizeof(Word); i++) {
+		if ((mask >> (i * 8u)) & 0xFFu) {
+			byte_mask |= static_cast<uint64_t>(1u) << i;
+		}
+	}
+	return byte_mask;
+}
+
+void CommitDescriptor::Publish(const Version* versions) {
+	versions_ = versions;
+	state_.store(kOpen);
+}
+
+bool CommitDescriptor::Enter() {
+	uint32_t state{ state_.load() };
+	while ((state & kOpen) != 0u) {
+		if (state_.compare_exchange_weak(state, state + 1u)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool CommitDescriptor::Finish() {
+	// One complete write back is enough, threads that have entered already still finish theirs
+	state_.fetch_and(~kOpen);
+	return (state_.fetch_sub(1u) & kCountMask) == 1u;
+}
+
+void CommitDescriptor::MarkReleased() {
+	state_.store(kReleased, std::memory_order_release);
+}
+
+void CommitDescriptor::WaitReleased() const {
+	while ((state_.load(std::memory_order_acquire) & kReleased) == 0u) {
+		std::this_thread::yield();
+	}
+}
+
+Version CommitDescriptor::GetVersion(size_t domain) const noexcept {
+	return versions_[domain];
+}
+
+UndoData& UndoData::operator=(Key new_addr) {
+	address_ = new_addr;
+	return *this;
+}
+
+bool UndoData::operator==(Key other) const {
+	return address_ == other;
+}
+
+void UndoData::Set(Word old_data) {
+	data_ = old_data;
+}
+
+UndoData::Key UndoData::GetAddress() const noexcept {
+	return address_;
+}
+
+Word UndoData::GetData() const noexcept {
+	return data_;
+}
+
+} // namespace nlane::transactional::detail
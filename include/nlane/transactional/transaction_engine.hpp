@@ -7,11 +7,11 @@
  *
  *     http://www.apache.org/licenses/LICENSE-2.0
  *
- * Unless required by applicable law or agreed to in writing, software 
+ * Unless required by applicable law or agreed to in writing, software
  * distributed under the License is distributed on an "AS IS" BASIS,
  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
  * See the License for the specific language governing permissions and
- * limitations under the License. 
+ * limitations under the License.
  */
 
 /**
@@ -20,262 +20,175 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cassert>
-#include <chrono>
-#include <thread>
+
+#include <nlane/util/numa.hpp>
 
 #include "transactional.hpp"
+#include "transaction_data.hpp"
+#include "transaction_policies.hpp"
 #include "transaction_support.hpp"
+#include "thread_registry.hpp"
 
 namespace nlane::transactional::detail {
 
-class TransactionEngine;
-
-// The per thread transaction engine
-extern thread_local TransactionEngine thread_engine;
-
-// Returns the smallest multiple of align that is greater or equal to size
-constexpr size_t AlignedSize(const size_t size, const size_t align) {
-    assert((align && (align & (align - 1u)) == 0u));
-    return (size + align - 1u) & ~(align - 1u);
-}
-
 /**
- * Datastructure used to keep track of transaction entries. Its a linear list
- * that only supports append, clear, search and iteration.
- * 
- * _Ty needs to be default constructible, have a key type Key defined,
- * the comparison operator with the key type as well as the assignment 
- * operator with the key type defined.
+ * A lock table based transaction engine. The clock, the layout of the lock table, the time at which
+ * write locks are acquired, the log and the contention manager are selected with the policy types. See
+ * transaction_policies.hpp for the available policies.
+ *
+ * Only the configuration selected as TransactionEngine is instantiated by the library.
  */
-template<class _Ty, size_t kNumEntries = 256>
-class PooledList {
-  public:
-	static constexpr size_t kEntrySize{ AlignedSize(sizeof(_Ty), alignof(_Ty)) };
-	static constexpr size_t kPoolSizeBytes{ AlignedSize(kEntrySize * kNumEntries, 64u) };
-
-	using Key = typename _Ty::Key;
-
-  private:
-	void* main_pool_{ nullptr };
-	size_t next_index_{ 0 };
-
-    // Prevent unwanted sharing
-	struct alignas(64) PoolPage {
-		uint8_t data[kPoolSizeBytes];
-	};
-
-    // Sanity check
-	static_assert(sizeof(PoolPage) == kPoolSizeBytes);
-
-    // Returns the entry at specified index. Does not do any bounds checking.
-	_Ty* GetEntry(size_t index);
-
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+class alignas(64) BasicTransactionEngine {
   public:
-    // Does not allocate memory. A call to Init is required before use.
-	inline PooledList();
-	inline ~PooledList();
-
-	// Initializes the list
-	inline void Init();
-
-    // Creates a new entry and sets its key
-	inline _Ty* Create(Key key);
-
-    // Attempts to find a entry. If it cant creates a new one and sets its key
-	inline _Ty* GetOrCreate(Key key);
+	using Clock = _Clock;
+	using Locks = _Locks;
+	using Locking = _Locking;
+	using Log = _Log;
+	using Cm = _Cm;
 
-    // Searches for a entry.
-	inline _Ty* Get(Key key);
+	static_assert(_Locking::kAcquireOnWrite || !_Log::kInPlace, "In place logs require write locks to be acquired on write");
 
-    // Returns true if the list contains an entry with specified key.
-	inline bool Contains(Key key);
+	// True if readers can be blocked by a stripe for the whole duration of another transaction
+	static constexpr bool kLongReadLocks{ _Log::kInPlace || (_Locks::kSingleWord && _Locking::kAcquireOnWrite) };
 
-    // Clears the list
-	inline void Clear();
+	// The number of times a reader spins on a stripe locked for a long time before it aborts
+	static constexpr size_t kMaxReadSpins{ 1024u };
 
-    // Returns true if the list is empty
-	inline bool Empty() const;
+	// True if blocked threads can finish the write back of a committer and release its stripes.
+	// Requires the readers to be unblocked separately from the write lock. Without it, threads
+	// blocked by a preempted committer wait until it is rescheduled.
+	static constexpr bool kHelping{ !_Log::kInPlace && !_Locks::kSingleWord };
 
-    // Returns the number of entrys currently in the list
-	inline size_t GetSize() const;
+	// The number of times a thread spins on a locked stripe before it helps the owner
+	static constexpr size_t kHelpSpins{ 64u };
 
-	class Iterator {
-	  public:
-		using iterator_category = std::input_iterator_tag;
-		using value_type = _Ty;
-		using pointer = _Ty*;
-		using reference = _Ty&;
-		using difference_type = size_t;
+	// The number of most recently read stripes an elastic transaction keeps in its read set
+	static constexpr size_t kElasticWindow{ 2u };
 
-	  private:
-		PooledList* list_;
-		size_t current_index_;
+	// The number of times a writer checks for visible readers of a stripe before it aborts
+	static constexpr size_t kMaxReaderWaitSpins{ 4096u };
 
-	  public:
-		inline Iterator(PooledList& list, size_t start);
+	using LockEntry = typename _Locks::Entry;
 
-		inline Iterator(const Iterator& other);
-		inline Iterator(Iterator&& other);
-
-		inline Iterator& operator=(const Iterator& other);
-		inline Iterator& operator=(Iterator&& other);
-
-		inline bool operator==(const Iterator& other) const;
-		inline bool operator!=(const Iterator& other) const;
-
-		inline Iterator& operator++();
-				
-		inline reference operator*();
-	};
-
-	inline Iterator begin();
-	inline Iterator end();
-};
-
-/**
- * A class implementing the Xoroshiro128++ pseudo random number generator.
- * See http://prng.di.unimi.it/ for more details.
- */
-class Xoroshiro128pp {
   private:
-	uint64_t s_[2];
-
-	static inline uint64_t Rotl(const uint64_t x, int k);
-
-  public:
-	inline Xoroshiro128pp();
-	inline Xoroshiro128pp(uint64_t s0, uint64_t s1);
-
-	inline uint64_t Next();
-    inline void Jump();
-};
+	// The visible stripes read by the transaction. They are not part of the read set.
+	struct HeldReaders {
+		ReaderIndicator* indicators[kMaxVisibleStripes];
+		size_t nodes[kMaxVisibleStripes];
+		size_t count;
+	};
 
-class ReadSetEntry {
-  public:
-	using Key = LockIndex;
+	// Per transaction data that is not accessed on every read
+	struct Metadata {
+		// The version of every domain the transaction is known to be consistent with
+		Version snapshot[kMaxDomains];
 
-  private:
-	Key index_;
-	Version old_version_;
+		// The versions the written stripes of every domain get during commit
+		Version commit[kMaxDomains];
 
-  public:
-	inline ReadSetEntry& operator=(const Key key);
-	inline bool operator==(const Key other) const;
+		// Bit d is set if a stripe of domain d has been read or written
+		uint32_t read_domains;
+		uint32_t write_domains;
 
-	inline void SetVersion(Version version) noexcept;
+		HeldReaders readers;
+	};
 
-	inline Key GetIndex() const noexcept;
-	inline Version GetVersion() const noexcept;
-};
+	LockEntry* lock_table_;
+	State state_{ State::UNINITIALIZED };
 
-class WriteSetEntry {
-  public:
-	using Key = LockIndex;
+	// True while an elastic transaction has not written yet. Only the last kElasticWindow reads are tracked.
+	bool elastic_{ false };
 
-  private:
-	Key index_;
+	// True if the running transaction only validates write-write conflicts at commit
+	bool snapshot_isolation_{ false };
 
-  public:
-	inline WriteSetEntry& operator=(const Key key);
-	inline bool operator==(const Key other) const;
+	// The id stored in the locks owned by this engine. Assigned by the thread registry in Init
+	ThreadId id_{ kNoThread };
 
-	inline Key GetIndex() const noexcept;
-};
+	// Allocated in Init to keep the engine small
+	Metadata* meta_{ nullptr };
 
-class WriteData {
-  public:
-	using Key = size_t;
+	_Cm cm_;
 
-  private:
-	Key  address_;
-	Word data_;
-	Word mask_;
+	PooledList<ReadSetEntry, 255> read_set_;
+	PooledList<WriteSetEntry, 255> write_set_;
+	_Log log_;
 
-  public:
-	inline WriteData& operator=(const Key key);
-	inline bool operator==(const Key other) const;
+	Xoroshiro128pp rng_;
 
-	inline void Set(Word data, Word mask);
-	inline void Extend(Word data, Word mask);
+	CommitDescriptor commit_;
 
-	inline Key GetAddress() const noexcept;
-	inline Word GetData() const noexcept;
-	inline Word GetMask() const noexcept;
-};
+	inline bool ValidateReadSet();
 
-enum class State : uint32_t {
-	NONE_mask				= 0,
-	ALL_mask				= ~(static_cast<uint32_t>(0)),
+	// Returns false if another transaction committed to a written stripe since this transaction read it or took its snapshot
+	inline bool ValidateWriteSet();
 
-	INITIALIZED_bit			= 0b0001,
-	RUNNING_bit				= 0b0010,
-	READ_ONLY_bit			= 0b0100,
-	SINGLE_bit				= 0b1000,
+	// Takes a new snapshot of all domains if the read set is still valid
+	inline bool Extend();
 
-	UNINITIALIZED			= 0x0,
-	INITIALIZED				= INITIALIZED_bit,
-	READ_WRITE_RUNNING		= INITIALIZED_bit | RUNNING_bit,
-	READ_ONLY_RUNNING		= INITIALIZED_bit | RUNNING_bit | READ_ONLY_bit,
-};
+	// Increments the versions of all written domains and stores their new values in meta_->commit
+	inline void TickWrittenDomains();
 
-inline State operator|(const State a, const State b) noexcept {
-	return static_cast<State>(static_cast<uint32_t>(a) | static_cast<uint32_t>(b));
-}
+	// Returns true if other transactions might have committed to a read or written domain since the snapshot
+	inline bool NeedsValidation() const;
+	inline void Rollback();
 
-inline State operator&(const State a, const State b) noexcept {
-	return static_cast<State>(static_cast<uint32_t>(a) & static_cast<uint32_t>(b));
-}
+	// Reads a word of a visible stripe. Announces this transaction as reader first.
+	inline Word ReadVisible(void* address, LockIndex index, LockEntry& lock, ReaderIndicator& indicator);
 
-inline State operator^(const State a, const State b) noexcept {
-	return static_cast<State>(static_cast<uint32_t>(a) ^ static_cast<uint32_t>(b));
-}
+	inline bool HoldsReader(const ReaderIndicator* indicator) const;
 
-class alignas(64) TransactionEngine {
-  private:
-	LockEntry* lock_table_;
-	State state_{ State::UNINITIALIZED };
-	Version version_{ 0u };
+	// Waits until no other transaction reads the locked stripe with specified index. Returns false if the transaction has to abort.
+	inline bool WaitForReaders(LockIndex index);
 
-	std::atomic<Version> cm_ts_{ std::numeric_limits<Version>::max() };
-	uint16_t cm_backoff_{ 0u };
+	// Removes this transaction from the readers of all visible stripes
+	inline void DepartReaders();
 
-	PooledList<ReadSetEntry, 255> read_set_;
-	PooledList<WriteSetEntry, 255> write_set_;
-	PooledList<WriteData, 255> write_data_;
-			
-	Xoroshiro128pp rng_;
+	// Acquires the write lock of a stripe and returns its version. Returns false if the transaction has to abort.
+	inline bool AcquireWriteLock(LockEntry& lock, Version& version);
 
-	inline void CommitData(WriteData& data);
-	inline bool ValidateReadSet();
+	// Acquires the write locks of all written stripes during commit. Returns false if the transaction has to abort.
+	inline bool AcquireWriteLocks();
 
-	inline bool Extend();
-	inline void Rollback();
+	inline bool CmShouldAbort(LockEntry& lock);
 
-	inline void CmOnStart();
-	inline void CmOnRestart();
-	inline void CmOnWrite();
+	// Helps the owner of a locked stripe to finish its commit
+	inline void HelpOwner(const LockEntry& lock);
 
-	inline bool CmShouldAbort(WriteLock& lock);
+	// Writes back the published commit of this engine after entering commit_. Releases the written
+	// stripes if the caller is the last thread to finish. Returns true in that case.
+	inline bool FinishWriteBack();
 
 	inline void MarkAbort();
 
+	inline void Begin(State state);
+
   public:
-	TransactionEngine();
-	~TransactionEngine();
+	BasicTransactionEngine();
+	~BasicTransactionEngine();
 
-	TransactionEngine(const TransactionEngine&) = delete;
-	TransactionEngine(TransactionEngine&&) = delete;
-	TransactionEngine& operator=(const TransactionEngine&) = delete;
-	TransactionEngine& operator=(TransactionEngine&&) = delete;
+	BasicTransactionEngine(const BasicTransactionEngine&) = delete;
+	BasicTransactionEngine(BasicTransactionEngine&&) = delete;
+	BasicTransactionEngine& operator=(const BasicTransactionEngine&) = delete;
+	BasicTransactionEngine& operator=(BasicTransactionEngine&&) = delete;
 
 	void Init();
 
+	// Returns the number of bytes allocated for the logs of this engine, excluding the engine itself
+	size_t GetAllocatedBytes() const;
+
 	inline PromotionState IsReadWriteCompatible() const;
 	inline PromotionState IsReadOnlyCompatible() const;
 
 	inline void BeginReadWrite();
 	inline void BeginReadOnly();
+	inline void BeginElastic();
+
+	// Reads still see a consistent snapshot but commits only validate the written stripes
+	inline void BeginSnapshot();
 
 	inline void Commit();
 	inline void End();
@@ -283,9 +196,39 @@ class alignas(64) TransactionEngine {
 	inline Word ReadWord(void* address);
 	inline void WriteWord(void* address, Word data, Word mask);
 
-	static inline TransactionEngine& GetThreadEngine();
+	// Removes the stripe of address from the read set unless it has been written
+	inline void Release(void* address);
+
+	// Performs the write back of this engine and releases its written stripes if it is committing
+	inline void HelpCommit();
+
+	inline const CommitDescriptor& GetCommitDescriptor() const;
+
+	// Returns the id assigned by the thread registry or kNoThread if the engine is not initialized
+	inline ThreadId GetId() const;
+
+	static inline BasicTransactionEngine& GetThreadEngine();
 };
 
+/**
+ * The engine configuration of this build. Selected with the NLANE_TR_CONFIG_* definitions,
+ * every configuration is built as a separate library target.
+ */
+#if defined(NLANE_TR_CONFIG_TL2)
+using TransactionEngine = BasicTransactionEngine<DomainClocks, SplitLocks, CommitLocking, RedoLog, BackoffCm>;
+#elif defined(NLANE_TR_CONFIG_VLOCK)
+using TransactionEngine = BasicTransactionEngine<DomainClocks, VersionedLocks, CommitLocking, RedoLog, BackoffCm>;
+#elif defined(NLANE_TR_CONFIG_LINE)
+using TransactionEngine = BasicTransactionEngine<DomainClocks, SplitLocks, EncounterLocking, LineRedoLog, GreedyCm>;
+#elif defined(NLANE_TR_CONFIG_UNDO)
+using TransactionEngine = BasicTransactionEngine<DomainClocks, SplitLocks, EncounterLocking, UndoLog, GreedyCm>;
+#else
+using TransactionEngine = BasicTransactionEngine<DomainClocks, SplitLocks, EncounterLocking, RedoLog, GreedyCm>;
+#endif
+
+// The per thread transaction engine
+extern thread_local TransactionEngine thread_engine;
+
 // Keep it within 2 cache lines
 static_assert(sizeof(TransactionEngine) <= 128u);
 
@@ -294,491 +237,506 @@ static_assert(sizeof(TransactionEngine) <= 128u);
 // Inline function definitions
 //
 
-template<class _Ty, size_t _Cnt>
-inline _Ty* PooledList<_Ty, _Cnt>::GetEntry(size_t index) {
-	size_t pool = index / _Cnt;
-	size_t entry = index % _Cnt;
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+bool BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::ValidateReadSet() {
+	for (ReadSetEntry& entry : read_set_) {
+		LockEntry& lock{ lock_table_[entry.GetIndex()] };
+		Version v{ _Locks::Load(lock) };
+		if (!_Locks::IsReadLocked(v)) {
+			if (_Locks::GetVersion(v) != entry.GetVersion()) {
+				return false;
+			}
+			continue;
+		}
 
-	if (pool != 0) {
-		throw std::runtime_error{ "Out of memory" };
+		// Stripes locked by this transaction itself are still valid if nobody committed in between
+		if (!_Locks::IsLockedBy(lock, id_)) {
+			return false;
+		}
+		WriteSetEntry* locked{ write_set_.Get(entry.GetIndex()) };
+		if ((locked == nullptr) || (locked->GetVersion() != entry.GetVersion())) {
+			return false;
+		}
 	}
-
-	return reinterpret_cast<_Ty*>(reinterpret_cast<uint8_t*>(main_pool_) + (kEntrySize * entry));
+	return true;
 }
 
-template<class _Ty, size_t _Cnt>
-PooledList<_Ty, _Cnt>::PooledList() {
-}
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+bool BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::ValidateWriteSet() {
+	for (WriteSetEntry& entry : write_set_) {
+		// The version the stripe had when this transaction locked it
+		const Version locked{ entry.GetVersion() };
 
-template<class _Ty, size_t _Cnt>
-PooledList<_Ty, _Cnt>::~PooledList() {
-	if(main_pool_ != nullptr) {
-		for (size_t i{ 0 }; i < _Cnt; i++) {
-			GetEntry(i)->~_Ty();
+		const ReadSetEntry* read{ read_set_.Get(entry.GetIndex()) };
+		if (read != nullptr) {
+			if (locked != read->GetVersion()) {
+				return false;
+			}
+		} else if (locked > meta_->snapshot[GetDomain(entry.GetIndex())]) {
+			return false;
 		}
-
-		delete reinterpret_cast<PoolPage*>(main_pool_);
-		main_pool_ = nullptr;
 	}
+	return true;
 }
 
-template<class _Ty, size_t _Cnt>
-void PooledList<_Ty, _Cnt>::Init() {
-	assert(main_pool_ == nullptr);
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+bool BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::Extend() {
+	const size_t num_domains{ _Clock::GetNumDomains() };
 
-	main_pool_ = new PoolPage{};
-	for (size_t i{ 0 }; i < _Cnt; i++) {
-		new (GetEntry(i))_Ty{};
+	Version snapshot[kMaxDomains];
+	for (size_t domain{ 0 }; domain < num_domains; domain++) {
+		snapshot[domain] = _Clock::Get(domain);
 	}
-}
 
-template<class _Ty, size_t _Cnt>
-_Ty* PooledList<_Ty, _Cnt>::Create(Key key) {
-	size_t index = next_index_++;
-	_Ty* entry{ GetEntry(index) };
-	*entry = key;
-	return entry;
+	if (ValidateReadSet()) {
+		std::copy(snapshot, snapshot + num_domains, meta_->snapshot);
+		return true;
+	}
+	return false;
 }
 
-template<class _Ty, size_t _Cnt>
-_Ty* PooledList<_Ty, _Cnt>::GetOrCreate(Key key) {
-	for (size_t i{ 0 }; i < next_index_; i++) {
-		_Ty* entry{ GetEntry(i) };
-		if (*entry == key) {
-			return entry;
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+void BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::TickWrittenDomains() {
+	for (size_t domain{ 0 }; domain < _Clock::GetNumDomains(); domain++) {
+		if ((meta_->write_domains & (1u << domain)) != 0u) {
+			meta_->commit[domain] = _Clock::Tick(domain);
 		}
 	}
-
-	// Create new entry
-	size_t index = next_index_++;
-	_Ty* entry{ GetEntry(index) };
-	*entry = key;
-	return entry;
 }
 
-template<class _Ty, size_t _Cnt>
-_Ty* PooledList<_Ty, _Cnt>::Get(Key key) {
-	for (size_t i{ 0 }; i < next_index_; i++) {
-		_Ty* entry{ GetEntry(i) };
-		if (*entry == key) {
-			return entry;
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+bool BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::NeedsValidation() const {
+	const uint32_t domains{ meta_->read_domains | meta_->write_domains };
+	for (size_t domain{ 0 }; domain < _Clock::GetNumDomains(); domain++) {
+		const uint32_t bit{ 1u << domain };
+		if ((domains & bit) == 0u) {
+			continue;
 		}
-	}
-	return nullptr;
-}
 
-template<class _Ty, size_t _Cnt>
-bool PooledList<_Ty, _Cnt>::Contains(Key key) {
-	for (size_t i{ 0 }; i < next_index_; i++) {
-		const _Ty* entry{ GetEntry(i) };
-		if (*entry == key) {
+		// The own commit accounts for one increment of a written domain
+		const Version current{ ((meta_->write_domains & bit) != 0u) ? meta_->commit[domain] - 1u : _Clock::Get(domain) };
+		if (current > meta_->snapshot[domain]) {
 			return true;
 		}
 	}
 	return false;
 }
 
-template<class _Ty, size_t _Cnt>
-void PooledList<_Ty, _Cnt>::Clear() {
-	next_index_ = 0;
-}
-
-template<class _Ty, size_t _Cnt>
-bool PooledList<_Ty, _Cnt>::Empty() const {
-	return next_index_ == 0;
-}
-
-template<class _Ty, size_t _Cnt>
-size_t PooledList<_Ty, _Cnt>::GetSize() const {
-	return next_index_;
-}
-		
-template<class _Ty, size_t _Cnt>
-PooledList<_Ty, _Cnt>::Iterator::Iterator(PooledList& list, size_t start) : list_{ &list }, current_index_{ start } {
-}
-		
-template<class _Ty, size_t _Cnt>
-PooledList<_Ty, _Cnt>::Iterator::Iterator(const Iterator& other) : list_{ other.list }, current_index_{ other.current_index } {
-}
-
-template<class _Ty, size_t _Cnt>
-PooledList<_Ty, _Cnt>::Iterator::Iterator(Iterator&& other) : list_{ other.list }, current_index_{ other.currnet_index } {
-}
-
-template<class _Ty, size_t _Cnt>
-typename PooledList<_Ty, _Cnt>::Iterator& PooledList<_Ty, _Cnt>::Iterator::operator=(const Iterator& other) {
-	list_ = other.list_;
-	current_index_ = other.current_index_;
-	return *this;
-}
-
-template<class _Ty, size_t _Cnt>
-typename PooledList<_Ty, _Cnt>::Iterator& PooledList<_Ty, _Cnt>::Iterator::operator=(Iterator&& other) {
-	list_ = other.list_;
-	current_index_ = other.current_index_;
-	return *this;
-}
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+void BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::Rollback() {
+	DepartReaders();
 
-template<class _Ty, size_t _Cnt>
-bool PooledList<_Ty, _Cnt>::Iterator::operator==(const Iterator& other) const {
-	return current_index_ == other.current_index_;
-}
-
-template<class _Ty, size_t _Cnt>
-bool PooledList<_Ty, _Cnt>::Iterator::operator!=(const Iterator& other) const {
-	return current_index_ != other.current_index_;
-}
-
-template<class _Ty, size_t _Cnt>
-typename PooledList<_Ty, _Cnt>::Iterator& PooledList<_Ty, _Cnt>::Iterator::operator++() {
-	current_index_++;
-	return *this;
-}
-
-template<class _Ty, size_t _Cnt>
-typename PooledList<_Ty, _Cnt>::Iterator::reference PooledList<_Ty, _Cnt>::Iterator::operator*() {
-	return *(list_->GetEntry(current_index_));
-}
-
-template<class _Ty, size_t _Cnt>
-typename PooledList<_Ty, _Cnt>::Iterator PooledList<_Ty, _Cnt>::begin() {
-	return Iterator{ *this, 0u };
-}
-
-template<class _Ty, size_t _Cnt>
-typename PooledList<_Ty, _Cnt>::Iterator PooledList<_Ty, _Cnt>::end() {
-	return Iterator{ *this, next_index_ };
-}
+	if constexpr (_Log::kInPlace) {
+		if (write_set_.Empty()) {
+			read_set_.Clear();
+			return;
+		}
 
-uint64_t Xoroshiro128pp::Rotl(const uint64_t x, int k) {
-	return (x << k) | (x >> (64 - k));
-}
+		log_.Undo();
 
-Xoroshiro128pp::Xoroshiro128pp() {
-	s_[0] = 0xdad6490a0e036cbfu;
-	s_[1] = 0x282ef0c42968addcu;
-}
+		// Readers may have seen the uncommitted data between their version checks, so the
+		// restored data needs a new version.
+		TickWrittenDomains();
+		for (WriteSetEntry& entry : write_set_) {
+			_Locks::Release(lock_table_[entry.GetIndex()], meta_->commit[GetDomain(entry.GetIndex())]);
+		}
+	} else if constexpr (_Locking::kAcquireOnWrite) {
+		for (WriteSetEntry& entry : write_set_) {
+			_Locks::Unlock(lock_table_[entry.GetIndex()], entry.GetVersion());
+		}
+	}
 
-Xoroshiro128pp::Xoroshiro128pp(uint64_t s0, uint64_t s1) : s_{ s0, s1 } {
+	read_set_.Clear();
+	write_set_.Clear();
+	log_.Clear();
 }
 
-uint64_t Xoroshiro128pp::Next() {
-	const uint64_t s0 = s_[0];
-	uint64_t s1 = s_[1];
-	const uint64_t result = Rotl(s0 + s1, 17) + s0;
-
-	s1 ^= s0;
-	s_[0] = Rotl(s0, 49) ^ s1 ^ (s1 << 21);
-	s_[1] = Rotl(s1, 28);
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+Word BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::ReadVisible(void* address, LockIndex index, LockEntry& lock, ReaderIndicator& indicator) {
+	if (!HoldsReader(&indicator)) {
+		const size_t node{ util::GetCurrentNode() % kReaderNodes };
 
-	return result;
-}
-
-void Xoroshiro128pp::Jump() {
-    constexpr uint64_t kJump[] = { 0x2bd7a6a6e99c2ddc, 0x0992ccaf6a6fca05 };
+		size_t spins{ 0u };
+		while (true) {
+			indicator.Arrive(node);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (!_Locks::IsLocked(lock)) {
+				break;
+			}
 
-	uint64_t s0 = 0;
-	uint64_t s1 = 0;
-	for(int i = 0; i < sizeof kJump / sizeof *kJump; i++)
-		for(int b = 0; b < 64; b++) {
-			if (kJump[i] & static_cast<uint64_t>(1u) << b) {
-				s0 ^= s_[0];
-				s1 ^= s_[1];
+			// A writer is waiting for the readers to leave. Leave as well and wait for it instead.
+			indicator.Depart(node);
+			while (_Locks::IsLocked(lock)) {
+				if (++spins > kMaxReadSpins) {
+					ProfileConflict(index, address);
+					Rollback();
+					throw TransactionError{ "Visible stripe stayed locked", true };
+				}
+				if ((spins % kHelpSpins) == 0u) {
+					HelpOwner(lock);
+				}
 			}
-			Next();
 		}
 
-	s_[0] = s0;
-	s_[1] = s1;
-}
-
-ReadSetEntry& ReadSetEntry::operator=(Key nindex) {
-	index_ = nindex;
-	return *this;
-}
-
-bool ReadSetEntry::operator==(Key other) const {
-	return index_ == other;
-}
-
-void ReadSetEntry::SetVersion(Version new_version) noexcept {
-	old_version_ = new_version;
-}
-
-ReadSetEntry::Key ReadSetEntry::GetIndex() const noexcept {
-	return index_;
-}
+		meta_->readers.indicators[meta_->readers.count] = &indicator;
+		meta_->readers.nodes[meta_->readers.count] = node;
+		meta_->readers.count++;
+	}
 
-Version ReadSetEntry::GetVersion() const noexcept {
-	return old_version_;
-}
+	// Writers wait for this transaction so neither the data nor the version change from here on
+	const Version version{ _Locks::GetVersion(_Locks::Load(lock)) };
+	const Word data{ LoadWord(address) };
 
-WriteSetEntry& WriteSetEntry::operator=(Key new_index) {
-	index_ = new_index;
-	return *this;
-}
-
-bool WriteSetEntry::operator==(Key other) const {
-	return index_ == other;
-}
+	if (version > meta_->snapshot[GetDomain(index)]) {
+		if (!Extend()) {
+			ProfileConflict(index, address);
+			Rollback();
+			throw TransactionError{ "Read inconsistent state", true };
+		}
+	}
 
-WriteSetEntry::Key WriteSetEntry::GetIndex() const noexcept {
-	return index_;
+	return data;
 }
 
-
-WriteData& WriteData::operator=(Key new_addr) {
-	address_ = new_addr;
-	return *this;
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+bool BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::HoldsReader(const ReaderIndicator* indicator) const {
+	for (size_t i{ 0 }; i < meta_->readers.count; i++) {
+		if (meta_->readers.indicators[i] == indicator) {
+			return true;
+		}
+	}
+	return false;
 }
 
-bool WriteData::operator==(Key other) const {
-	return address_ == other;
-}
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+bool BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::WaitForReaders(LockIndex index) {
+	const ReaderIndicator* indicator{ GetReaderIndicator(index) };
+	if (indicator == nullptr) {
+		return true;
+	}
 
-void WriteData::Set(Word new_data, Word new_mask) {
-	data_ = new_data;
-	mask_ = new_mask;
-}
+	// Pairs with the fence of arriving readers. Either they see the lock or the lock owner sees them.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
 
-void WriteData::Extend(Word new_data, Word new_mask) {
-	data_ = (data_ & ~new_mask) | (new_data & new_mask);
-	mask_ |= new_mask;
+	const uint32_t own{ HoldsReader(indicator) ? 1u : 0u };
+	for (size_t spins{ 0 }; indicator->GetNumReaders() != own; spins++) {
+		if (spins == kMaxReaderWaitSpins) {
+			return false;
+		}
+	}
+	return true;
 }
 
-WriteData::Key WriteData::GetAddress() const noexcept {
-	return address_;
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+void BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::DepartReaders() {
+	for (size_t i{ 0 }; i < meta_->readers.count; i++) {
+		meta_->readers.indicators[i]->Depart(meta_->readers.nodes[i]);
+	}
+	meta_->readers.count = 0u;
 }
 
-Word WriteData::GetData() const noexcept {
-	return data_;
-}
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+bool BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::AcquireWriteLock(LockEntry& lock, Version& version) {
+	size_t spins{ 0u };
+	while (true) {
+		if (_Locks::IsLocked(lock)) {
+			if (CmShouldAbort(lock)) {
+				return false;
+			}
+			if (++spins == kHelpSpins) {
+				HelpOwner(lock);
+				spins = 0u;
+			}
+			continue;
+		}
 
-Word WriteData::GetMask() const noexcept {
-	return mask_;
+		if (_Locks::TryLock(lock, id_, version)) {
+			return true;
+		}
+	}
 }
 
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+bool BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::AcquireWriteLocks() {
+	size_t acquired{ 0u };
+	for (WriteSetEntry& entry : write_set_) {
+		Version version;
+		bool locked{ AcquireWriteLock(lock_table_[entry.GetIndex()], version) };
+		if (locked) {
+			entry.SetVersion(version);
+			acquired++;
+			locked = WaitForReaders(entry.GetIndex());
+		}
 
-void TransactionEngine::CommitData(WriteData& data) {
-	volatile Word* addr{ reinterpret_cast<Word*>(data.GetAddress()) };
-	*addr = (*addr & ~(data.GetMask())) | (data.GetData() & data.GetMask());
-}
-
-bool TransactionEngine::ValidateReadSet() {
-	for (ReadSetEntry& entry : read_set_) {
-		LockEntry& lock{ lock_table_[entry.GetIndex()] };
-		Version v{ lock.r_lock.Get() };
-		if (lock.r_lock.Get() != entry.GetVersion()) {
-			if (!((v & ReadLock::kLockMask) && lock.w_lock.IsLockedBy(this))) {
-				return false;
+		if (!locked) {
+			for (WriteSetEntry& locked : write_set_) {
+				if (acquired-- == 0u) {
+					break;
+				}
+				_Locks::Unlock(lock_table_[locked.GetIndex()], locked.GetVersion());
 			}
+			return false;
 		}
 	}
 	return true;
 }
 
-bool TransactionEngine::Extend() {
-	Version new_version{ GetGlobalVersion() };
-	if (ValidateReadSet()) {
-		version_ = new_version;
-		return true;
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+bool BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::CmShouldAbort(LockEntry& lock) {
+	// The owner may terminate and unregister at any time in which case the conflict is resolved
+	// anyway. The pin keeps it alive, the recheck makes sure it still owns the lock.
+	const ThreadId owner_id{ _Locks::GetOwner(lock) };
+	const PinnedEngine pin{ owner_id };
+	BasicTransactionEngine* owner{ static_cast<BasicTransactionEngine*>(pin.Get()) };
+	if ((owner != nullptr) && (_Locks::GetOwner(lock) != owner_id)) {
+		owner = nullptr;
 	}
-	return false;
-}
 
-void TransactionEngine::Rollback() {
-	for (WriteSetEntry& entry : write_set_) {
-		lock_table_[entry.GetIndex()].w_lock.Unlock();
+	if (cm_.ShouldAbort(owner != nullptr ? &owner->cm_ : nullptr)) {
+		return true;
 	}
 
-	read_set_.Clear();
-	write_set_.Clear();
-	write_data_.Clear();
+	if (owner) {
+		owner->MarkAbort();
+	}
+	return false;
 }
 
-void TransactionEngine::CmOnStart() {
-	cm_ts_.store(std::numeric_limits<Version>::max());
-	cm_backoff_ = 0;
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+void BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::HelpOwner(const LockEntry& lock) {
+	if constexpr (kHelping) {
+		const ThreadId owner_id{ _Locks::GetOwner(lock) };
+		const PinnedEngine pin{ owner_id };
+		BasicTransactionEngine* owner{ static_cast<BasicTransactionEngine*>(pin.Get()) };
+		if ((owner != nullptr) && (owner != this) && (_Locks::GetOwner(lock) == owner_id)) {
+			owner->HelpCommit();
+		}
+	}
 }
 
-void TransactionEngine::CmOnRestart() {
-	uint16_t rand = static_cast<uint16_t>(rng_.Next() & 0xF);
-
-	cm_backoff_ += rand;
-	std::this_thread::sleep_for(std::chrono::nanoseconds(cm_backoff_));
-	cm_backoff_ = cm_backoff_ << 1u;
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+void BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::MarkAbort() {
+	// TODO
 }
 
-void TransactionEngine::CmOnWrite() {
-	if (cm_ts_.load(std::memory_order_relaxed) == std::numeric_limits<Version>::max()) {
-		if (write_set_.GetSize() >= 10) {
-			cm_ts_.store(GetIncGreedyVersion());
-		}
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+void BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::Begin(State state) {
+	if (state_ == state) {
+		cm_.OnRestart(rng_);
 	}
-}
-
-bool TransactionEngine::CmShouldAbort(WriteLock& lock) {
-	Version ts{ cm_ts_.load(std::memory_order_relaxed) };
-	if (ts == std::numeric_limits<Version>::max()) {
-		return true;
+	else {
+		assert(state_ == State::INITIALIZED);
+		cm_.OnStart();
 	}
 
-	TransactionEngine* owner = lock.GetOwner();
-	if (owner) {
-		if (owner->cm_ts_.load() < ts) {
-			return true;
-		}
-
-		owner->MarkAbort();
+	for (size_t domain{ 0 }; domain < _Clock::GetNumDomains(); domain++) {
+		meta_->snapshot[domain] = _Clock::Get(domain);
 	}
+	meta_->read_domains = 0u;
+	meta_->write_domains = 0u;
 
-	return false;
+	elastic_ = false;
+	snapshot_isolation_ = false;
+	state_ = state;
 }
 
-void TransactionEngine::MarkAbort() {
-	// TODO
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+PromotionState BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::IsReadWriteCompatible() const {
+	return ReadWriteCompatibility(state_);
 }
 
-PromotionState TransactionEngine::IsReadWriteCompatible() const {
-    if((state_ & State::RUNNING_bit) == State::NONE_mask) {
-        return PromotionState::NO_RUNNING;
-    }
-
-    if(state_ == State::READ_WRITE_RUNNING) {
-        return PromotionState::COMPATIBLE;
-    } else {
-        return PromotionState::INCOMPATIBLE;
-    }
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+PromotionState BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::IsReadOnlyCompatible() const {
+	return ReadOnlyCompatibility(state_);
 }
 
-PromotionState TransactionEngine::IsReadOnlyCompatible() const {
-    if((state_ & State::RUNNING_bit) == State::NONE_mask) {
-        return PromotionState::NO_RUNNING;
-    }
-    
-    if((state_ == State::READ_WRITE_RUNNING) || (state_ == State::READ_ONLY_RUNNING)) {
-        return PromotionState::COMPATIBLE;
-    } else {
-        return PromotionState::INCOMPATIBLE;
-    }
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+void BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::BeginReadWrite() {
+	Begin(State::READ_WRITE_RUNNING);
 }
 
-void TransactionEngine::BeginReadWrite() {
-	if (state_ == State::READ_WRITE_RUNNING) {
-		CmOnRestart();
-	}
-	else {
-		assert(state_ == State::INITIALIZED);
-	}
-
-	version_ = GetGlobalVersion();
-	state_ = State::READ_WRITE_RUNNING;
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+void BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::BeginReadOnly() {
+	Begin(State::READ_ONLY_RUNNING);
 }
 
-void TransactionEngine::BeginReadOnly() {
-	if (state_ == State::READ_ONLY_RUNNING) {
-		CmOnRestart();
-	}
-	else {
-		assert(state_ == State::INITIALIZED);
-	}
-
-	version_ = GetGlobalVersion();
-	state_ = State::READ_ONLY_RUNNING;
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+void BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::BeginElastic() {
+	Begin(State::READ_WRITE_RUNNING);
+	elastic_ = true;
 }
 
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+void BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::BeginSnapshot() {
+	Begin(State::READ_WRITE_RUNNING);
+	snapshot_isolation_ = true;
+}
 
-void TransactionEngine::Commit() {
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+void BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::Commit() {
 	assert((state_ & State::RUNNING_bit) == State::RUNNING_bit);
 
 	if (state_ == State::READ_ONLY_RUNNING) {
+		DepartReaders();
+		read_set_.Clear();
 		state_ = State::INITIALIZED;
 		return;
 	}
 
 	if (!write_set_.Empty()) {
-		for (WriteSetEntry& entry : write_set_) {
-			lock_table_[entry.GetIndex()].r_lock.Lock();
+		if constexpr (!_Locking::kAcquireOnWrite) {
+			if (!AcquireWriteLocks()) {
+				Rollback();
+				throw TransactionError{ "Failed to acquire write locks", true };
+			}
 		}
 
-		Version new_version = GetIncGlobalVersion();
+		if constexpr (!_Log::kInPlace) {
+			for (WriteSetEntry& entry : write_set_) {
+				_Locks::BlockReaders(lock_table_[entry.GetIndex()]);
+			}
+		}
 
-		if (new_version > version_ + 1) {
-			// Extended validation needed
-			if (!ValidateReadSet()) {
-				for (WriteSetEntry& entry : write_set_) {
-					lock_table_[entry.GetIndex()].r_lock.Unlock();
-				}
-				Rollback();
+		TickWrittenDomains();
 
-				throw TransactionError{ "Failed to validate read set", true };
+		bool valid{ true };
+		if (snapshot_isolation_) {
+			// Stripes locked on write can not have changed since they were checked against the snapshot
+			if constexpr (!_Locking::kAcquireOnWrite) {
+				valid = ValidateWriteSet();
 			}
+		} else if (NeedsValidation()) {
+			// Extended validation needed
+			valid = ValidateReadSet();
 		}
 
-		for (WriteData& data : write_data_) {
-			CommitData(data);
+		if (!valid) {
+			for (WriteSetEntry& entry : write_set_) {
+				LockEntry& lock{ lock_table_[entry.GetIndex()] };
+				if constexpr (!_Log::kInPlace) {
+					_Locks::UnblockReaders(lock);
+				}
+				if constexpr (!_Locking::kAcquireOnWrite) {
+					_Locks::Unlock(lock, entry.GetVersion());
+				}
+			}
+			Rollback();
+
+			throw TransactionError{ snapshot_isolation_ ? "Failed to validate write set" : "Failed to validate read set", true };
 		}
 
-		for (WriteSetEntry& entry : write_set_) {
-			LockEntry& lock{ lock_table_[entry.GetIndex()] };
-			lock.r_lock.Unlock(new_version);
-			lock.w_lock.Unlock();
+		if constexpr (kHelping) {
+			commit_.Publish(meta_->commit);
+			RunWriteBackHook();
+
+			// Helpers may have released the stripes already, the log must stay intact until they did
+			if (!commit_.Enter() || !FinishWriteBack()) {
+				commit_.WaitReleased();
+			}
+		} else {
+			if constexpr (!_Log::kInPlace) {
+				log_.WriteBack();
+			}
+
+			for (WriteSetEntry& entry : write_set_) {
+				_Locks::Release(lock_table_[entry.GetIndex()], meta_->commit[GetDomain(entry.GetIndex())]);
+			}
 		}
 	}
 
+	DepartReaders();
 	read_set_.Clear();
 	write_set_.Clear();
-	write_data_.Clear();
+	log_.Clear();
 
 	state_ = State::INITIALIZED;
 }
 
-void TransactionEngine::End() {
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+void BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::End() {
 	assert((state_ & State::RUNNING_bit) == State::RUNNING_bit);
 
-	for (WriteSetEntry& entry : write_set_) {
-		lock_table_[entry.GetIndex()].w_lock.Unlock();
-	}
-
-	read_set_.Clear();
-	write_set_.Clear();
-	write_data_.Clear();
+	Rollback();
 
 	state_ = State::INITIALIZED;
 }
 
-Word TransactionEngine::ReadWord(void* address) {
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+Word BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::ReadWord(void* address) {
 	LockIndex index{ GetLockIndex(address) };
 	LockEntry& lock{ lock_table_[index] };
 
-	if (lock.w_lock.IsLockedBy(this)) {
-		WriteData* entry{ write_data_.Get(reinterpret_cast<size_t>(address)) };
-		assert(entry != nullptr);
-			
-		return entry->GetData();
+	if constexpr (_Locking::kAcquireOnWrite) {
+		if (_Locks::IsLockedBy(lock, id_)) {
+			// Nobody else can commit to this stripe so memory is consistent unless we have written to it
+			if constexpr (!_Log::kInPlace) {
+				Word buffered;
+				if (log_.Read(address, buffered)) {
+					return buffered;
+				}
+			}
+			return LoadWord(address);
+		}
+	} else {
+		if (!write_set_.Empty()) {
+			Word buffered;
+			if (log_.Read(address, buffered)) {
+				return buffered;
+			}
+		}
+	}
+
+	ReaderIndicator* indicator{ GetReaderIndicator(index) };
+	if (indicator != nullptr) {
+		return ReadVisible(address, index, lock, *indicator);
 	}
 
 	Word data;
 
-	Version v1 = lock.r_lock.Get();
+	size_t spins{ 0u };
+	Version v1 = _Locks::Load(lock);
 	while (true) {
-		if (v1 & ReadLock::kLockMask) {
-			v1 = lock.r_lock.Get();
+		if (_Locks::IsReadLocked(v1)) {
+			if constexpr (kLongReadLocks) {
+				// Such writers hold the lock until they terminate so waiting for them could deadlock
+				if (++spins > kMaxReadSpins) {
+					ProfileConflict(index, address);
+					Rollback();
+					throw TransactionError{ "Read locked stripe", true };
+				}
+			} else if (++spins == kHelpSpins) {
+				// The owner is committing. Finish its write back instead of waiting for it.
+				HelpOwner(lock);
+				spins = 0u;
+			}
+			v1 = _Locks::Load(lock);
 			continue;
 		}
 
-		data = *((volatile Word*) address);
+		data = LoadWord(address);
+		std::atomic_thread_fence(std::memory_order_acquire);
 
-		Version v2 = lock.r_lock.Get();
+		Version v2 = _Locks::Load(lock);
 		if (v2 == v1) {
 			break;
 		}
 		v1 = v2;
 	}
 
-	ReadSetEntry* entry{ read_set_.GetOrCreate(index) };
-	if (v1 > version_) {
+	const Version version{ _Locks::GetVersion(v1) };
+	if (!read_set_.Contains(index)) {
+		read_set_.Create(index)->SetVersion(version);
+		meta_->read_domains |= 1u << GetDomain(index);
+
+		// Only consecutive reads of an elastic transaction need to be consistent with each other
+		if (elastic_ && (read_set_.GetSize() > kElasticWindow)) {
+			read_set_.RemoveFirst();
+		}
+	}
+
+	if (version > meta_->snapshot[GetDomain(index)]) {
 		if (!Extend()) {
+			ProfileConflict(index, address);
 			Rollback();
 			throw TransactionError{ "Read inconsistent state", true };
 		}
@@ -787,60 +745,127 @@ Word TransactionEngine::ReadWord(void* address) {
 	return data;
 }
 
-void TransactionEngine::WriteWord(void* address, Word data, Word mask) {
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+void BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::WriteWord(void* address, Word data, Word mask) {
+	constexpr Word kFullMask{ ~static_cast<Word>(0) };
+
+	// The elastic prefix ends with the first write. Everything read from here on is tracked.
+	elastic_ = false;
+
 	LockIndex index{ GetLockIndex(address) };
 	LockEntry& lock{ lock_table_[index] };
 
-	if (lock.w_lock.IsLockedBy(this)) {
-		WriteData* entry{ write_data_.Get(reinterpret_cast<size_t>(address)) };
-				
-		if (entry == nullptr) {
-			entry = write_data_.Create(reinterpret_cast<size_t>(address));
-			assert(entry != nullptr);
+	if constexpr (_Locking::kAcquireOnWrite) {
+		if (!_Locks::IsLockedBy(lock, id_)) {
+			Version version;
+			if (!AcquireWriteLock(lock, version)) {
+				ProfileConflict(index, address);
+				Rollback();
+				throw TransactionError{ "Write conflict", true };
+			}
+			write_set_.Create(index)->SetVersion(version);
+			meta_->write_domains |= 1u << GetDomain(index);
+
+			if (!WaitForReaders(index)) {
+				ProfileConflict(index, address);
+				Rollback();
+				throw TransactionError{ "Visible readers did not leave", true };
+			}
+
+			if constexpr (_Log::kInPlace) {
+				_Locks::BlockReaders(lock);
+			}
+
+			if (version > meta_->snapshot[GetDomain(index)]) {
+				if (!Extend()) {
+					ProfileConflict(index, address);
+					Rollback();
+					throw TransactionError{ "Inconsistent state after write", true };
+				}
+			}
 
-			entry->Set(data, mask);
+			cm_.OnWrite(write_set_.GetSize());
 		}
-		else {
-			entry->Extend(data, mask);
+	} else {
+		if (!write_set_.Contains(index)) {
+			write_set_.Create(index);
+			meta_->write_domains |= 1u << GetDomain(index);
+			cm_.OnWrite(write_set_.GetSize());
 		}
-		return;
 	}
 
-	WriteData* entry;
-	while (true) {
-		if (lock.w_lock.IsLocked()) {
-			if (CmShouldAbort(lock.w_lock)) {
-				Rollback();
-				throw TransactionError{ "Stuff", true };
+	if constexpr (_Log::kInPlace) {
+		log_.Write(address, data, mask);
+	} else {
+		if (log_.Extend(address, data, mask)) {
+			return;
+		}
+
+		if (mask != kFullMask) {
+			if constexpr (_Locking::kAcquireOnWrite) {
+				// The stripe is locked so the remaining bits can not change anymore
+				data = (data & mask) | (LoadWord(address) & ~mask);
+			} else {
+				// The remaining bits have to be validated like any other read
+				data = (data & mask) | (ReadWord(address) & ~mask);
 			}
-			continue;
 		}
-		if (lock.w_lock.TryLock(this)) {
-			write_set_.Create(index);
+		log_.Append(address, data, mask);
+	}
+}
 
-			entry = write_data_.Create(reinterpret_cast<size_t>(address));
-			assert(entry != nullptr);
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+void BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::Release(void* address) {
+	const LockIndex index{ GetLockIndex(address) };
 
-			break;
-		}
+	// The data written to a stripe may depend on what has been read from it so written stripes stay tracked
+	if (!write_set_.Contains(index)) {
+		read_set_.Remove(index);
 	}
+}
 
-	if (lock.r_lock.Get() > version_) {
-		if (!Extend()) {
-			Rollback();
-			throw TransactionError{ "Inconsistent state after write", true };
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+void BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::HelpCommit() {
+	if constexpr (kHelping) {
+		if (commit_.Enter()) {
+			FinishWriteBack();
 		}
 	}
+}
 
-	if (mask != ~static_cast<Word>(0)) {
-		data = (data & mask) | (*((volatile Word*) address) & ~mask);
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+bool BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::FinishWriteBack() {
+	if constexpr (kHelping) {
+		// Writing the same data twice is harmless since nobody else can write to the locked stripes
+		log_.WriteBack();
+		for (WriteSetEntry& entry : write_set_) {
+			_Locks::PublishVersion(lock_table_[entry.GetIndex()], commit_.GetVersion(GetDomain(entry.GetIndex())));
+		}
+
+		if (!commit_.Finish()) {
+			return false;
+		}
+
+		for (WriteSetEntry& entry : write_set_) {
+			_Locks::Unlock(lock_table_[entry.GetIndex()], entry.GetVersion());
+		}
+		commit_.MarkReleased();
 	}
-	entry->Set(data, mask);
+	return true;
+}
+
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+const CommitDescriptor& BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::GetCommitDescriptor() const {
+	return commit_;
+}
 
-	CmOnWrite();
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+ThreadId BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::GetId() const {
+	return id_;
 }
 
-TransactionEngine& TransactionEngine::GetThreadEngine() {
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>& BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::GetThreadEngine() {
 	return thread_engine;
 }
 
@@ -0,0 +1,642 @@
+/**
+ * Copyright 2020 Lorenzo Rai
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This file contains the policies a BasicTransactionEngine is configured with.
+ *
+ * An engine configuration combines a clock, a lock layout, a lock acquisition, a log and a
+ * contention management policy. Policies are resolved at compile time so all of their code is
+ * inlined into the engine.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <limits>
+#include <thread>
+
+#if defined(__AVX512BW__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "transactional.hpp"
+#include "transaction_data.hpp"
+#include "transaction_support.hpp"
+
+namespace nlane::transactional::detail {
+
+//
+// Clock policies
+//
+
+/**
+ * A version counter per domain. Transactions that only access the default domain use a single
+ * counter shared by all of them.
+ */
+struct DomainClocks {
+	// Returns the number of domains and therefore clocks
+	static inline size_t GetNumDomains();
+
+	// Returns the current version of a domain
+	static inline Version Get(size_t domain);
+
+	// Increments the version of a domain and returns its new value
+	static inline Version Tick(size_t domain);
+};
+
+//
+// Lock layout policies
+//
+
+/**
+ * Every stripe has a separate read lock holding the version and a write lock holding the owner.
+ * Readers are only blocked while a writer updates memory, not while it merely owns the stripe. (SwissTM)
+ */
+struct SplitLocks {
+	using Entry = LockEntry;
+
+	// True if the write lock also blocks readers
+	static constexpr bool kSingleWord{ false };
+
+	static inline Entry* GetTable();
+
+	// Returns the word readers check before and after reading a stripe
+	static inline Version Load(const Entry& lock);
+
+	// Returns true if readers must not access the stripe while the lock holds word
+	static inline bool IsReadLocked(Version word);
+
+	// Returns the version of a word that is not read locked
+	static inline Version GetVersion(Version word);
+
+	static inline bool IsLocked(const Entry& lock);
+	static inline bool IsLockedBy(const Entry& lock, ThreadId owner);
+	static inline ThreadId GetOwner(const Entry& lock);
+
+	// Attempts to acquire the write lock. On success version holds the version of the stripe
+	static inline bool TryLock(Entry& lock, ThreadId owner, Version& version);
+
+	// Blocks readers of a write locked stripe while its memory is updated
+	static inline void BlockReaders(Entry& lock);
+	static inline void UnblockReaders(Entry& lock);
+
+	// Releases the write lock and publishes a new version
+	static inline void Release(Entry& lock, Version new_version);
+
+	// Releases the write lock without changing the version. version is the one returned by TryLock
+	static inline void Unlock(Entry& lock, Version version);
+
+	// Unblocks readers and publishes a new version while the write lock stays held
+	static inline void PublishVersion(Entry& lock, Version new_version);
+};
+
+/**
+ * Every stripe has a single word holding either its version or its owner. Halves the memory
+ * traffic and footprint of the lock table but readers are blocked as long as a stripe is owned. (TL2)
+ */
+struct VersionedLocks {
+	using Entry = VersionedLock;
+
+	// True if the write lock also blocks readers
+	static constexpr bool kSingleWord{ true };
+
+	static inline Entry* GetTable();
+
+	// Returns the word readers check before and after reading a stripe
+	static inline Version Load(const Entry& lock);
+
+	// Returns true if readers must not access the stripe while the lock holds word
+	static inline bool IsReadLocked(Version word);
+
+	// Returns the version of a word that is not read locked
+	static inline Version GetVersion(Version word);
+
+	static inline bool IsLocked(const Entry& lock);
+	static inline bool IsLockedBy(const Entry& lock, ThreadId owner);
+	static inline ThreadId GetOwner(const Entry& lock);
+
+	// Attempts to acquire the write lock. On success version holds the version of the stripe
+	static inline bool TryLock(Entry& lock, ThreadId owner, Version& version);
+
+	// Blocks readers of a write locked stripe while its memory is updated
+	static inline void BlockReaders(Entry& lock);
+	static inline void UnblockReaders(Entry& lock);
+
+	// Releases the write lock and publishes a new version
+	static inline void Release(Entry& lock, Version new_version);
+
+	// Releases the write lock without changing the version. version is the one returned by TryLock
+	static inline void Unlock(Entry& lock, Version version);
+};
+
+//
+// Lock acquisition policies
+//
+
+/**
+ * Write locks are acquired as soon as a stripe is written for the first time.
+ * Conflicts between writers are detected early. (SwissTM)
+ */
+struct EncounterLocking {
+	static constexpr bool kAcquireOnWrite{ true };
+};
+
+/**
+ * Write locks are only acquired during commit. Until then writes are only buffered. (TL2)
+ */
+struct CommitLocking {
+	static constexpr bool kAcquireOnWrite{ false };
+};
+
+//
+// Log policies
+//
+
+/**
+ * Buffers all writes and writes them back to memory during commit.
+ */
+class RedoLog {
+  public:
+	// True if writes are performed directly in memory
+	static constexpr bool kInPlace{ false };
+
+  private:
+	PooledList<WriteData, 255> data_;
+
+	static inline void CommitData(WriteData& data);
+
+  public:
+	// Returns the number of bytes allocated for the log entries
+	inline size_t GetAllocatedBytes() const;
+
+	// Returns true and the buffered data for the word at address if it has been written
+	inline bool Read(void* address, Word& data);
+
+	// Updates the bits in mask of an already written word. Returns false if the word has not been written
+	inline bool Extend(void* address, Word data, Word mask);
+
+	// Buffers a new entry. data must already contain the current value of all bits outside of mask
+	inline void Append(void* address, Word data, Word mask);
+
+	// Writes all buffered data back to memory
+	inline void WriteBack();
+
+	inline bool Empty() const;
+	inline void Clear();
+};
+
+/**
+ * Buffers all writes grouped by cache line and writes them back one line at a time during
+ * commit. Uses masked vector stores if the target supports them so updates of contiguous
+ * structures only need a few stores.
+ */
+class LineRedoLog {
+  public:
+	// True if writes are performed directly in memory
+	static constexpr bool kInPlace{ false };
+
+  private:
+	PooledList<LineData, 255> lines_;
+
+	static inline void CommitLine(const LineData& line);
+
+  public:
+	// Returns the number of bytes allocated for the log entries
+	inline size_t GetAllocatedBytes() const;
+
+	// Returns true and the buffered data for the word at address if it has been written
+	inline bool Read(void* address, Word& data);
+
+	// Updates the bits in mask of an already written word. Returns false if the word has not been written
+	inline bool Extend(void* address, Word data, Word mask);
+
+	// Buffers a new entry. data must already contain the current value of all bits outside of mask
+	inline void Append(void* address, Word data, Word mask);
+
+	// Writes all buffered data back to memory
+	inline void WriteBack();
+
+	inline bool Empty() const;
+	inline void Clear();
+};
+
+/**
+ * Writes directly to memory and records the previous content so it can be restored on abort.
+ * Requires write locks to be acquired on write and the read lock of every written stripe to
+ * be held until the transaction terminates.
+ */
+class UndoLog {
+  public:
+	// True if writes are performed directly in memory
+	static constexpr bool kInPlace{ true };
+
+  private:
+	PooledList<UndoData, 255> data_;
+
+  public:
+	// Returns the number of bytes allocated for the log entries
+	inline size_t GetAllocatedBytes() const;
+
+	// Records the current content of the word at address and then updates it
+	inline void Write(void* address, Word data, Word mask);
+
+	// Restores all written words to their previous content
+	inline void Undo();
+
+	inline bool Empty() const;
+	inline void Clear();
+};
+
+//
+// Contention management policies
+//
+
+/**
+ * The two phase greedy contention manager described by SwissTM. A transaction gets a
+ * priority timestamp once it has performed a number of writes. Older transactions win
+ * conflicts, transactions without a timestamp always lose. Restarts are delayed with a
+ * randomized exponential backoff.
+ */
+class GreedyCm {
+  public:
+	// The number of written stripes after which a transaction gets a timestamp
+	static constexpr size_t kTimestampWrites{ 10u };
+
+  private:
+	std::atomic<Version> ts_{ std::numeric_limits<Version>::max() };
+	uint16_t backoff_{ 0u };
+
+	// The number of written stripes after which the running transaction gets a timestamp. Tuned per call site.
+	uint16_t timestamp_writes_{ kTimestampWrites };
+
+  public:
+	inline void OnStart();
+	inline void OnRestart(Xoroshiro128pp& rng);
+	inline void OnWrite(size_t num_writes);
+
+	// Returns true if this transaction should abort because of a conflict with owner
+	inline bool ShouldAbort(const GreedyCm* owner) const;
+};
+
+/**
+ * Always aborts the transaction that detects a conflict. Restarts are delayed with a
+ * randomized exponential backoff.
+ */
+class BackoffCm {
+  private:
+	uint16_t backoff_{ 0u };
+
+  public:
+	inline void OnStart();
+	inline void OnRestart(Xoroshiro128pp& rng);
+	inline void OnWrite(size_t num_writes);
+
+	// Returns true if this transaction should abort because of a conflict with owner
+	inline bool ShouldAbort(const BackoffCm* owner) const;
+};
+
+// Sleeps for the current backoff and increases it for the next restart
+inline void Backoff(uint16_t& backoff, Xoroshiro128pp& rng);
+
+
+//
+// Inline function definitions
+//
+
+size_t DomainClocks::GetNumDomains() {
+	return detail::GetNumDomains();
+}
+
+Version DomainClocks::Get(size_t domain) {
+	return GetDomainVersion(domain);
+}
+
+Version DomainClocks::Tick(size_t domain) {
+	return GetIncDomainVersion(domain);
+}
+
+SplitLocks::Entry* SplitLocks::GetTable() {
+	return GetLockTable();
+}
+
+Version SplitLocks::Load(const Entry& lock) {
+	return lock.r_lock.Get();
+}
+
+bool SplitLocks::IsReadLocked(Version word) {
+	return (word & ReadLock::kLockMask) != 0u;
+}
+
+Version SplitLocks::GetVersion(Version word) {
+	return word;
+}
+
+bool SplitLocks::IsLocked(const Entry& lock) {
+	return lock.w_lock.IsLocked();
+}
+
+bool SplitLocks::IsLockedBy(const Entry& lock, ThreadId owner) {
+	return lock.w_lock.IsLockedBy(owner);
+}
+
+ThreadId SplitLocks::GetOwner(const Entry& lock) {
+	return lock.w_lock.GetOwner();
+}
+
+bool SplitLocks::TryLock(Entry& lock, ThreadId owner, Version& version) {
+	if (!lock.w_lock.TryLock(owner)) {
+		return false;
+	}
+
+	// Only the write lock holder changes the read lock so the version is stable from here on
+	version = lock.r_lock.Get() & ~ReadLock::kLockMask;
+	return true;
+}
+
+void SplitLocks::BlockReaders(Entry& lock) {
+	lock.r_lock.Lock();
+}
+
+void SplitLocks::UnblockReaders(Entry& lock) {
+	lock.r_lock.Unlock();
+}
+
+void SplitLocks::Release(Entry& lock, Version new_version) {
+	lock.r_lock.Unlock(new_version);
+	lock.w_lock.Unlock();
+}
+
+void SplitLocks::Unlock(Entry& lock, Version) {
+	lock.w_lock.Unlock();
+}
+
+void SplitLocks::PublishVersion(Entry& lock, Version new_version) {
+	lock.r_lock.Unlock(new_version);
+}
+
+VersionedLocks::Entry* VersionedLocks::GetTable() {
+	return GetVersionedLockTable();
+}
+
+Version VersionedLocks::Load(const Entry& lock) {
+	return lock.Get();
+}
+
+bool VersionedLocks::IsReadLocked(Version word) {
+	return VersionedLock::IsLocked(word);
+}
+
+Version VersionedLocks::GetVersion(Version word) {
+	return VersionedLock::GetVersion(word);
+}
+
+bool VersionedLocks::IsLocked(const Entry& lock) {
+	return lock.IsLocked();
+}
+
+bool VersionedLocks::IsLockedBy(const Entry& lock, ThreadId owner) {
+	return lock.IsLockedBy(owner);
+}
+
+ThreadId VersionedLocks::GetOwner(const Entry& lock) {
+	return lock.GetOwner();
+}
+
+bool VersionedLocks::TryLock(Entry& lock, ThreadId owner, Version& version) {
+	return lock.TryLock(owner, version);
+}
+
+void VersionedLocks::BlockReaders(Entry&) {
+	// Readers are already blocked by the write lock. Readers that see data written after this
+	// call must also see the lock.
+	std::atomic_thread_fence(std::memory_order_release);
+}
+
+void VersionedLocks::UnblockReaders(Entry&) {
+}
+
+void VersionedLocks::Release(Entry& lock, Version new_version) {
+	lock.Unlock(new_version);
+}
+
+void VersionedLocks::Unlock(Entry& lock, Version version) {
+	lock.Unlock(version);
+}
+
+void RedoLog::CommitData(WriteData& data) {
+	void* addr{ reinterpret_cast<void*>(data.GetAddress()) };
+	StoreWord(addr, (LoadWord(addr) & ~(data.GetMask())) | (data.GetData() & data.GetMask()));
+}
+
+size_t RedoLog::GetAllocatedBytes() const {
+	return data_.GetAllocatedBytes();
+}
+
+bool RedoLog::Read(void* address, Word& data) {
+	WriteData* entry{ data_.Get(reinterpret_cast<size_t>(address)) };
+	if (entry == nullptr) {
+		return false;
+	}
+
+	data = entry->GetData();
+	return true;
+}
+
+bool RedoLog::Extend(void* address, Word data, Word mask) {
+	WriteData* entry{ data_.Get(reinterpret_cast<size_t>(address)) };
+	if (entry == nullptr) {
+		return false;
+	}
+
+	entry->Extend(data, mask);
+	return true;
+}
+
+void RedoLog::Append(void* address, Word data, Word mask) {
+	data_.Create(reinterpret_cast<size_t>(address))->Set(data, mask);
+}
+
+void RedoLog::WriteBack() {
+	for (WriteData& data : data_) {
+		CommitData(data);
+	}
+}
+
+bool RedoLog::Empty() const {
+	return data_.Empty();
+}
+
+void RedoLog::Clear() {
+	data_.Clear();
+}
+
+void LineRedoLog::CommitLine(const LineData& line) {
+	Word* addr{ reinterpret_cast<Word*>(line.GetAddress()) };
+
+#if defined(__AVX512BW__)
+	_mm512_mask_storeu_epi8(addr, line.GetByteMask(), _mm512_load_si512(line.GetData()));
+#elif defined(__AVX2__)
+	// Only whole words can be masked. Written words are stored entirely which is fine since their
+	// remaining bits already hold the current content.
+	for (size_t half{ 0 }; half < LineData::kWordsPerLine; half += 4u) {
+		const __m256i mask{ _mm256_setr_epi64x(
+			line.Contains(half) ? -1 : 0,
+			line.Contains(half + 1u) ? -1 : 0,
+			line.Contains(half + 2u) ? -1 : 0,
+			line.Contains(half + 3u) ? -1 : 0) };
+		const __m256i data{ _mm256_load_si256(reinterpret_cast<const __m256i*>(line.GetData() + half)) };
+		_mm256_maskstore_epi64(reinterpret_cast<long long*>(addr + half), mask, data);
+	}
+#else
+	for (size_t i{ 0 }; i < LineData::kWordsPerLine; i++) {
+		if (line.Contains(i)) {
+			StoreWord(addr + i, line.GetWord(i));
+		}
+	}
+#endif
+}
+
+size_t LineRedoLog::GetAllocatedBytes() const {
+	return lines_.GetAllocatedBytes();
+}
+
+bool LineRedoLog::Read(void* address, Word& data) {
+	const size_t addr{ reinterpret_cast<size_t>(address) };
+	LineData* line{ lines_.Get(addr & ~LineData::kLineMask) };
+
+	const size_t index{ LineData::GetWordIndex(addr) };
+	if ((line == nullptr) || !line->Contains(index)) {
+		return false;
+	}
+
+	data = line->GetWord(index);
+	return true;
+}
+
+bool LineRedoLog::Extend(void* address, Word data, Word mask) {
+	const size_t addr{ reinterpret_cast<size_t>(address) };
+	LineData* line{ lines_.Get(addr & ~LineData::kLineMask) };
+
+	const size_t index{ LineData::GetWordIndex(addr) };
+	if ((line == nullptr) || !line->Contains(index)) {
+		return false;
+	}
+
+	line->Extend(index, data, mask);
+	return true;
+}
+
+void LineRedoLog::Append(void* address, Word data, Word mask) {
+	const size_t addr{ reinterpret_cast<size_t>(address) };
+	lines_.GetOrCreate(addr & ~LineData::kLineMask)->Set(LineData::GetWordIndex(addr), data, mask);
+}
+
+void LineRedoLog::WriteBack() {
+	for (LineData& line : lines_) {
+		CommitLine(line);
+	}
+}
+
+bool LineRedoLog::Empty() const {
+	return lines_.Empty();
+}
+
+void LineRedoLog::Clear() {
+	lines_.Clear();
+}
+
+size_t UndoLog::GetAllocatedBytes() const {
+	return data_.GetAllocatedBytes();
+}
+
+void UndoLog::Write(void* address, Word data, Word mask) {
+	const Word current{ LoadWord(address) };
+
+	const size_t key{ reinterpret_cast<size_t>(address) };
+	if (!data_.Contains(key)) {
+		data_.Create(key)->Set(current);
+	}
+
+	StoreWord(address, (current & ~mask) | (data & mask));
+}
+
+void UndoLog::Undo() {
+	for (UndoData& data : data_) {
+		StoreWord(reinterpret_cast<void*>(data.GetAddress()), data.GetData());
+	}
+}
+
+bool UndoLog::Empty() const {
+	return data_.Empty();
+}
+
+void UndoLog::Clear() {
+	data_.Clear();
+}
+
+void Backoff(uint16_t& backoff, Xoroshiro128pp& rng) {
+	uint16_t rand = static_cast<uint16_t>(rng.Next() & 0xF);
+
+	backoff += rand;
+	std::this_thread::sleep_for(std::chrono::nanoseconds(backoff));
+	backoff = backoff << 1u;
+}
+
+void GreedyCm::OnStart() {
+	ts_.store(std::numeric_limits<Version>::max(), std::memory_order_relaxed);
+	backoff_ = 0;
+
+	const size_t timestamp_writes{ GetTimestampWrites() };
+	timestamp_writes_ = static_cast<uint16_t>((timestamp_writes != 0u) ? timestamp_writes : kTimestampWrites);
+}
+
+void GreedyCm::OnRestart(Xoroshiro128pp& rng) {
+	Backoff(backoff_, rng);
+}
+
+void GreedyCm::OnWrite(size_t num_writes) {
+	if (ts_.load(std::memory_order_relaxed) == std::numeric_limits<Version>::max()) {
+		if (num_writes >= timestamp_writes_) {
+			ts_.store(GetIncGreedyVersion(), std::memory_order_relaxed);
+		}
+	}
+}
+
+bool GreedyCm::ShouldAbort(const GreedyCm* owner) const {
+	Version ts{ ts_.load(std::memory_order_relaxed) };
+	if (ts == std::numeric_limits<Version>::max()) {
+		return true;
+	}
+
+	return (owner != nullptr) && (owner->ts_.load(std::memory_order_relaxed) < ts);
+}
+
+void BackoffCm::OnStart() {
+	backoff_ = 0;
+}
+
+void BackoffCm::OnRestart(Xoroshiro128pp& rng) {
+	Backoff(backoff_, rng);
+}
+
+void BackoffCm::OnWrite(size_t) {
+}
+
+bool BackoffCm::ShouldAbort(const BackoffCm*) const {
+	return true;
+}
+
+} // namespace nlane::transactional::detail
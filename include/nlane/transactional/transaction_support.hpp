@@ -26,21 +26,21 @@
 #include <limits>
 
 #include "transactional.hpp"
+#include "thread_registry.hpp"
 
 namespace nlane::transactional::detail {
 
-class TransactionEngine;
-
 class ReadLock {
   public:
     // The bit wehere the lock is stored. (Different from the lock mask of WriteLock)
     static constexpr Version kLockMask{ std::numeric_limits<Version>::max() ^ (std::numeric_limits<Version>::max() >> 1u) };
 
   private:
-    volatile Version version_{ 0u };
+    std::atomic<Version> version_{ 0u };
 
   public:
-    // Sets the lock bit. No validity tests are performed
+    // Sets the lock bit. Readers that see data written after this call also see the lock bit.
+    // No validity tests are performed
     inline void Lock();
 
     // Clears the lock bit. No validity tests are performed
@@ -49,7 +49,7 @@ class ReadLock {
     // Clears the lock bit and updates the version. No validity tests are performed
     inline void Unlock(Version new_version);
 
-    // Returns the current version including lock bit
+    // Returns the current version including lock bit. Data read after this call is at least as new as the version
     inline Version Get() const noexcept;
 };
 
@@ -63,7 +63,7 @@ class WriteLock {
 
   public:
     // Attempts to set the lock bit. Retuns false if the lock bit is already set.
-    inline bool TryLock(TransactionEngine* owner);
+    inline bool TryLock(ThreadId owner);
 
     // Clears the lock bit. No validity tests are performed
     inline void Unlock();
@@ -72,10 +72,10 @@ class WriteLock {
     inline bool IsLocked() const;
 
     // Returns true if the lock bit is set and the owner of the lock is as specified.
-    inline bool IsLockedBy(TransactionEngine* owner) const;
+    inline bool IsLockedBy(ThreadId owner) const;
 
-    // Returns the current owner of the lock.
-    inline TransactionEngine* GetOwner() const;
+    // Returns the current owner of the lock or kNoThread if it is not locked.
+    inline ThreadId GetOwner() const;
 };
 
 class LockEntry {
@@ -88,7 +88,49 @@ public:
 static_assert(sizeof(LockEntry) == (sizeof(ReadLock) + sizeof(WriteLock)));
 static_assert((sizeof(LockEntry) & (sizeof(LockEntry) - 1u)) == 0u); // Ensure size is power of 2
 
-// The size in number of entries of the global lock table
+/**
+ * A lock that stores the version of a stripe and its write lock in a single word. While unlocked
+ * the word holds the version shifted left by one bit, while locked it holds the owner id shifted
+ * left by one bit with the lock bit set. Readers and writers therefore only ever touch one word per stripe.
+ */
+class VersionedLock {
+  public:
+    // The bit where the lock is stored.
+    static constexpr size_t kLockMask{ 0b1u };
+
+  private:
+    std::atomic<size_t> value_{ 0u };
+
+  public:
+    // Attempts to set the lock bit. Returns false if the lock bit is already set. On success version
+    // holds the version the stripe had before it was locked.
+    inline bool TryLock(ThreadId owner, Version& version);
+
+    // Clears the lock bit and sets the version. No validity tests are performed
+    inline void Unlock(Version version);
+
+    // Returns the current word. Either a version or an owner, see IsLocked and GetVersion
+    inline size_t Get() const;
+
+    // Returns true if the lock bit is set.
+    inline bool IsLocked() const;
+
+    // Returns true if the lock bit is set and the owner of the lock is as specified.
+    inline bool IsLockedBy(ThreadId owner) const;
+
+    // Returns the current owner of the lock or kNoThread if it is not locked.
+    inline ThreadId GetOwner() const;
+
+    // Returns true if the lock bit is set in word.
+    static constexpr bool IsLocked(size_t word);
+
+    // Returns the version stored in an unlocked word.
+    static constexpr Version GetVersion(size_t word);
+};
+
+static_assert(sizeof(VersionedLock) == sizeof(size_t));
+
+// The size in number of entries of the lock table of the default domain
 constexpr size_t kLockTableSize{ 4096u };
 
 // Using a bitmask for indexing requires power of 2 size
@@ -97,26 +139,313 @@ static_assert((kLockTableSize & (kLockTableSize - 1u)) == 0);
 // Bitmask to easily determine the index into the lock table
 constexpr size_t kLockTableMask{ kLockTableSize - 1u };
 
+// The maximum number of domains including the default domain
+constexpr size_t kMaxDomains{ 8u };
+
+// The maximum number of address ranges that can be assigned to domains
+constexpr size_t kMaxDomainRanges{ 64u };
+
+// The locks of domain d start at index d << kDomainShift of the lock table
+constexpr size_t kDomainShift{ 16u };
+
+// The maximum number of locks of a single domain
+constexpr size_t kMaxDomainLocks{ static_cast<size_t>(1u) << kDomainShift };
+
+static_assert(kLockTableSize <= kMaxDomainLocks);
+
+// The maximum number of hot addresses that can be given a dedicated lock. Dedicated locks follow
+// the locks of the default domain.
+constexpr size_t kMaxHotAddresses{ 64u };
+
+static_assert(kLockTableSize + kMaxHotAddresses <= kMaxDomainLocks);
+
+// The size of the hash table used to look up the dedicated locks of hot addresses
+constexpr size_t kHotTableSize{ 256u };
+
+static_assert((kHotTableSize & (kHotTableSize - 1u)) == 0);
+static_assert(kMaxHotAddresses <= kHotTableSize / 2u);
+
+// The maximum number of stripes whose readers are visible
+constexpr size_t kMaxVisibleStripes{ 64u };
+
+// The size of the hash table used to look up the reader indicators of visible stripes
+constexpr size_t kVisibleTableSize{ 128u };
+
+static_assert((kVisibleTableSize & (kVisibleTableSize - 1u)) == 0);
+static_assert(kMaxVisibleStripes <= kVisibleTableSize / 2u);
+
+// The number of reader counters of an indicator. Readers use the counter of their NUMA node.
+constexpr size_t kReaderNodes{ 4u };
+
+// The number of addresses recorded per profiled stripe
+constexpr size_t kProfileCandidates{ 4u };
+
+// The number of conflicts a stripe must have within a profiling window to be considered hot
+constexpr uint32_t kHotStripeConflicts{ 64u };
+
+// The number of profiled conflicts over all stripes after which the hot stripes are remapped
+constexpr uint64_t kConflictWindow{ 4096u };
+
 using LockIndex = size_t;
 
+/**
+ * How the addresses of a domain are mapped to its locks. The default domain maps bytes with the
+ * same low address bits to the same lock. Other domains map whole words to locks so all of their
+ * locks are used.
+ */
+struct DomainLayout {
+	size_t shift;
+	size_t mask;
+};
+
+// An address range assigned to a domain other than the default domain
+struct DomainRange {
+	size_t begin;
+	size_t end;
+	size_t domain;
+};
+
+struct alignas(64) DomainClock {
+	std::atomic<Version> version{ 0u };
+};
+
 // Returns the index of the lock that locks the specified address
 inline LockIndex GetLockIndex(void* address);
 
-// Returns a pointer to the beginning of the lock table.
+// Returns the domain the lock with specified index belongs to
+inline size_t GetDomain(LockIndex index);
+
+// Returns the number of created domains including the default domain
+inline size_t GetNumDomains();
+
+/**
+ * Creates a new domain with at least num_locks locks. Returns kMaxDomains if no more domains can be created.
+ *
+ * Must only be called while no transaction is running on any thread.
+ */
+size_t AddDomain(const char* name, size_t num_locks);
+
+// Returns the domain with specified name or kMaxDomains if there is none
+size_t FindDomain(const char* name);
+
+/**
+ * Assigns an address range to a domain. Returns false if no more ranges can be assigned.
+ *
+ * Must only be called while no transaction is running on any thread.
+ */
+bool AddDomainRange(size_t domain, size_t begin, size_t end);
+
+// Places the locks of domain on the specified NUMA node. The global clock of the domain is not moved.
+void BindDomainLocks(size_t domain, size_t node);
+
+/**
+ * Counts the visible readers of a stripe. Readers of different NUMA nodes use separate counters
+ * so readers only share cache lines with readers of their own node.
+ */
+struct ReaderIndicator {
+	struct alignas(64) Counter {
+		std::atomic<uint32_t> count{ 0u };
+	};
+
+	Counter nodes[kReaderNodes];
+
+	// Announces a reader of node. Sequentially consistent with the lock checks of readers and writers.
+	inline void Arrive(size_t node);
+
+	inline void Depart(size_t node);
+
+	// Returns the number of readers over all nodes
+	inline uint32_t GetNumReaders() const;
+};
+
+// A stripe whose readers are visible
+struct VisibleStripe {
+	// The lock index + 1 or 0 if the slot is empty
+	size_t key;
+	ReaderIndicator* indicator;
+};
+
+// Returns the reader indicator of the stripe with specified index or nullptr if its readers are invisible
+inline ReaderIndicator* GetReaderIndicator(LockIndex index);
+
+/**
+ * Makes the readers of the stripe with specified index visible. Returns false if no more stripes
+ * can be made visible. Returns true if the stripe is visible already.
+ *
+ * Must only be called while no transaction is running on any thread.
+ */
+bool AddVisibleStripe(LockIndex index);
+
+/**
+ * Makes the readers of all stripes invisible again.
+ *
+ * Must only be called while no transaction is running on any thread.
+ */
+void ClearVisibleStripes();
+
+// A word address of the default domain that has its own lock
+struct HotAddress {
+	size_t address;
+	LockIndex index;
+};
+
+/**
+ * Conflicts recorded for a stripe of the default domain. Only updated by aborting transactions so
+ * the counts are approximate.
+ */
+struct StripeProfile {
+	std::atomic<uint32_t> conflicts;
+	std::atomic<uint32_t> counts[kProfileCandidates];
+	std::atomic<size_t> addresses[kProfileCandidates];
+};
+
+// Returns true if conflicts are recorded to find hot stripes
+inline bool IsConflictProfiling();
+
+// Enables or disables the recording of conflicts
+void SetConflictProfiling(bool enabled);
+
+/**
+ * Records that a transaction aborted because of the stripe with specified index while accessing
+ * address. Conflicts on stripes other than the shared ones of the default domain are ignored.
+ */
+void RecordConflict(LockIndex index, const void* address);
+
+// Records the conflict if profiling is enabled
+inline void ProfileConflict(LockIndex index, const void* address);
+
+// Returns true if enough conflicts have been recorded to remap the hot stripes
+inline bool IsRemapRequested();
+
+/**
+ * Gives the address with the most conflicts of every hot stripe its own lock. Stripes only count as
+ * hot if their conflicts are spread over multiple addresses. Resets the recorded conflicts.
+ *
+ * Must only be called while no transaction is running on any thread.
+ *
+ * \returns The number of addresses that have been remapped.
+ */
+size_t RemapHotStripes();
+
+/**
+ * Gives the word containing address its own lock. Returns false if there are no more dedicated
+ * locks or the word has one already.
+ *
+ * Must only be called while no transaction is running on any thread.
+ */
+bool AddHotAddress(const void* address);
+
+// Returns the number of addresses that have their own lock
+inline size_t GetNumHotAddresses();
+
+/**
+ * Maps all hot addresses back to their stripes.
+ *
+ * Must only be called while no transaction is running on any thread.
+ */
+void ClearHotAddresses();
+
+// The maximum number of storage blocks kept for reuse after their engines have been destroyed
+constexpr size_t kMaxPooledStorage{ 256u };
+
+/**
+ * Returns 64 byte aligned storage of size bytes for the per thread data of an engine. Reuses the
+ * storage of destroyed engines placed on the node of the calling thread if there is any and
+ * allocates new storage on that node otherwise. The content of the storage is undefined.
+ *
+ * \throw std::bad_alloc If the allocation failed.
+ */
+void* AcquireStorage(size_t size);
+
+/**
+ * Returns storage acquired with AcquireStorage. It is kept for reuse by engines created later
+ * unless kMaxPooledStorage blocks are kept already.
+ */
+void ReleaseStorage(void* storage, size_t size);
+
+// Returns the number of bytes of storage that are kept for reuse
+size_t GetPooledStorage();
+
+// Returns a pointer to the beginning of the lock table. Has room for the locks of every domain.
 LockEntry* GetLockTable();
 
-// Returns the current global version
-Version GetGlobalVersion();
+// Returns a pointer to the beginning of the versioned lock table. Has the same size as the lock table.
+VersionedLock* GetVersionedLockTable();
+
+// Returns the current version of a domain
+inline Version GetDomainVersion(size_t domain);
+
+// Increments the version of a domain and returns its new value. Requests a rollover once the
+// maximum version has been reached.
+inline Version GetIncDomainVersion(size_t domain);
+
+// Returns the current version of the default domain
+inline Version GetGlobalVersion();
+
+// Increments the version of the default domain and returns its new value.
+inline Version GetIncGlobalVersion();
 
-// Increments the global version and returns its new value.
-Version GetIncGlobalVersion();
+// Returns the version at which a rollover is requested. kMaxVersion unless changed for testing.
+Version GetMaxVersion();
+
+// Sets the version at which a rollover is requested. Must be at most kMaxVersion. Used for testing.
+void SetMaxVersion(Version max_version);
+
+// Returns the number of rollovers performed so far. Versions of different epochs must not be compared.
+uint64_t GetVersionEpoch();
+
+// Returns true if the global version has reached the maximum and a rollover is pending.
+inline bool IsRolloverRequested();
+
+/**
+ * Resets the versions of all domains and all locks to 0 and starts a new epoch.
+ * Does nothing if no rollover has been requested.
+ *
+ * Must only be called while no transaction is running on any thread.
+ */
+void Rollover();
+
+// Called by committers that can be helped after they published their commit and before they write
+// back themselves, nullptr unless set for testing. Used to stall a committer at that point.
+void SetWriteBackHook(void (*hook)());
+
+// Runs the hook set with SetWriteBackHook if any
+inline void RunWriteBackHook();
+
+// Loads a word of transactional memory. Other threads may access the word concurrently,
+// ordering is provided by the lock that protects it.
+inline Word LoadWord(const void* address);
+
+// Stores a word of transactional memory. Other threads may access the word concurrently,
+// ordering is provided by the lock that protects it.
+inline void StoreWord(void* address, Word data);
+
+extern DomainClock domain_clocks[kMaxDomains];
+extern DomainLayout domain_layouts[kMaxDomains];
+extern DomainRange domain_ranges[kMaxDomainRanges];
+extern size_t num_domains;
+extern size_t num_domain_ranges;
+
+extern VisibleStripe visible_stripes[kVisibleTableSize];
+extern size_t num_visible_stripes;
+
+extern HotAddress hot_addresses[kHotTableSize];
+extern size_t num_hot_addresses;
+
+extern std::atomic<bool> conflict_profiling;
+extern std::atomic<bool> remap_requested;
+
+extern std::atomic<Version> max_version;
+extern std::atomic<bool> rollover_requested;
+
+extern std::atomic<void (*)()> write_back_hook;
 
 // Increments the greedy version and returns its new value.
 Version GetIncGreedyVersion();
 
 /**
  * Initializes the global support system. I.e. for now just
- * allocates the lock table.
+ * allocates the lock tables.
  * 
  * Must only be called once.
  */
@@ -126,45 +455,229 @@ void InitSupport();
 // Inline function definitions
 //
 
+// Read locks are only ever modified by the holder of the write lock of the same stripe.
+// Readers pair the acquire load in Get with an acquire fence after reading the data.
+
 void ReadLock::Lock() {
-    version_ |= kLockMask;
+    version_.store(version_.load(std::memory_order_relaxed) | kLockMask, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
 }
 
 void ReadLock::Unlock() {
-    version_ &= ~kLockMask;
+    version_.store(version_.load(std::memory_order_relaxed) & ~kLockMask, std::memory_order_release);
 }
 
 void ReadLock::Unlock(Version new_version) {
-    version_ = new_version;
+    version_.store(new_version, std::memory_order_release);
 }
 
 Version ReadLock::Get() const noexcept {
-    return version_;
+    return version_.load(std::memory_order_acquire);
 }
 
-bool WriteLock::TryLock(TransactionEngine* owner) {
+// The owner queries are only hints, ownership is established by TryLock.
+
+bool WriteLock::TryLock(ThreadId owner) {
     size_t expected{ 0u };
-    return value_.compare_exchange_strong(expected, reinterpret_cast<size_t>(owner) | kLockMask);
+    return value_.compare_exchange_strong(expected, (static_cast<size_t>(owner) << 1u) | kLockMask,
+        std::memory_order_acquire, std::memory_order_relaxed);
 }
 
 void WriteLock::Unlock() {
-    value_.store(0u);
+    value_.store(0u, std::memory_order_release);
 }
 
 bool WriteLock::IsLocked() const {
-    return (value_.load() & kLockMask) != 0u;
+    return (value_.load(std::memory_order_relaxed) & kLockMask) != 0u;
+}
+
+bool WriteLock::IsLockedBy(ThreadId owner) const {
+    return value_.load(std::memory_order_relaxed) == ((static_cast<size_t>(owner) << 1u) | kLockMask);
+}
+
+ThreadId WriteLock::GetOwner() const {
+    return static_cast<ThreadId>(value_.load(std::memory_order_relaxed) >> 1u);
+}
+
+bool VersionedLock::TryLock(ThreadId owner, Version& version) {
+    size_t expected{ value_.load(std::memory_order_relaxed) };
+    if (IsLocked(expected)) {
+        return false;
+    }
+
+    if (!value_.compare_exchange_strong(expected, (static_cast<size_t>(owner) << 1u) | kLockMask,
+            std::memory_order_acquire, std::memory_order_relaxed)) {
+        return false;
+    }
+
+    version = GetVersion(expected);
+    return true;
+}
+
+void VersionedLock::Unlock(Version version) {
+    value_.store(static_cast<size_t>(version) << 1u, std::memory_order_release);
+}
+
+size_t VersionedLock::Get() const {
+    return value_.load(std::memory_order_acquire);
+}
+
+bool VersionedLock::IsLocked() const {
+    return IsLocked(value_.load(std::memory_order_relaxed));
+}
+
+bool VersionedLock::IsLockedBy(ThreadId owner) const {
+    return value_.load(std::memory_order_relaxed) == ((static_cast<size_t>(owner) << 1u) | kLockMask);
+}
+
+ThreadId VersionedLock::GetOwner() const {
+    size_t word{ value_.load(std::memory_order_relaxed) };
+    return IsLocked(word) ? static_cast<ThreadId>(word >> 1u) : kNoThread;
 }
 
-bool WriteLock::IsLockedBy(TransactionEngine* owner) const {
-    return value_.load() == (reinterpret_cast<size_t>(owner) | kLockMask);
+constexpr bool VersionedLock::IsLocked(size_t word) {
+    return (word & kLockMask) != 0u;
 }
 
-TransactionEngine* WriteLock::GetOwner() const {
-    return reinterpret_cast<TransactionEngine*>(value_.load() & ~kLockMask);
+constexpr Version VersionedLock::GetVersion(size_t word) {
+    return static_cast<Version>(word >> 1u);
 }
 
+Version GetDomainVersion(size_t domain) {
+    return domain_clocks[domain].version.load(std::memory_order_acquire);
+}
+
+Version GetIncDomainVersion(size_t domain) {
+    // Orders the lock acquisitions of a committer before the validation of any later committer
+    Version version{ domain_clocks[domain].version.fetch_add(1u, std::memory_order_acq_rel) + 1u };
+
+    // kMaxVersion leaves enough headroom below the lock bits to keep committing until the rollover
+    if (version >= max_version.load(std::memory_order_relaxed)) {
+        rollover_requested.store(true, std::memory_order_relaxed);
+    }
+    return version;
+}
+
+Version GetGlobalVersion() {
+    return GetDomainVersion(0u);
+}
+
+Version GetIncGlobalVersion() {
+    return GetIncDomainVersion(0u);
+}
+
+Word LoadWord(const void* address) {
+    return __atomic_load_n(reinterpret_cast<const Word*>(address), __ATOMIC_RELAXED);
+}
+
+void StoreWord(void* address, Word data) {
+    __atomic_store_n(reinterpret_cast<Word*>(address), data, __ATOMIC_RELAXED);
+}
+
+bool IsRolloverRequested() {
+    return rollover_requested.load(std::memory_order_relaxed);
+}
+
+void RunWriteBackHook() {
+    void (*hook)(){ write_back_hook.load(std::memory_order_relaxed) };
+    if (hook != nullptr) {
+        hook();
+    }
+}
+
+void ReaderIndicator::Arrive(size_t node) {
+    nodes[node].count.fetch_add(1u, std::memory_order_seq_cst);
+}
+
+void ReaderIndicator::Depart(size_t node) {
+    nodes[node].count.fetch_sub(1u, std::memory_order_release);
+}
+
+uint32_t ReaderIndicator::GetNumReaders() const {
+    uint32_t readers{ 0u };
+    for (const Counter& counter : nodes) {
+        readers += counter.count.load(std::memory_order_seq_cst);
+    }
+    return readers;
+}
+
+// Returns the slot of the visible stripe table in which key is stored or would be inserted
+inline size_t GetVisibleSlot(size_t key) {
+    size_t slot{ key & (kVisibleTableSize - 1u) };
+    while ((visible_stripes[slot].key != 0u) && (visible_stripes[slot].key != key)) {
+        slot = (slot + 1u) & (kVisibleTableSize - 1u);
+    }
+    return slot;
+}
+
+// The visible stripes only change while no transaction is running
+ReaderIndicator* GetReaderIndicator(LockIndex index) {
+    if (num_visible_stripes == 0u) {
+        return nullptr;
+    }
+    return visible_stripes[GetVisibleSlot(index + 1u)].indicator;
+}
+
+bool IsConflictProfiling() {
+    return conflict_profiling.load(std::memory_order_relaxed);
+}
+
+void ProfileConflict(LockIndex index, const void* address) {
+    if (IsConflictProfiling()) {
+        RecordConflict(index, address);
+    }
+}
+
+bool IsRemapRequested() {
+    return remap_requested.load(std::memory_order_relaxed);
+}
+
+size_t GetNumHotAddresses() {
+    return num_hot_addresses;
+}
+
+// Returns the slot of the hot address table in which word is stored or would be inserted
+inline size_t GetHotSlot(size_t word) {
+    size_t slot{ (word >> 3u) & (kHotTableSize - 1u) };
+    while ((hot_addresses[slot].address != 0u) && (hot_addresses[slot].address != word)) {
+        slot = (slot + 1u) & (kHotTableSize - 1u);
+    }
+    return slot;
+}
+
+// The domains, their ranges and the hot addresses only change while no transaction is running
+
 LockIndex GetLockIndex(void* address) {
-    return reinterpret_cast<size_t>(address) & kLockTableMask;
+    const size_t addr{ reinterpret_cast<size_t>(address) };
+    if (num_hot_addresses != 0u) {
+        const HotAddress& hot{ hot_addresses[GetHotSlot(addr & ~kWordAlignMask)] };
+        if (hot.address != 0u) {
+            return hot.index;
+        }
+    }
+
+    if (num_domain_ranges == 0u) {
+        return addr & kLockTableMask;
+    }
+
+    size_t domain{ 0u };
+    for (size_t i{ 0 }; i < num_domain_ranges; i++) {
+        if ((addr >= domain_ranges[i].begin) && (addr < domain_ranges[i].end)) {
+            domain = domain_ranges[i].domain;
+            break;
+        }
+    }
+
+    const DomainLayout& layout{ domain_layouts[domain] };
+    return (domain << kDomainShift) | ((addr >> layout.shift) & layout.mask);
+}
+
+size_t GetDomain(LockIndex index) {
+    return index >> kDomainShift;
+}
+
+size_t GetNumDomains() {
+    return num_domains;
 }
 
 } // namespace nlane::transactional::detail
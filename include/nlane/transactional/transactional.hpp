@@ -20,11 +20,18 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <limits>
+#include <mutex>
+#include <new>
 #include <stdexcept>
 #include <string>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace nlane{
 namespace transactional {
@@ -40,6 +47,32 @@ using Version = uint64_t;
 // The highest allowed version number before an overflow event
 constexpr Version kMaxVersion{ std::numeric_limits<Version>::max() >> 2u };
 
+/**
+ * The transactional memory algorithms that can be selected at runtime.
+ */
+enum class Algorithm {
+    LOCK_TABLE,     // Per stripe read and write locks as described by SwissTM. The default.
+    RING,           // Global ring of commit signatures as described by RingSTM. Best for read dominated workloads.
+    SEQ_LOCK,       // Single global sequence lock with value based validation as described by NOrec.
+    SERIAL,         // Irrevocable mode. Transactions are executed one after another and never abort.
+};
+
+/**
+ * Identifies an STM domain. See CreateDomain.
+ */
+using Domain = uint32_t;
+
+// The domain all memory belongs to unless it is assigned to another domain
+constexpr Domain kDefaultDomain{ 0u };
+
+/**
+ * The classification of a registered memory region. See RegisterRegion.
+ */
+enum class RegionKind {
+    IMMUTABLE,      // Never written while registered. Can be read by any thread.
+    PRIVATE,        // Only accessed by the thread that registered it.
+};
+
 /**
  * 
  */
@@ -64,6 +97,9 @@ class TransactionError : public std::runtime_error {
 	virtual bool shouldRetry() const noexcept;
 };
 
+class Transaction;
+class Site;
+
 namespace detail {
 
 enum class PromotionState {
@@ -96,6 +132,20 @@ void BeginReadWrite();
  */
 void BeginReadOnly();
 
+/**
+ * Starts an elastic read-write transaction. See AtomicElastic.
+ * 
+ * \throw TransactionError
+ */
+void BeginElastic();
+
+/**
+ * Starts a snapshot isolation read-write transaction. See AtomicSnapshot.
+ * 
+ * \throw TransactionError
+ */
+void BeginSnapshot();
+
 /**
  * Restarts a read-write transaction.
  * 
@@ -125,19 +175,284 @@ void Commit();
  */
 void End();
 
+/**
+ * While enabled a write by the running transaction of this thread, or the start of a nested
+ * read-write transaction, aborts it with a retry error. Used to run transactions of call sites
+ * that did not write recently as read-only. Disabled when the transaction terminates.
+ */
+void SetWriteTrap(bool enabled);
+
+// Returns true if the write trap has aborted the running transaction and resets the flag
+bool TakeTrappedWrite();
+
+// Returns the number of words written by the current attempt of the running transaction
+size_t GetAttemptWrites();
+
+// Returns true if Retry has been called since the running transaction has been started and resets the request
+bool TakeRetryRequest();
+
+/**
+ * Sets the number of writes after which the greedy contention manager gives the next transaction
+ * started on this thread a timestamp. 0 selects GreedyCm::kTimestampWrites. Reset when the
+ * transaction terminates.
+ */
+void SetTimestampWrites(size_t writes);
+
+// Returns the value set with SetTimestampWrites
+size_t GetTimestampWrites();
+
 /**
  * \returns The address of the word containing the byte pointed to by addr
  */
 inline void* WordAlignedAddress(void* addr);
 
+/**
+ * Returns a handle to the currently running transaction of this thread.
+ * Must only be called within a transaction.
+ */
+Transaction CurrentTransaction();
+
+// The unsigned integer type with the specified size in bytes
+template<size_t _Size>
+using UnsignedOfSize = std::conditional_t<_Size == 1u, uint8_t,
+	std::conditional_t<_Size == 2u, uint16_t,
+	std::conditional_t<_Size == 4u, uint32_t, uint64_t>>>;
+
+// Reads a variable of at most word size through access.ReadWord
+template<class _Ty, class _Access>
+inline _Ty ReadVariable(_Access& access, _Ty* addr);
+
+// Writes a variable of at most word size through access.WriteWord
+template<class _Ty, class _Access>
+inline void WriteVariable(_Access& access, _Ty* addr, _Ty data);
+
+// Accesses words of the currently running transaction through the free functions
+struct ThreadAccess {
+	inline Word ReadWord(void* address) const;
+	inline void WriteWord(void* address, Word data, Word mask) const;
+};
+
+// Calls func with a handle to the running transaction if it accepts one
+template<class _Cl>
+inline void Invoke(_Cl& func);
+
+/**
+ * A type erased closure without arguments. Closures of at most kInlineSize bytes that can be
+ * moved without throwing are stored inline, larger ones are allocated on the heap.
+ */
+class DeferredAction {
+  public:
+	static constexpr size_t kInlineSize{ 48u };
+
+  private:
+	struct Ops {
+		void (*invoke)(void* storage);
+
+		// Move constructs the closure into to and destroys it in from
+		void (*relocate)(void* from, void* to);
+		void (*destroy)(void* storage);
+	};
+
+	template<class _Cl>
+	static constexpr bool kStoredInline{ (sizeof(_Cl) <= kInlineSize) && (alignof(_Cl) <= alignof(std::max_align_t))
+		&& std::is_nothrow_move_constructible_v<_Cl> };
+
+	template<class _Cl>
+	static const Ops kInlineOps;
+
+	template<class _Cl>
+	static const Ops kHeapOps;
+
+	alignas(std::max_align_t) unsigned char storage_[kInlineSize];
+	const Ops* ops_;
+
+  public:
+	template<class _Cl>
+	inline explicit DeferredAction(_Cl func);
+
+	inline DeferredAction(DeferredAction&& other) noexcept;
+	inline ~DeferredAction();
+
+	DeferredAction(const DeferredAction&) = delete;
+	DeferredAction& operator=(const DeferredAction&) = delete;
+	DeferredAction& operator=(DeferredAction&&) = delete;
+
+	inline void operator()();
+};
+
+/**
+ * Queues an action of the running transaction of this thread. Commit actions run after the
+ * outer most transaction has committed, abort actions whenever an attempt has been rolled back.
+ *
+ * \throw TransactionError If no transaction is running.
+ */
+void PushCommitAction(DeferredAction&& action);
+void PushAbortAction(DeferredAction&& action);
+
+/**
+ * Holds back the commit actions of this thread and the coroutines its commits have woken until
+ * the outer most deferral has ended. Used by callers that commit while holding locks the actions
+ * may need themselves.
+ */
+void BeginDeferral();
+void EndDeferral() noexcept;
+
+// Defers the commit actions of this thread while it exists, see BeginDeferral
+class ActionDeferral {
+  public:
+	inline ActionDeferral();
+	inline ~ActionDeferral();
+
+	ActionDeferral(const ActionDeferral&) = delete;
+	ActionDeferral& operator=(const ActionDeferral&) = delete;
+};
+
+/**
+ * Rolls the running attempt of this thread back after a retry error, runs its abort actions,
+ * leaves the transaction and backs off, or blocks if the transaction has called Retry. The next
+ * begin starts a new transaction. Used instead of restarting right away by callers that have to
+ * release locks before any of this happens.
+ */
+void AbortAttempt();
+
+// The errors thrown by transactions started inside incompatible transactions
+constexpr const char* kNestedReadWriteError{ "Cannot embed read-write transaction inside read-only transaction" };
+constexpr const char* kNestedReadOnlyError{ "Read only transaction is for some reason incompatible. This should never happen." };
+
+/**
+ * Invokes func inside the running transaction of this thread if there is one.
+ *
+ * \param state The compatibility of the running transaction with the new one.
+ * \param incompatible The message of the error thrown if the running transaction is incompatible.
+ * \returns False if no transaction is running.
+ */
+template<class _Cl>
+inline bool InvokeNested(PromotionState state, _Cl& func, const char* incompatible);
+
+// Runs func in a new transaction started with begin. Restarts it until it commits or fails with an error that can not be retried.
+template<class _Cl>
+inline void RunTransaction(void (*begin)(), _Cl& func);
+
+// Runs func in a transaction in the mode adapted by site. Read-only if may_write is false.
+template<class _Cl>
+inline void InvokeAtSite(Site& site, _Cl& func, bool may_write);
+
 } // namespace detail
 
+/**
+ * A handle to the running transaction of a thread. Passed to the function of Atomic and
+ * AtomicRead if it accepts a Transaction&.
+ *
+ * Accesses through the handle go directly to the engine of the active algorithm with a single
+ * indirect call. They skip the thread local lookup of the free functions which makes them
+ * preferable in tight loops. The free functions keep working inside the same transaction.
+ *
+ * A handle is only valid until the function it was passed to returns.
+ */
+class Transaction {
+  private:
+	using ReadFunction = Word (*)(void* engine, void* address);
+	using WriteFunction = void (*)(void* engine, void* address, Word data, Word mask);
+
+	void* engine_;
+	ReadFunction read_word_;
+	WriteFunction write_word_;
+
+	inline Transaction(void* engine, ReadFunction read_word, WriteFunction write_word);
+
+	friend Transaction detail::CurrentTransaction();
+
+  public:
+	Transaction(const Transaction&) = delete;
+	Transaction& operator=(const Transaction&) = delete;
+
+	/**
+	 * Atomically reads the word at specified address. See tr::ReadWord.
+	 *
+	 * \throw TransactionError If an error occured. Must be forwarded so the transaction can restart.
+	 */
+	inline Word ReadWord(void* address);
+
+	/**
+	 * Atomically writes the bits in mask of the word at specified address. See tr::WriteWord.
+	 *
+	 * \throw TransactionError If an error occured. Must be forwarded so the transaction can restart.
+	 */
+	inline void WriteWord(void* address, Word data, Word mask);
+
+	// Atomically reads the variable at specified address. See tr::Read.
+	template<typename _Ty, std::enable_if_t<!std::is_pointer_v<_Ty>, int> = 0>
+	inline _Ty Read(_Ty* addr);
+
+	// Atomically writes the variable at specified address. See tr::Write.
+	template<typename _Ty, std::enable_if_t<!std::is_pointer_v<_Ty>, int> = 0>
+	inline void Write(_Ty* addr, _Ty data);
+
+	// Atomically reads the pointer at specified address. See tr::Read.
+	template<typename _Ty>
+	inline _Ty* Read(_Ty** addr);
+
+	// Atomically writes the pointer at specified address. See tr::Write.
+	template<typename _Ty>
+	inline void Write(_Ty** addr, _Ty* data);
+
+	// Stops tracking the reads of the variable at specified address. See tr::Release.
+	inline void Release(void* addr);
+};
+
 /**
  * Initializes the thread local transaction engine.
  * Must be called before any other call to the thread local transaction engine.
  */
 void ThreadInit();
 
+/**
+ * The memory used by the transactional runtime for a thread.
+ */
+struct MemoryFootprint {
+	// The size of the engine objects of the calling thread
+	size_t engine_bytes;
+
+	// The storage allocated for the read sets, write sets and logs of the calling thread. Only
+	// allocated once a transaction of the respective algorithm needs it.
+	size_t log_bytes;
+
+	// The storage of exited threads that is kept for reuse by threads created later. Shared by all threads.
+	size_t pooled_bytes;
+};
+
+/**
+ * \returns The memory used by the transactional runtime for the calling thread.
+ */
+MemoryFootprint GetMemoryFootprint();
+
+/**
+ * Selects the algorithm used by all transactions started after this call.
+ * Waits until no transaction is running on any thread. Must not be called from within a transaction.
+ * 
+ * \throw TransactionError If called from within a transaction.
+ */
+void SetAlgorithm(Algorithm algorithm);
+
+/**
+ * \returns The algorithm currently used to execute transactions.
+ */
+Algorithm GetAlgorithm();
+
+/**
+ * Enables or disables adaptive algorithm selection. While enabled the commit and abort rates as
+ * well as the number of reads and writes per transaction are measured and the algorithm is
+ * switched automatically whenever the workload changes.
+ * 
+ * \throw TransactionError If called from within a transaction.
+ */
+void SetAdaptive(bool enabled);
+
+/**
+ * \returns True if adaptive algorithm selection is enabled.
+ */
+bool IsAdaptive();
+
 /**
  * Atomically reads the word at specified address. 
  * Must be called within a transaction.
@@ -163,6 +478,178 @@ Word ReadWord(void* address);
  */
 void WriteWord(void* address, Word data, Word mask);
 
+/**
+ * Releases the variable at specified address early. Modifications of the variable by other
+ * transactions no longer cause this transaction to abort. Must be called within a transaction.
+ *
+ * \note        Conflicts are detected per stripe, so the release also applies to all variables that
+ *              share the stripe of address. Only release variables whose value the remaining
+ *              transaction no longer depends on, for example nodes already passed in a traversal.
+ *              Written variables stay tracked. The algorithms RING and SERIAL ignore releases.
+ *
+ * \param address The address of the variable.
+ */
+void Release(void* address);
+
+/**
+ * Creates a new STM domain with its own lock table and clock. Memory assigned to the domain with
+ * AssignDomain does not share locks with memory of other domains and commits that only write to
+ * it do not increment the clock of other domains. Subsystems that rarely share data should use
+ * separate domains. Transactions can access any number of domains.
+ *
+ * Domains only affect the LOCK_TABLE algorithm. Waits until no transaction is running on any thread.
+ *
+ * \throw TransactionError  If called from within a transaction, if a domain with the same name
+ *                          exists or if no more domains can be created.
+ *
+ * \param name      The name of the domain.
+ * \param num_locks The number of locks the domain should have. Rounded up to a power of 2. Every
+ *                  word of the domain is mapped to one of its locks.
+ * \returns The new domain.
+ */
+Domain CreateDomain(const char* name, size_t num_locks);
+
+/**
+ * \throw TransactionError If no domain with the specified name exists.
+ *
+ * \returns The domain with the specified name.
+ */
+Domain FindDomain(const char* name);
+
+/**
+ * Assigns an address range to a domain. Waits until no transaction is running on any thread.
+ *
+ * \throw TransactionError  If called from within a transaction, if domain does not exist or if
+ *                          too many ranges have been assigned.
+ *
+ * \param domain    The domain the range is assigned to.
+ * \param address   The start of the range.
+ * \param size      The size of the range in bytes.
+ */
+void AssignDomain(Domain domain, const void* address, size_t size);
+
+/**
+ * Places the locks of a domain on a NUMA node. Domains whose data lives on a single node should
+ * keep their locks there too, by default the lock table is interleaved over all nodes. Only has an
+ * effect if nlane is built with NLANE_NUMA.
+ *
+ * \throw TransactionError  If domain does not exist.
+ *
+ * \param domain    The domain whose locks are moved.
+ * \param node      The NUMA node.
+ */
+void SetDomainNode(Domain domain, size_t node);
+
+/**
+ * Waits until every transaction that was running on another thread when the fence was called has
+ * committed or aborted. Data that has been made unreachable by a committed transaction can be
+ * accessed without transactions after the fence returned, no transaction that was still running
+ * can write to it anymore. Transactions started after the call are not waited for.
+ *
+ * \throw TransactionError If called from within a transaction.
+ */
+void PrivatizationFence();
+
+/**
+ * Enables or disables automatic privatization. While enabled every committed read-write
+ * transaction runs PrivatizationFence before it returns, so all data it made unreachable can be
+ * accessed without transactions right away. Adds a scan over all threads to every writing commit.
+ */
+void SetAutoPrivatization(bool enabled);
+
+/**
+ * \returns True if automatic privatization is enabled.
+ */
+bool IsAutoPrivatization();
+
+/**
+ * Enables or disables the remapping of hot addresses. While enabled the conflicts of aborting
+ * transactions are recorded. Once enough conflicts have been recorded, the address with the most
+ * conflicts of every stripe whose conflicts are spread over multiple addresses gets a lock of its
+ * own at the next point no transaction is running, so hot variables no longer abort transactions
+ * that only access unrelated words of the same stripe. Disabling maps all addresses back.
+ * Enabled by default. Only affects the default domain of the LOCK_TABLE algorithm.
+ *
+ * \throw TransactionError If called from within a transaction.
+ */
+void SetContentionRemapping(bool enabled);
+
+/**
+ * Makes the readers of the stripes that protect an address range visible. Meant for data that is
+ * read by most transactions but rarely written. Readers announce themselves on such stripes and
+ * never need to validate them, writers wait for the announced readers to finish before they commit
+ * and abort if they take too long. Only affects the LOCK_TABLE algorithm. Waits until no
+ * transaction is running on any thread.
+ *
+ * Stripes are selected by the current mapping of the range, addresses remapped to their own lock
+ * later on have invisible readers again.
+ *
+ * \throw TransactionError  If called from within a transaction or if too many stripes are visible.
+ *
+ * \param address   The start of the range.
+ * \param size      The size of the range in bytes.
+ */
+void SetVisibleReaders(const void* address, size_t size);
+
+/**
+ * Makes the readers of all stripes invisible again. Waits until no transaction is running on any thread.
+ *
+ * \throw TransactionError If called from within a transaction.
+ */
+void ClearVisibleReaders();
+
+/**
+ * Registers an address range whose accesses are performed directly without the engine. Reads and
+ * writes to it skip all versioning, locking and logging.
+ *
+ * Immutable regions must not be written by anybody while they are registered, transactional
+ * writes to them throw a non-restart TransactionError. Private regions must only be accessed by
+ * the registering thread. Writes to private regions take effect immediately and are undone if the
+ * attempt aborts. Waits until no transaction is running on any thread, so regions should be
+ * registered once after loading or once per phase.
+ *
+ * \throw TransactionError  If called from within a transaction, if address or size is not word
+ *                          aligned or if too many regions are registered.
+ *
+ * \param address   The word aligned start of the region.
+ * \param size      The size of the region in bytes. Must be a multiple of the word size.
+ * \param kind      The classification of the region.
+ */
+void RegisterRegion(const void* address, size_t size, RegionKind kind);
+
+/**
+ * Unregisters the region starting at address. Waits until no transaction is running on any thread.
+ *
+ * \throw TransactionError  If called from within a transaction or if verification is enabled and
+ *                          the content of an immutable region has changed since it was registered.
+ */
+void UnregisterRegion(const void* address);
+
+/**
+ * Enables or disables the verification of registered regions. While enabled, accesses to regions
+ * private to another thread throw a non-restart TransactionError. Immutable regions are
+ * checksummed and checked again when unregistered.
+ * Meant for debug builds.
+ *
+ * \throw TransactionError If called from within a transaction.
+ */
+void SetRegionVerification(bool enabled);
+
+/**
+ * Allocates size bytes of memory aligned like operator new.
+ *
+ * Memory allocated inside a transaction is private to it until it commits. Reads and writes to it
+ * are performed directly without any locking or logging, so initializing new objects costs the
+ * same as outside a transaction. If the transaction aborts the memory is freed automatically.
+ * Once committed, the memory is owned by the caller and has to be freed with operator delete.
+ *
+ * \throw std::bad_alloc If the allocation failed.
+ *
+ * \param size The number of bytes to allocate.
+ * \returns A pointer to the allocated memory.
+ */
+void* Allocate(size_t size);
+
 /**
  * Atomically reads the variable at specified address. 
  * Must be called within a transaction. 
@@ -217,6 +704,142 @@ inline _Ty* Read(_Ty** addr);
 template<typename _Ty>
 inline void Write(_Ty** addr, _Ty* data);
 
+/**
+ * A call site of Atomic or AtomicRead that adapts how its transactions are executed to their past
+ * behaviour. Declared once per call site, usually as a static local, and passed to every call.
+ *
+ * The mode of a site is reevaluated every kWindow commits or aborts from the statistics since the
+ * previous evaluation:
+ * - Sites that committed without writing start their transactions read-only. A write restarts the
+ *   transaction as read-write and turns the mode off until the next evaluation.
+ * - Sites that abort more than kSerializeAborts times per commit run one transaction at a time
+ *   until they abort at most once per commit. The site is only locked while an attempt runs,
+ *   backoff, abort actions and commit actions happen after unlocking.
+ * - Sites that abort more often than they commit get a greedy timestamp after half of their
+ *   average number of writes instead of after GreedyCm::kTimestampWrites writes.
+ */
+class Site {
+  public:
+	// The number of commits or aborts after which the mode is reevaluated
+	static constexpr uint64_t kWindow{ 64u };
+
+	// The aborts per commit above which the transactions of a site are serialized
+	static constexpr uint64_t kSerializeAborts{ 4u };
+
+  private:
+	const char* name_;
+
+	std::atomic<uint64_t> commits_{ 0u };
+	std::atomic<uint64_t> aborts_{ 0u };
+	std::atomic<uint64_t> writes_{ 0u };
+
+	// The totals at the last evaluation
+	std::atomic<uint64_t> last_commits_{ 0u };
+	std::atomic<uint64_t> last_aborts_{ 0u };
+	std::atomic<uint64_t> last_writes_{ 0u };
+
+	std::atomic<bool> read_only_{ false };
+	std::atomic<bool> serialized_{ false };
+	std::atomic<size_t> timestamp_writes_{ 0u };
+
+	// Held by the running transaction of a serialized site
+	std::mutex mutex_;
+
+	void Reevaluate();
+
+	template<class _Cl>
+	friend void detail::InvokeAtSite(Site& site, _Cl& func, bool may_write);
+
+  public:
+	// name only identifies the site in diagnostics and must outlive it
+	explicit Site(const char* name);
+
+	Site(const Site&) = delete;
+	Site& operator=(const Site&) = delete;
+
+	const char* GetName() const;
+
+	uint64_t GetCommits() const;
+	uint64_t GetAborts() const;
+
+	// Returns the number of words written by all committed transactions
+	uint64_t GetWrites() const;
+
+	bool IsReadOnly() const;
+	bool IsSerialized() const;
+
+	// Returns the timestamp threshold of the greedy contention manager or 0 for the default
+	size_t GetTimestampWrites() const;
+
+	// Called after every commit, abort and upgrade of a read-only start to read-write
+	void OnCommit(size_t writes);
+	void OnAbort();
+	void OnUpgrade();
+};
+
+/**
+ * Commits consecutive small read-write transactions of one thread as groups. Every group runs as a
+ * single transaction, so it pays for begin, the commit clock increment and the lock release only
+ * once. Intended for loops of many tiny independent updates.
+ *
+ * Functions are queued with Add, small ones without allocation, and run once the queue holds
+ * max_group functions or Flush is called.
+ * A group that aborts backs off and is split in two halves which are retried separately, down to
+ * single functions which are retried like Atomic. In adaptive mode the group size is halved after
+ * every split of a group that has written and grows by one after every commit, so batches of
+ * conflicting functions end up running one by one.
+ *
+ * Functions must not depend on the effects of queued functions becoming visible before Flush
+ * returns. Inside a running transaction every function is embedded into it right away. Commit
+ * actions and the coroutines woken by the commits of Flush run once all groups have finished.
+ */
+class Batch {
+  public:
+	// The default maximum number of functions committed as one transaction
+	static constexpr size_t kMaxGroup{ 8u };
+
+  private:
+	std::vector<detail::DeferredAction> queue_;
+
+	size_t max_group_;
+	size_t group_size_;
+	bool adaptive_;
+
+	// Runs the count functions of the queue from first as one transaction, splitting it on abort
+	void RunGroup(size_t first, size_t count);
+
+  public:
+	explicit Batch(size_t max_group = kMaxGroup, bool adaptive = true);
+
+	Batch(const Batch&) = delete;
+	Batch& operator=(const Batch&) = delete;
+
+	// All queued functions must have been flushed
+	~Batch();
+
+	/**
+	 * Queues func to be executed atomically. Flushes the queue if it is full.
+	 *
+	 * \throw TransactionError See Flush.
+	 */
+	template<class _Cl>
+	inline void Add(_Cl func);
+
+	/**
+	 * Executes all queued functions. If a function throws anything but a retry TransactionError
+	 * its group is aborted, the rest of the queue is discarded and the error is rethrown.
+	 *
+	 * \throw TransactionError
+	 */
+	void Flush();
+
+	// Returns the number of functions currently committed as one transaction
+	size_t GetGroupSize() const;
+
+	// Returns the number of queued functions
+	size_t GetPending() const;
+};
+
 /**
  * \brief       Atomically executes the passed function. Reads and writes are allowed.
  * 
@@ -235,7 +858,8 @@ inline void Write(_Ty** addr, _Ty* data);
  * 
  * \throw       TransactionError
  * 
- * \param   func    A callable object that represents the atomic function.
+ * \param   func    A callable object that represents the atomic function. Either takes no arguments
+ *                  or a Transaction& through which reads and writes can be performed faster.
  */
 template<class _Cl>
 inline void Atomic(_Cl func);
@@ -258,11 +882,128 @@ inline void Atomic(_Cl func);
  * 
  * \throw       TransactionError
  * 
- * \param   func    A callable object that represents the atomic function.
+ * \param   func    A callable object that represents the atomic function. Either takes no arguments
+ *                  or a Transaction& through which reads can be performed faster.
  */
 template<class _Cl>
 inline void AtomicRead(_Cl func);
 
+/**
+ * \brief       Atomically executes the passed function as an elastic transaction. Reads and writes
+ *              are allowed.
+ * 
+ * \details     Until its first write an elastic transaction only keeps its most recent reads
+ *              consistent with each other. Earlier reads are dropped, so updates to parts of a
+ *              structure that have already been traversed do not cause aborts. Everything from the
+ *              first write on is executed like a regular read-write transaction.
+ *              Searches in linked structures only depend on the last few visited nodes and should
+ *              write the node they have found to pin it.
+ *              Inside a running transaction behaves like Atomic.
+ * 
+ * \note        The function may be called multiple times if the transaction needs to be restarted. Be
+ *              careful about directly accessing captured variables.
+ * 
+ * \throw       TransactionError
+ * 
+ * \param   func    A callable object that represents the atomic function. Either takes no arguments
+ *                  or a Transaction&.
+ */
+template<class _Cl>
+inline void AtomicElastic(_Cl func);
+
+/**
+ * \brief       Atomically executes the passed function under snapshot isolation. Reads and writes
+ *              are allowed.
+ * 
+ * \details     All reads see a consistent snapshot like in any other transaction, but the commit
+ *              only checks that no other transaction has committed to a written location since it
+ *              was read or since the snapshot was taken. Changes to locations that have only been
+ *              read do not abort the transaction at commit, so long mostly reading transactions that write a
+ *              little commit even if their reads are updated concurrently.
+ *              Two such transactions can both commit after each has read what the other one writes
+ *              (write skew). Constraints spanning several locations must therefore be protected by
+ *              writing one location that both transactions read.
+ *              Only the lock table checks write-write conflicts alone. The other algorithms run
+ *              these transactions serializable.
+ *              Inside a running transaction behaves like Atomic.
+ * 
+ * \note        The function may be called multiple times if the transaction needs to be restarted. Be
+ *              careful about directly accessing captured variables.
+ * 
+ * \throw       TransactionError
+ * 
+ * \param   func    A callable object that represents the atomic function. Either takes no arguments
+ *                  or a Transaction&.
+ */
+template<class _Cl>
+inline void AtomicSnapshot(_Cl func);
+
+/**
+ * Runs func once after the running transaction has committed. Actions registered in nested atomic
+ * blocks belong to the outer most transaction and run after it has committed. Actions of an attempt
+ * that is rolled back are discarded, the restarted attempt registers them again. Actions run in the
+ * order they have been registered, outside of any transaction.
+ *
+ * Intended for side effects that must not be repeated by restarts such as I/O. The closure is
+ * stored without allocation if it is small. Actions must not throw.
+ *
+ * \throw TransactionError If called outside of a transaction.
+ */
+template<class _Cl>
+inline void OnCommit(_Cl func);
+
+/**
+ * Runs func every time the attempt of the running transaction that registered it is rolled back,
+ * either to restart or because the transaction has been terminated by an error. Actions run in the
+ * order they have been registered. Actions of a restarted attempt run before the transaction has
+ * terminated and must therefore not access transactional memory. Actions must not throw.
+ *
+ * \throw TransactionError If called outside of a transaction.
+ */
+template<class _Cl>
+inline void OnAbort(_Cl func);
+
+/**
+ * Aborts the running transaction and blocks the thread until a location the transaction has read
+ * is written by another transaction, then restarts it. Used to wait for a condition such as a
+ * queue becoming non-empty without spinning.
+ *
+ * The first Retry only restarts the transaction right away to record the values it reads.
+ * Waiting threads register for the wait stripes of those locations and commits that write to
+ * one of them wake the waiting threads up. Inside OrElse the next alternative is tried instead.
+ * A transaction that has not read anything is restarted after yielding.
+ *
+ * \throw TransactionError Always. Must not be caught by the atomic function.
+ */
+[[noreturn]] void Retry();
+
+/**
+ * Atomically executes first. If first calls Retry, its reads stay part of the transaction and
+ * second is executed instead. If second also calls Retry the whole transaction waits until a
+ * location read by either of them has been written.
+ * 
+ * first must call Retry before it writes anything, otherwise a no-restart TransactionError is
+ * thrown. Inside a running transaction becomes part of it like Atomic.
+ *
+ * \throw TransactionError
+ */
+template<class _Cl1, class _Cl2>
+inline void OrElse(_Cl1 first, _Cl2 second);
+
+/**
+ * Like Atomic but records the statistics of the transaction in site and executes it in the mode
+ * adapted by site. See Site. Inside a running transaction behaves like Atomic.
+ */
+template<class _Cl>
+inline void Atomic(Site& site, _Cl func);
+
+/**
+ * Like AtomicRead but records the statistics of the transaction in site and executes it in the
+ * mode adapted by site. See Site. Inside a running transaction behaves like AtomicRead.
+ */
+template<class _Cl>
+inline void AtomicRead(Site& site, _Cl func);
+
 
 //
 // Inline function definitions
@@ -275,212 +1016,367 @@ inline void* WordAlignedAddress(void* addr) {
 }
 } // namespace detail
 
-template<>
-inline uint8_t Read<uint8_t>(uint8_t* addr) {
-	constexpr size_t kShift[]{ 0, 8, 16, 24, 32, 40, 48, 56 };
+namespace detail {
+
+template<class _Ty, class _Access>
+inline _Ty ReadVariable(_Access& access, _Ty* addr) {
+	static_assert(std::is_arithmetic_v<_Ty> || std::is_enum_v<_Ty>, "Only arithmetic and enum types can be read");
+	static_assert(sizeof(_Ty) <= sizeof(Word));
+
+	// Variables are naturally aligned so the offset within the word selects the bits
+	const size_t shift{ (reinterpret_cast<size_t>(addr) & kWordAlignMask) * 8u };
+	const UnsignedOfSize<sizeof(_Ty)> bits{ static_cast<UnsignedOfSize<sizeof(_Ty)>>(access.ReadWord(WordAlignedAddress(addr)) >> shift) };
 
-	const uint8_t index{ static_cast<uint8_t>(reinterpret_cast<size_t>(addr) & 0b111u) };
-	Word data{ ReadWord(detail::WordAlignedAddress(addr)) };
-	return static_cast<uint8_t>(data >> kShift[index]);
+	_Ty data;
+	std::memcpy(&data, &bits, sizeof(_Ty));
+	return data;
 }
 
-template<>
-inline void Write<uint8_t>(uint8_t* addr, uint8_t data) {
-	constexpr Word kMask[]{ 0x00000000000000FFu, 0x000000000000FF00u, 0x0000000000FF0000u, 0x00000000FF000000u,
-		0x000000FF00000000u, 0x0000FF0000000000u, 0x00FF000000000000u, 0xFF00000000000000u };
-	constexpr size_t kShift[]{ 0, 8, 16, 24, 32, 40, 48, 56 };
+template<class _Ty, class _Access>
+inline void WriteVariable(_Access& access, _Ty* addr, _Ty data) {
+	static_assert(std::is_arithmetic_v<_Ty> || std::is_enum_v<_Ty>, "Only arithmetic and enum types can be written");
+	static_assert(sizeof(_Ty) <= sizeof(Word));
+
+	UnsignedOfSize<sizeof(_Ty)> bits;
+	std::memcpy(&bits, &data, sizeof(_Ty));
 
-	const uint8_t index{ static_cast<uint8_t>(reinterpret_cast<size_t>(addr) & 0b111u) };
-	Word d{ static_cast<Word>(data) << kShift[index] };
-	WriteWord(detail::WordAlignedAddress(addr), d, kMask[index]);
+	const size_t shift{ (reinterpret_cast<size_t>(addr) & kWordAlignMask) * 8u };
+	const Word mask{ static_cast<Word>(std::numeric_limits<UnsignedOfSize<sizeof(_Ty)>>::max()) << shift };
+	access.WriteWord(WordAlignedAddress(addr), static_cast<Word>(bits) << shift, mask);
 }
 
-template<>
-inline int8_t Read<int8_t>(int8_t* addr) {
-	return static_cast<int8_t>(Read<uint8_t>(reinterpret_cast<uint8_t*>(addr)));
+Word ThreadAccess::ReadWord(void* address) const {
+	return ::nlane::transactional::ReadWord(address);
 }
 
-template<>
-inline void Write<int8_t>(int8_t* addr, int8_t data) {
-	Write<uint8_t>(reinterpret_cast<uint8_t*>(addr), static_cast<uint8_t>(data));
+void ThreadAccess::WriteWord(void* address, Word data, Word mask) const {
+	::nlane::transactional::WriteWord(address, data, mask);
 }
 
-template<>
-inline uint16_t Read<uint16_t>(uint16_t* addr) {
-	constexpr size_t kShift[]{ 0, 16, 32, 48 };
+template<class _Cl>
+inline void Invoke(_Cl& func) {
+	if constexpr (std::is_invocable_v<_Cl&, Transaction&>) {
+		Transaction transaction{ CurrentTransaction() };
+		func(transaction);
+	} else {
+		func();
+	}
+}
 
-	const uint8_t index{ static_cast<uint8_t>((reinterpret_cast<size_t>(addr) & 0b110u) >> 1u) };
-	Word data{ ReadWord(detail::WordAlignedAddress(addr)) };
-	return static_cast<uint16_t>(data >> kShift[index]);
+} // namespace detail
+
+template<typename _Ty, std::enable_if_t<!std::is_pointer_v<_Ty>, int>>
+inline _Ty Read(_Ty* addr) {
+	detail::ThreadAccess access;
+	return detail::ReadVariable(access, addr);
 }
 
-template<>
-inline void Write<uint16_t>(uint16_t* addr, uint16_t data) {
-	constexpr Word kMask[]{ 0x000000000000FFFFu, 0x00000000FFFF0000u, 0x0000FFFF00000000u, 0xFFFF000000000000u };
-	constexpr size_t kShift[]{ 0, 16, 32, 48 };
+template<typename _Ty, std::enable_if_t<!std::is_pointer_v<_Ty>, int>>
+inline void Write(_Ty* addr, _Ty data) {
+	detail::ThreadAccess access;
+	detail::WriteVariable(access, addr, data);
+}
 
-	const uint8_t index{ static_cast<uint8_t>((reinterpret_cast<size_t>(addr) & 0b110u) >> 1u) };
-	Word d{ static_cast<Word>(data) << kShift[index] };
-	WriteWord(detail::WordAlignedAddress(addr), d, kMask[index]);
+template<class _Cl>
+inline _Cl* Read(_Cl** addr) {
+	return reinterpret_cast<_Cl*>(Read<size_t>(reinterpret_cast<size_t*>(addr)));
 }
 
-template<>
-inline int16_t Read<int16_t>(int16_t* addr) {
-	return static_cast<int16_t>(Read<uint16_t>(reinterpret_cast<uint16_t*>(addr)));
+template<class _Cl>
+inline void Write(_Cl** addr, _Cl* data) {
+	Write<size_t>(reinterpret_cast<size_t*>(addr), reinterpret_cast<size_t>(data));
 }
 
-template<>
-inline void Write<int16_t>(int16_t* addr, int16_t data) {
-	Write<uint16_t>(reinterpret_cast<uint16_t*>(addr), static_cast<uint16_t>(data));
+Transaction::Transaction(void* engine, ReadFunction read_word, WriteFunction write_word)
+	: engine_{ engine }, read_word_{ read_word }, write_word_{ write_word } {
 }
 
-template<>
-inline uint32_t Read<uint32_t>(uint32_t* addr) {
-	constexpr size_t kShift[]{ 0, 32 };
+Word Transaction::ReadWord(void* address) {
+	return read_word_(engine_, address);
+}
 
-	const uint8_t index{ static_cast<uint8_t>(reinterpret_cast<size_t>(addr) & 4u) != 0u };
-	Word data{ ReadWord(detail::WordAlignedAddress(addr)) };
-	return static_cast<uint32_t>(data >> kShift[index]);
+void Transaction::WriteWord(void* address, Word data, Word mask) {
+	write_word_(engine_, address, data, mask);
 }
 
-template<>
-inline void Write<uint32_t>(uint32_t* addr, uint32_t data) {
-	constexpr Word kMask[]{ 0x00000000FFFFFFFFu, 0xFFFFFFFF00000000 };
-	constexpr size_t kShift[]{ 0, 32 };
+template<typename _Ty, std::enable_if_t<!std::is_pointer_v<_Ty>, int>>
+_Ty Transaction::Read(_Ty* addr) {
+	return detail::ReadVariable(*this, addr);
+}
 
-	const uint8_t index{ static_cast<uint8_t>(reinterpret_cast<size_t>(addr) & 4u) != 0u };
-	Word d{ static_cast<Word>(data) << kShift[index] };
-	WriteWord(detail::WordAlignedAddress(addr), d, kMask[index]);
+template<typename _Ty, std::enable_if_t<!std::is_pointer_v<_Ty>, int>>
+void Transaction::Write(_Ty* addr, _Ty data) {
+	detail::WriteVariable(*this, addr, data);
 }
 
-template<>
-inline int32_t Read<int32_t>(int32_t* addr) {
-	return static_cast<int32_t>(Read<uint32_t>(reinterpret_cast<uint32_t*>(addr)));
+template<typename _Ty>
+_Ty* Transaction::Read(_Ty** addr) {
+	return reinterpret_cast<_Ty*>(Read<size_t>(reinterpret_cast<size_t*>(addr)));
 }
 
-template<>
-inline void Write<int32_t>(int32_t* addr, int32_t data) {
-	Write<uint32_t>(reinterpret_cast<uint32_t*>(addr), static_cast<uint32_t>(data));
+template<typename _Ty>
+void Transaction::Write(_Ty** addr, _Ty* data) {
+	Write<size_t>(reinterpret_cast<size_t*>(addr), reinterpret_cast<size_t>(data));
 }
 
-template<>
-inline uint64_t Read<uint64_t>(uint64_t* addr) {
-	return ReadWord(addr);
+void Transaction::Release(void* addr) {
+	::nlane::transactional::Release(addr);
 }
 
-template<>
-inline void Write<uint64_t>(uint64_t* addr, uint64_t data) {
-	return WriteWord(addr, data, ~static_cast<uint64_t>(0));
+template<class _Cl>
+inline void Atomic(_Cl func) {
+    if (!detail::InvokeNested(detail::IsReadWriteCompatible(), func, detail::kNestedReadWriteError)) {
+        detail::RunTransaction(detail::BeginReadWrite, func);
+    }
 }
 
-template<>
-inline int64_t Read<int64_t>(int64_t* addr) {
-	return ReadWord(addr);
+template<class _Cl>
+inline void AtomicRead(_Cl func) {
+    if (!detail::InvokeNested(detail::IsReadOnlyCompatible(), func, detail::kNestedReadOnlyError)) {
+        detail::RunTransaction(detail::BeginReadOnly, func);
+    }
 }
 
-template<>
-inline void Write<int64_t>(int64_t* addr, int64_t data) {
-	return WriteWord(addr, data, ~static_cast<uint64_t>(0));
+template<class _Cl>
+inline void AtomicElastic(_Cl func) {
+    if (!detail::InvokeNested(detail::IsReadWriteCompatible(), func, detail::kNestedReadWriteError)) {
+        detail::RunTransaction(detail::BeginElastic, func);
+    }
 }
 
-template<>
-inline float Read<float>(float* addr) {
-	uint32_t data{ Read<uint32_t>(reinterpret_cast<uint32_t*>(addr)) };
-	return *reinterpret_cast<float*>(&data);
+template<class _Cl>
+inline void AtomicSnapshot(_Cl func) {
+    if (!detail::InvokeNested(detail::IsReadWriteCompatible(), func, detail::kNestedReadWriteError)) {
+        detail::RunTransaction(detail::BeginSnapshot, func);
+    }
 }
 
-template<>
-inline void Write<float>(float* addr, float data) {
-	Write<uint32_t>(reinterpret_cast<uint32_t*>(addr), *reinterpret_cast<uint32_t*>(&data));
+template<class _Cl1, class _Cl2>
+inline void OrElse(_Cl1 first, _Cl2 second) {
+    Atomic([&]() {
+        const size_t writes{ detail::GetAttemptWrites() };
+        try {
+            detail::Invoke(first);
+            return;
+        }
+        catch (TransactionError&) {
+            if (!detail::TakeRetryRequest()) {
+                throw;
+            }
+        }
+
+        if (detail::GetAttemptWrites() != writes) {
+            throw TransactionError{ "The first alternative of OrElse has written before calling Retry", false };
+        }
+        detail::Invoke(second);
+    });
 }
 
-template<>
-inline double Read<double>(double* addr) {
-	uint64_t data{ Read<uint64_t>(reinterpret_cast<uint64_t*>(addr)) };
-	return *reinterpret_cast<double*>(&data);
+template<class _Cl>
+inline void OnCommit(_Cl func) {
+    detail::PushCommitAction(detail::DeferredAction{ std::move(func) });
 }
 
-template<>
-inline void Write<double>(double* addr, double data) {
-	Write<uint64_t>(reinterpret_cast<uint64_t*>(addr), *reinterpret_cast<uint64_t*>(&data));
+template<class _Cl>
+inline void OnAbort(_Cl func) {
+    detail::PushAbortAction(detail::DeferredAction{ std::move(func) });
 }
 
 template<class _Cl>
-inline _Cl* Read<_Cl*>(_Cl** addr) {
-	return reinterpret_cast<_Cl*>(Read<size_t>(reinterpret_cast<size_t*>(addr)));
+inline void Batch::Add(_Cl func) {
+    if (detail::IsReadWriteCompatible() != detail::PromotionState::NO_RUNNING) {
+        Atomic(func);
+        return;
+    }
+
+    queue_.emplace_back([func]() mutable {
+        detail::Invoke(func);
+    });
+    if (queue_.size() >= max_group_) {
+        Flush();
+    }
 }
 
+namespace detail {
+
 template<class _Cl>
-inline void Write<_Cl*>(_Cl** addr, _Cl* data) {
-	Write<size_t>(reinterpret_cast<size_t*>(addr), reinterpret_cast<size_t>(data));
+const DeferredAction::Ops DeferredAction::kInlineOps{
+    [](void* storage) {
+        (*static_cast<_Cl*>(storage))();
+    },
+    [](void* from, void* to) {
+        new (to) _Cl{ std::move(*static_cast<_Cl*>(from)) };
+        static_cast<_Cl*>(from)->~_Cl();
+    },
+    [](void* storage) {
+        static_cast<_Cl*>(storage)->~_Cl();
+    },
+};
+
+template<class _Cl>
+const DeferredAction::Ops DeferredAction::kHeapOps{
+    [](void* storage) {
+        (**static_cast<_Cl**>(storage))();
+    },
+    [](void* from, void* to) {
+        *static_cast<_Cl**>(to) = *static_cast<_Cl**>(from);
+    },
+    [](void* storage) {
+        delete *static_cast<_Cl**>(storage);
+    },
+};
+
+template<class _Cl>
+DeferredAction::DeferredAction(_Cl func) {
+    if constexpr (kStoredInline<_Cl>) {
+        new (storage_) _Cl{ std::move(func) };
+        ops_ = &kInlineOps<_Cl>;
+    } else {
+        *reinterpret_cast<_Cl**>(storage_) = new _Cl{ std::move(func) };
+        ops_ = &kHeapOps<_Cl>;
+    }
+}
+
+DeferredAction::DeferredAction(DeferredAction&& other) noexcept : ops_{ other.ops_ } {
+    ops_->relocate(other.storage_, storage_);
+    other.ops_ = nullptr;
+}
+
+DeferredAction::~DeferredAction() {
+    if (ops_ != nullptr) {
+        ops_->destroy(storage_);
+    }
+}
+
+void DeferredAction::operator()() {
+    ops_->invoke(storage_);
+}
+
+ActionDeferral::ActionDeferral() {
+    BeginDeferral();
+}
+
+ActionDeferral::~ActionDeferral() {
+    EndDeferral();
 }
 
 template<class _Cl>
-inline void Atomic(_Cl func) {
-    detail::PromotionState state{ detail::IsReadWriteCompatible() };
-	if (state != detail::PromotionState::NO_RUNNING) {
-        if(state == detail::PromotionState::COMPATIBLE) {
-		    func();
+inline bool InvokeNested(PromotionState state, _Cl& func, const char* incompatible) {
+    if (state == PromotionState::NO_RUNNING) {
+        return false;
+    }
+    if (state != PromotionState::COMPATIBLE) {
+        throw TransactionError{ incompatible, false };
+    }
+
+    Invoke(func);
+    return true;
+}
+
+template<class _Cl>
+inline void RunTransaction(void (*begin)(), _Cl& func) {
+    while (true) {
+        try {
+            begin();
+
+            Invoke(func);
+
+            Commit();
             return;
-        } else {
-            throw TransactionError{ "Cannot embed read-write transaction inside read-only transaction", false };
         }
-	}
-	
-	while (true) {
-		try {
-			detail::BeginReadWrite();
-
-			func();
-
-			detail::Commit();
-			return;
-		}
-		catch (TransactionError& err) {
-			if (!err.shouldRetry()) {
-				detail::End();
-				throw;
-			}
-		}
-		catch (...) {
-			detail::End();
-			throw;
-		}
-	}
+        catch (TransactionError& err) {
+            if (!err.shouldRetry()) {
+                End();
+                throw;
+            }
+        }
+        catch (...) {
+            End();
+            throw;
+        }
+    }
 }
 
 template<class _Cl>
-inline void AtomicRead(_Cl func) {
-    detail::PromotionState state{ detail::IsReadOnlyCompatible() };
-	if (state != detail::PromotionState::NO_RUNNING) {
-        if(state == detail::PromotionState::COMPATIBLE) {
-		    func();
+inline void InvokeAtSite(Site& site, _Cl& func, bool may_write) {
+    // Commit actions run once the site is unlocked, they may run transactions at the same site
+    ActionDeferral deferral;
+
+    bool read_only{ !may_write || site.IsReadOnly() };
+    while (true) {
+        // Only held for one attempt. Everything between attempts happens after unlocking.
+        std::unique_lock<std::mutex> lock{ site.mutex_, std::defer_lock };
+        if (site.IsSerialized()) {
+            lock.lock();
+        }
+
+        try {
+            SetTimestampWrites(site.GetTimestampWrites());
+            if (read_only) {
+                BeginReadOnly();
+                SetWriteTrap(may_write);
+            }
+            else {
+                BeginReadWrite();
+            }
+
+            Invoke(func);
+
+            const size_t writes{ GetAttemptWrites() };
+            Commit();
+            site.OnCommit(writes);
             return;
-        } else {
-            throw TransactionError{ "Read only transaction is for some reason incompatible. This should never happen.", false };
         }
-	}
-	
-	while (true) {
-		try {
-			detail::BeginReadOnly();
-
-			func();
-
-			detail::Commit();
-			return;
-		}
-		catch (TransactionError& err) {
-			if (!err.shouldRetry()) {
-				detail::End();
-				throw;
-			}
-		}
-		catch (...) {
-			detail::End();
-			throw;
-		}
-	}
+        catch (TransactionError& err) {
+            const bool serialized{ lock.owns_lock() };
+            if (serialized) {
+                lock.unlock();
+            }
+
+            if (!err.shouldRetry()) {
+                End();
+                throw;
+            }
+
+            if (TakeTrappedWrite()) {
+                // The transaction can not change its mode while running
+                End();
+                read_only = false;
+                site.OnUpgrade();
+            }
+            else {
+                site.OnAbort();
+
+                // A restart would back off and run the abort actions while the next attempt holds the lock
+                if (serialized || site.IsSerialized()) {
+                    AbortAttempt();
+                }
+            }
+        }
+        catch (...) {
+            if (lock.owns_lock()) {
+                lock.unlock();
+            }
+            End();
+            throw;
+        }
+    }
+}
+
+} // namespace detail
+
+template<class _Cl>
+inline void Atomic(Site& site, _Cl func) {
+    if (!detail::InvokeNested(detail::IsReadWriteCompatible(), func, detail::kNestedReadWriteError)) {
+        detail::InvokeAtSite(site, func, true);
+    }
+}
+
+template<class _Cl>
+inline void AtomicRead(Site& site, _Cl func) {
+    if (!detail::InvokeNested(detail::IsReadOnlyCompatible(), func, detail::kNestedReadOnlyError)) {
+        detail::InvokeAtSite(site, func, false);
+    }
 }
 
 } // namespace transactional
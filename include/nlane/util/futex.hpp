@@ -0,0 +1,51 @@
+/**
+ * Copyright 2020 Lorenzo Rai
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software 
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. 
+ */
+/**
+ * This file contains blocking waits on 32 bit words. On Linux they use futexes, elsewhere the
+ * waiting thread yields until the word changes. It also contains a fence executed on all threads
+ * at once, which lets the common side of a rarely taken handshake get away without a fence.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace nlane::util {
+
+/**
+ * Blocks the calling thread while word holds expected. May return spuriously.
+ */
+void FutexWait(std::atomic<uint32_t>& word, uint32_t expected);
+
+/**
+ * Wakes all threads blocked in FutexWait on word. The word must be changed before.
+ */
+void FutexWakeAll(std::atomic<uint32_t>& word);
+
+/**
+ * Prepares the process for SystemFence. Returns false if system wide fences are not supported,
+ * SystemFence must not be relied on then.
+ */
+bool InitSystemFence();
+
+/**
+ * Executes a full memory barrier on every running thread of the process. Pairs with compiler
+ * barriers on the other threads in place of regular fences.
+ */
+void SystemFence();
+
+} // namespace nlane::util
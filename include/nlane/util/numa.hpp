@@ -0,0 +1,76 @@
+/**
+ * Copyright 2020 Lorenzo Rai
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software 
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. 
+ */
+/**
+ * This file contains the placement of memory on NUMA nodes. Without NUMA support (NLANE_NUMA)
+ * the system is treated as a single node and memory is allocated normally.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <limits>
+
+namespace nlane::util {
+
+// Passed to RunOnNode to allow running on all nodes again
+constexpr size_t kAnyNode{ std::numeric_limits<size_t>::max() };
+
+/**
+ * \returns The number of NUMA nodes of the system.
+ */
+size_t GetNumNodes();
+
+/**
+ * \returns The node of the CPU the calling thread currently runs on.
+ */
+size_t GetCurrentNode();
+
+/**
+ * Allocates zeroed memory on the specified node. Aligned to at least 64 bytes.
+ *
+ * \throw std::bad_alloc If the allocation failed.
+ */
+void* AllocateOnNode(size_t size, size_t node);
+
+/**
+ * Allocates zeroed memory whose pages are interleaved over all nodes. Meant for large shared
+ * tables. Aligned to at least 64 bytes. Pages are only backed by memory once they are touched.
+ *
+ * \throw std::bad_alloc If the allocation failed.
+ */
+void* AllocateInterleaved(size_t size);
+
+/**
+ * Frees memory allocated with AllocateOnNode or AllocateInterleaved.
+ *
+ * \param size The size passed to the allocation.
+ */
+void Free(void* memory, size_t size);
+
+/**
+ * Moves the pages of the specified range to node. Pages that have not been touched yet are
+ * placed there once they are. Only whole pages inside the range are affected.
+ */
+void BindToNode(void* memory, size_t size, size_t node);
+
+/**
+ * Restricts the calling thread to the CPUs of node. Threads created afterwards inherit the restriction.
+ *
+ * \param node The node or kAnyNode to allow all CPUs again.
+ */
+void RunOnNode(size_t node);
+
+} // namespace nlane::util
@@ -0,0 +1,1487 @@
+/**
+ * Copyright 2020 Lorenzo Rai
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include <nlane/transactional/coroutine.hpp>
+#include <nlane/transactional/dispatch.hpp>
+#include <nlane/transactional/ring_engine.hpp>
+#include <nlane/transactional/seq_lock_engine.hpp>
+#include <nlane/transactional/serial_engine.hpp>
+#include <nlane/transactional/transaction_engine.hpp>
+#include <nlane/transactional/transaction_support.hpp>
+#include <nlane/util/futex.hpp>
+
+namespace nlane::transactional::detail {
+
+// A location read by a transaction that may call Retry and the value it has read
+struct RetryRead {
+	const void* address;
+	Word value;
+};
+
+// The states of a detached transaction suspended in Retry
+enum class WaitState : uint8_t {
+	// The transaction validates its reads and can not be resumed yet
+	VALIDATING,
+	WAITING,
+	WOKEN,
+};
+
+/**
+ * A transaction bound to a coroutine frame instead of a thread. Owns an engine of the lock table
+ * algorithm and its thread id. Pooled so engines and ids are reused by later transactions.
+ */
+struct DetachedTransaction {
+	TransactionEngine engine;
+
+	bool active;
+	bool retry_requested;
+
+	// The number of words written by the current attempt and the wait stripes they belong to
+	size_t writes;
+	uint64_t written[kWaitStripes / 64u];
+
+	// Always recorded so Retry can suspend right away
+	std::vector<RetryRead> reads;
+
+	// Only used while the transaction is suspended in Retry
+	uint64_t stripes[kWaitStripes / 64u];
+	std::atomic<WaitState> wait_state;
+	void (*resume)(void* frame);
+	void* frame;
+};
+
+namespace {
+
+constexpr size_t kNumAlgorithms{ 4u };
+
+// Thresholds used by SelectAlgorithm
+constexpr double kSerialAbortRate{ 0.5 };
+constexpr double kSerialWrites{ 8.0 };
+constexpr double kReadMostlyWrites{ 0.1 };
+constexpr double kLargeReads{ 64.0 };
+
+// Set while a quiescent operation waits for all start versions to become kNotRunning
+std::atomic<bool> switching{ false };
+
+// The number of running detached transactions. They may be suspended indefinitely.
+std::atomic<uint32_t> detached_running{ 0u };
+
+std::atomic<bool> adaptive{ false };
+
+// The global statistics of the current window
+alignas(64) std::atomic<uint64_t> window_count{ 0u };
+std::atomic<uint64_t> window_commits{ 0u };
+std::atomic<uint64_t> window_aborts{ 0u };
+std::atomic<uint64_t> window_reads{ 0u };
+std::atomic<uint64_t> window_writes{ 0u };
+
+// Incremented by every privatization fence. Transactions record its value when they start.
+alignas(64) std::atomic<uint64_t> privatization_clock{ 1u };
+
+// The start version of engines that are not running a transaction
+constexpr uint64_t kNotRunning{ 0u };
+
+// Only written by the engine it belongs to, so entering a transaction never contends with other threads
+struct alignas(64) StartVersion {
+	std::atomic<uint64_t> version{ kNotRunning };
+};
+
+/**
+ * The privatization clock at which the running transaction of every engine started, indexed by
+ * thread id. Also marks the engine as active, privatization fences and quiescent operations both
+ * wait for these.
+ */
+StartVersion start_versions[kMaxThreads];
+
+std::atomic<bool> auto_privatization{ false };
+
+// The number of threads waiting in Retry and the number of them waiting for each wait stripe
+alignas(64) std::atomic<uint32_t> num_waiters{ 0u };
+std::atomic<uint32_t> stripe_waiters[kWaitStripes];
+
+// Set once the first waiter has registered. Until then commits skip their fence if lazy_wake is set.
+std::atomic<bool> waiters_registered{ false };
+
+// True if the first waiter can execute the fence of the commits that skipped it with util::SystemFence
+const bool lazy_wake{ util::InitSystemFence() };
+
+// A thread blocked in Retry. Lives on the stack of the waiting thread while it is registered.
+struct ThreadWaiter {
+	uint64_t stripes[kWaitStripes / 64u];
+
+	// The futex word the thread blocks on. Set by the first commit to one of its stripes.
+	std::atomic<uint32_t> woken;
+};
+
+// The number of windows the serial mode is kept before the statistics are trusted again. Threads
+// completing successive windows may evaluate them at the same time.
+std::atomic<uint32_t> serial_hold{ 1u };
+std::atomic<uint32_t> serial_remaining{ 0u };
+
+struct ThreadState {
+	bool active;
+	bool read_only;
+
+	// See SetWriteTrap. trapped is set once the trap has aborted the transaction.
+	bool write_trap;
+	bool trapped;
+
+	// The number of words written by the current attempt
+	size_t writes;
+
+	// Set by Retry until the transaction has been restarted
+	bool retry_requested;
+
+	// True while the reads of the transaction are recorded in retry_reads
+	bool track_reads;
+
+	// Bit i is set if the current attempt has written to wait stripe i
+	uint64_t written[kWaitStripes / 64u];
+
+	// See SetTimestampWrites
+	size_t timestamp_writes;
+
+	uint64_t pending;
+	AlgorithmStats stats;
+
+	// The number of entries in captured_ranges. Checked first so accesses only touch the vector if needed
+	size_t num_captured;
+
+	// The number of entries in private_undo
+	size_t num_private_writes;
+
+	// The number of entries in commit_actions and abort_actions
+	size_t num_actions;
+
+	// The number of entries in pending_resumes
+	size_t num_resumes;
+
+	// The nesting depth of BeginDeferral
+	size_t defer_depth;
+
+	// The backoff of AbortAttempt. Reset by every commit.
+	uint16_t backoff;
+};
+
+// Zero initialized so no thread local guard is needed
+thread_local ThreadState thread_state;
+
+// Memory allocated by the running transaction of this thread
+struct CapturedRange {
+	size_t begin;
+	size_t end;
+};
+
+thread_local std::vector<CapturedRange> captured_ranges;
+
+// The previous content of a word of a private region written by the running attempt
+struct PrivateUndo {
+	void* address;
+	Word data;
+};
+
+thread_local std::vector<PrivateUndo> private_undo;
+
+thread_local std::vector<RetryRead> retry_reads;
+
+// Guards the pool of detached transactions and the lists of threads and detached transactions waiting in Retry
+std::mutex detached_mutex;
+std::vector<DetachedTransaction*> detached_pool;
+std::vector<ThreadWaiter*> thread_waiters;
+std::vector<DetachedTransaction*> detached_waiters;
+std::atomic<size_t> num_detached_waiters{ 0u };
+
+// Detached transactions woken by commits of this thread. Resumed once the commit has finished.
+thread_local std::vector<DetachedTransaction*> pending_resumes;
+
+// Resumes the woken detached transactions instead of the committing threads, see SetResumeExecutor
+std::atomic<ResumeExecutor> resume_executor{ nullptr };
+
+// The deferred actions of the running transaction. Keep their capacity so small actions do not allocate.
+thread_local std::vector<DeferredAction> commit_actions;
+thread_local std::vector<DeferredAction> abort_actions;
+
+// Commit actions of committed transactions held back until the outer most deferral ends
+thread_local std::vector<DeferredAction> deferred_actions;
+
+thread_local Xoroshiro128pp backoff_rng{ CreateEngineRng() };
+
+// Runs the actions of the terminated or restarted attempt and discards all queued actions
+void RunActions(bool committed) noexcept {
+	if (thread_state.num_actions == 0u) {
+		return;
+	}
+	thread_state.num_actions = 0u;
+
+	if (committed && (thread_state.defer_depth != 0u)) {
+		for (DeferredAction& action : commit_actions) {
+			deferred_actions.emplace_back(std::move(action));
+		}
+		commit_actions.clear();
+		abort_actions.clear();
+		return;
+	}
+
+	// Actions may register new actions for transactions they start themselves
+	std::vector<DeferredAction> actions{ std::move(committed ? commit_actions : abort_actions) };
+	commit_actions.clear();
+	abort_actions.clear();
+
+	for (DeferredAction& action : actions) {
+		action();
+	}
+
+	// Hand the storage back unless an action has queued new actions in the meantime
+	actions.clear();
+	std::vector<DeferredAction>& queue{ committed ? commit_actions : abort_actions };
+	if (queue.empty()) {
+		queue = std::move(actions);
+	}
+}
+
+inline bool TestStripe(const uint64_t (&stripes)[kWaitStripes / 64u], size_t stripe) {
+	return (stripes[stripe / 64u] & (static_cast<uint64_t>(1u) << (stripe % 64u))) != 0u;
+}
+
+inline void SetStripe(uint64_t (&stripes)[kWaitStripes / 64u], size_t stripe) {
+	stripes[stripe / 64u] |= static_cast<uint64_t>(1u) << (stripe % 64u);
+}
+
+inline void RecordRead(const void* address, Word value) {
+	// Locations written by the transaction itself hold other values in memory than it has read
+	if (!TestStripe(thread_state.written, GetWaitStripe(address))) {
+		retry_reads.push_back(RetryRead{ address, value });
+	}
+}
+
+inline void RecordWrite(const void* address) {
+	SetStripe(thread_state.written, GetWaitStripe(address));
+	thread_state.writes++;
+}
+
+// Forgets the locations accessed by the previous attempt
+void ResetAttempt() {
+	if (thread_state.writes != 0u) {
+		std::fill(std::begin(thread_state.written), std::end(thread_state.written), 0u);
+		thread_state.writes = 0u;
+	}
+	if (thread_state.track_reads) {
+		retry_reads.clear();
+	}
+}
+
+// Calls func with the index of every set bit of stripes
+template<class _Fn>
+void ForEachStripe(const uint64_t (&stripes)[kWaitStripes / 64u], _Fn&& func) {
+	for (size_t i{ 0 }; i < kWaitStripes / 64u; i++) {
+		for (uint64_t bits{ stripes[i] }; bits != 0u; bits &= bits - 1u) {
+			func((i * 64u) + __builtin_ctzll(bits));
+		}
+	}
+}
+
+// Returns true if the wait stripes a and b have a stripe in common
+bool Intersects(const uint64_t (&a)[kWaitStripes / 64u], const uint64_t (&b)[kWaitStripes / 64u]) {
+	for (size_t i{ 0 }; i < kWaitStripes / 64u; i++) {
+		if ((a[i] & b[i]) != 0u) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Registers a waiter for stripes so commits to them wake the waiters up
+void AddWaiter(const uint64_t (&stripes)[kWaitStripes / 64u]) {
+	if (!waiters_registered.load(std::memory_order_relaxed) && !waiters_registered.exchange(true) && lazy_wake) {
+		// Every commit that skipped its fence either sees this waiter from here on or has its
+		// write back visible to the reads the waiter checks before blocking
+		util::SystemFence();
+	}
+
+	num_waiters.fetch_add(1u);
+	ForEachStripe(stripes, [](size_t stripe) {
+		stripe_waiters[stripe].fetch_add(1u);
+	});
+}
+
+void RemoveWaiter(const uint64_t (&stripes)[kWaitStripes / 64u]) {
+	ForEachStripe(stripes, [](size_t stripe) {
+		stripe_waiters[stripe].fetch_sub(1u, std::memory_order_relaxed);
+	});
+	num_waiters.fetch_sub(1u, std::memory_order_relaxed);
+}
+
+// Returns true if every location in reads still holds the value that has been read
+bool IsUnchanged(const std::vector<RetryRead>& reads) {
+	return std::all_of(reads.begin(), reads.end(), [](const RetryRead& read) {
+		return LoadWord(read.address) == read.value;
+	});
+}
+
+/**
+ * Wakes the threads waiting for one of the written stripes and moves the suspended detached
+ * transactions waiting for one of them to pending_resumes. Waiters of other stripes keep sleeping.
+ */
+void ClaimWaiters(const uint64_t (&written)[kWaitStripes / 64u]) {
+	std::lock_guard<std::mutex> lock{ detached_mutex };
+
+	// Waiting threads only leave the list while holding the mutex, so their words stay valid here
+	for (ThreadWaiter* waiter : thread_waiters) {
+		if (Intersects(waiter->stripes, written) && (waiter->woken.load(std::memory_order_relaxed) == 0u)) {
+			waiter->woken.store(1u, std::memory_order_release);
+			util::FutexWakeAll(waiter->woken);
+		}
+	}
+
+	if (num_detached_waiters.load(std::memory_order_relaxed) == 0u) {
+		return;
+	}
+
+	for (size_t i{ 0 }; i < detached_waiters.size();) {
+		DetachedTransaction* waiter{ detached_waiters[i] };
+
+		// Waiters that are still validating notice the wake up themselves and leave the list
+		if (!Intersects(waiter->stripes, written) || (waiter->wait_state.exchange(WaitState::WOKEN) != WaitState::WAITING)) {
+			i++;
+			continue;
+		}
+
+		detached_waiters[i] = detached_waiters.back();
+		detached_waiters.pop_back();
+		num_detached_waiters.fetch_sub(1u, std::memory_order_relaxed);
+		RemoveWaiter(waiter->stripes);
+
+		pending_resumes.push_back(waiter);
+		thread_state.num_resumes++;
+	}
+}
+
+// Resumes the detached transactions claimed by the commits of this thread
+void ResumeDetachedWaiters() {
+	std::vector<DetachedTransaction*> resumes;
+	resumes.swap(pending_resumes);
+	thread_state.num_resumes = 0u;
+
+	// Resumed coroutines may start transactions that claim further waiters
+	const ResumeExecutor executor{ resume_executor.load(std::memory_order_acquire) };
+	for (DetachedTransaction* waiter : resumes) {
+		if (executor != nullptr) {
+			executor(waiter->resume, waiter->frame);
+		} else {
+			waiter->resume(waiter->frame);
+		}
+	}
+}
+
+// Wakes the waiters if the committed transaction has written to a stripe one of them waits for
+void WakeWaiters(const uint64_t (&written)[kWaitStripes / 64u]) {
+	if (lazy_wake) {
+		// Programs that never call Retry do not pay for the fence below. The first waiter executes
+		// it on behalf of this thread if it registers concurrently.
+		std::atomic_signal_fence(std::memory_order_seq_cst);
+		if (!waiters_registered.load(std::memory_order_relaxed)) {
+			return;
+		}
+	}
+
+	// Pairs with the fence of waiters. Either they see the written data or this thread sees them.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (num_waiters.load(std::memory_order_relaxed) == 0u) {
+		return;
+	}
+
+	bool waited{ false };
+	ForEachStripe(written, [&](size_t stripe) {
+		waited = waited || (stripe_waiters[stripe].load(std::memory_order_relaxed) != 0u);
+	});
+	if (waited) {
+		ClaimWaiters(written);
+	}
+}
+
+/**
+ * Called after a transaction has called Retry and left. The first time the transaction is only
+ * restarted to record the values it reads. Afterwards blocks until one of them might have changed.
+ */
+void WaitForRetry() {
+	thread_state.retry_requested = false;
+	if (!thread_state.track_reads) {
+		thread_state.track_reads = true;
+		return;
+	}
+
+	if (retry_reads.empty()) {
+		// Nothing could ever wake the transaction up, let it poll instead
+		std::this_thread::yield();
+		return;
+	}
+
+	ThreadWaiter waiter{};
+	for (const RetryRead& read : retry_reads) {
+		SetStripe(waiter.stripes, GetWaitStripe(read.address));
+	}
+
+	{
+		std::lock_guard<std::mutex> lock{ detached_mutex };
+		thread_waiters.push_back(&waiter);
+		AddWaiter(waiter.stripes);
+	}
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	// Commits that did not see this thread registered have already written back their data
+	if (IsUnchanged(retry_reads)) {
+		while (waiter.woken.load(std::memory_order_acquire) == 0u) {
+			util::FutexWait(waiter.woken, 0u);
+		}
+	}
+
+	std::lock_guard<std::mutex> lock{ detached_mutex };
+	thread_waiters.erase(std::find(thread_waiters.begin(), thread_waiters.end(), &waiter));
+	RemoveWaiter(waiter.stripes);
+}
+
+// Returns true if address lies in memory allocated by the running transaction
+inline bool InCapturedRange(const void* address) {
+	if (thread_state.num_captured == 0u) {
+		return false;
+	}
+
+	// Newly allocated memory is usually initialized right away so search from the back
+	const size_t addr{ reinterpret_cast<size_t>(address) };
+	for (auto it{ captured_ranges.rbegin() }; it != captured_ranges.rend(); ++it) {
+		if ((addr >= it->begin) && (addr < it->end)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Forgets the memory allocated by the terminated transaction. Frees it unless the transaction committed.
+void ReleaseCaptured(bool committed) {
+	if (thread_state.num_captured == 0u) {
+		return;
+	}
+
+	if (!committed) {
+		for (const CapturedRange& range : captured_ranges) {
+			::operator delete(reinterpret_cast<void*>(range.begin));
+		}
+	}
+	captured_ranges.clear();
+	thread_state.num_captured = 0u;
+}
+
+// Restores the words of private regions written by the aborted attempt or forgets them once it has committed
+void ReleasePrivateWrites(bool committed) {
+	if (thread_state.num_private_writes == 0u) {
+		return;
+	}
+
+	if (!committed) {
+		// Backwards so words written multiple times end up with their oldest content
+		for (auto it{ private_undo.rbegin() }; it != private_undo.rend(); ++it) {
+			StoreWord(it->address, it->data);
+		}
+	}
+	private_undo.clear();
+	thread_state.num_private_writes = 0u;
+}
+
+std::atomic<uint64_t>& GetStartVersion() {
+	return start_versions[TransactionEngine::GetThreadEngine().GetId()].version;
+}
+
+/**
+ * Records the start of a restarted attempt in start before it reads any shared data. The aborted
+ * attempt can not write anymore so fences only need to wait for the new one. Skipped unless a
+ * fence has been called since the previous attempt started, keeping the older start only makes
+ * fences wait longer.
+ */
+void PublishRestart(std::atomic<uint64_t>& start) {
+	const uint64_t clock{ privatization_clock.load(std::memory_order_relaxed) };
+	if (start.load(std::memory_order_relaxed) != clock) {
+		start.store(clock, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+}
+
+template<class _Engine>
+PromotionState IsReadWriteCompatible() {
+	return _Engine::GetThreadEngine().IsReadWriteCompatible();
+}
+
+template<class _Engine>
+PromotionState IsReadOnlyCompatible() {
+	return _Engine::GetThreadEngine().IsReadOnlyCompatible();
+}
+
+template<class _Engine>
+void BeginReadWrite() {
+	_Engine::GetThreadEngine().BeginReadWrite();
+}
+
+template<class _Engine>
+void BeginReadOnly() {
+	_Engine::GetThreadEngine().BeginReadOnly();
+}
+
+template<class _Engine>
+void BeginElastic() {
+	_Engine::GetThreadEngine().BeginElastic();
+}
+
+template<class _Engine>
+void BeginSnapshot() {
+	_Engine::GetThreadEngine().BeginSnapshot();
+}
+
+template<class _Engine>
+void Commit() {
+	_Engine::GetThreadEngine().Commit();
+}
+
+template<class _Engine>
+void End() {
+	_Engine::GetThreadEngine().End();
+}
+
+template<class _Engine>
+void Release(void* address) {
+	_Engine::GetThreadEngine().Release(address);
+}
+
+// The number of address ranges that can be registered at the same time
+constexpr size_t kMaxRegions{ 64u };
+
+struct Region {
+	size_t begin;
+	size_t end;
+	RegionKind kind;
+
+	// The thread_state of the owning thread for private regions
+	const ThreadState* owner;
+
+	// Checksum of the content of immutable regions. Only computed while verification is enabled.
+	uint64_t checksum;
+};
+
+// Only modified while no transaction is running so transactions can read them without synchronization
+Region regions[kMaxRegions];
+size_t num_regions{ 0u };
+
+std::atomic<bool> verify_regions{ false };
+
+uint64_t Checksum(size_t begin, size_t end) {
+	// FNV-1a over all words of the region
+	uint64_t hash{ 14695981039346656037ull };
+	for (size_t addr{ begin }; addr < end; addr += sizeof(Word)) {
+		hash = (hash ^ LoadWord(reinterpret_cast<void*>(addr))) * 1099511628211ull;
+	}
+	return hash;
+}
+
+// Returns the registered region containing address or nullptr
+inline const Region* FindRegion(const void* address) {
+	if (num_regions == 0u) {
+		return nullptr;
+	}
+
+	const size_t addr{ reinterpret_cast<size_t>(address) };
+	for (size_t i{ 0 }; i < num_regions; i++) {
+		if ((addr >= regions[i].begin) && (addr < regions[i].end)) {
+			return &regions[i];
+		}
+	}
+	return nullptr;
+}
+
+/**
+ * Returns the registered region containing address or nullptr. Throws if the access is a write to
+ * an immutable region or, while verification is enabled, contradicts the owner of a private region.
+ */
+inline const Region* FindAccessedRegion(const void* address, bool write) {
+	const Region* region{ FindRegion(address) };
+	if (region == nullptr) {
+		return nullptr;
+	}
+
+	// Checked even without verification, the write could neither be undone nor be seen consistently
+	if (write && (region->kind == RegionKind::IMMUTABLE)) {
+		throw TransactionError{ "Write to an immutable region", false };
+	}
+	if (verify_regions.load(std::memory_order_relaxed)) {
+		if ((region->kind == RegionKind::PRIVATE) && (region->owner != &thread_state)) {
+			throw TransactionError{ "Access to a region private to another thread", false };
+		}
+	}
+	return region;
+}
+
+template<class _Engine>
+void* GetEngine() {
+	return &_Engine::GetThreadEngine();
+}
+
+// Memory allocated by the running transaction and registered regions are accessed directly. The
+// profiled variants used in adaptive mode also count all other accesses.
+template<class _Engine, bool _Profiled>
+Word EngineReadWord(void* engine, void* address) {
+	if (InCapturedRange(address) || (FindAccessedRegion(address, false) != nullptr)) {
+		return LoadWord(address);
+	}
+
+	if constexpr (_Profiled) {
+		thread_state.stats.reads++;
+	}
+	const Word data{ static_cast<_Engine*>(engine)->ReadWord(address) };
+	if (thread_state.track_reads) {
+		RecordRead(address, data);
+	}
+	return data;
+}
+
+template<class _Engine, bool _Profiled>
+void EngineWriteWord(void* engine, void* address, Word data, Word mask) {
+	if (InCapturedRange(address)) {
+		StoreWord(address, (LoadWord(address) & ~mask) | (data & mask));
+		return;
+	}
+
+	if (FindAccessedRegion(address, true) != nullptr) {
+		// Only private regions get here. Nobody else sees the word so restoring it on abort is enough.
+		const Word old{ LoadWord(address) };
+		private_undo.push_back(PrivateUndo{ address, old });
+		thread_state.num_private_writes++;
+		StoreWord(address, (old & ~mask) | (data & mask));
+		return;
+	}
+
+	if (thread_state.write_trap) {
+		TrapWrite();
+	}
+
+	if constexpr (_Profiled) {
+		thread_state.stats.writes++;
+	}
+	RecordWrite(address);
+	static_cast<_Engine*>(engine)->WriteWord(address, data, mask);
+}
+
+template<class _Engine, bool _Profiled>
+Word ReadWord(void* address) {
+	return EngineReadWord<_Engine, _Profiled>(&_Engine::GetThreadEngine(), address);
+}
+
+template<class _Engine, bool _Profiled>
+void WriteWord(void* address, Word data, Word mask) {
+	EngineWriteWord<_Engine, _Profiled>(&_Engine::GetThreadEngine(), address, data, mask);
+}
+
+template<class _Engine>
+constexpr Dispatch MakeDispatch(Algorithm algorithm, bool profiled) {
+	return Dispatch{
+		algorithm,
+		IsReadWriteCompatible<_Engine>,
+		IsReadOnlyCompatible<_Engine>,
+		BeginReadWrite<_Engine>,
+		BeginReadOnly<_Engine>,
+		BeginElastic<_Engine>,
+		BeginSnapshot<_Engine>,
+		Commit<_Engine>,
+		End<_Engine>,
+		profiled ? ReadWord<_Engine, true> : ReadWord<_Engine, false>,
+		profiled ? WriteWord<_Engine, true> : WriteWord<_Engine, false>,
+		Release<_Engine>,
+		GetEngine<_Engine>,
+		profiled ? EngineReadWord<_Engine, true> : EngineReadWord<_Engine, false>,
+		profiled ? EngineWriteWord<_Engine, true> : EngineWriteWord<_Engine, false>,
+	};
+}
+
+// Indexed by Algorithm
+const Dispatch dispatch_tables[kNumAlgorithms]{
+	MakeDispatch<TransactionEngine>(Algorithm::LOCK_TABLE, false),
+	MakeDispatch<RingEngine>(Algorithm::RING, false),
+	MakeDispatch<SeqLockEngine>(Algorithm::SEQ_LOCK, false),
+	MakeDispatch<SerialEngine>(Algorithm::SERIAL, false),
+};
+
+const Dispatch profiled_dispatch_tables[kNumAlgorithms]{
+	MakeDispatch<TransactionEngine>(Algorithm::LOCK_TABLE, true),
+	MakeDispatch<RingEngine>(Algorithm::RING, true),
+	MakeDispatch<SeqLockEngine>(Algorithm::SEQ_LOCK, true),
+	MakeDispatch<SerialEngine>(Algorithm::SERIAL, true),
+};
+
+const Dispatch* GetTable(Algorithm algorithm, bool profiled) {
+	const Dispatch* tables{ profiled ? profiled_dispatch_tables : dispatch_tables };
+	return &tables[static_cast<size_t>(algorithm)];
+}
+
+/**
+ * Runs func once no transaction is running. Returns false if another thread is already doing so.
+ * Automatic operations give up instead while a detached transaction is running, its coroutine may
+ * only be resumed by a thread that would otherwise wait for the operation forever.
+ */
+template<class _Fn>
+bool TryRunQuiesced(_Fn&& func, bool automatic) {
+	bool expected{ false };
+	if (!switching.compare_exchange_strong(expected, true)) {
+		return false;
+	}
+
+	// Engines registered after the bound has been read see switching once they enter
+	const size_t bound{ thread_id_bound.load() };
+	for (size_t id{ 0 }; id < bound; id++) {
+		while (start_versions[id].version.load() != kNotRunning) {
+			if (automatic && (detached_running.load() != 0u)) {
+				switching.store(false);
+				return false;
+			}
+			std::this_thread::yield();
+		}
+	}
+
+	func();
+	switching.store(false);
+	return true;
+}
+
+// Performs a requested rollover or remapping. Both stay pending while detached transactions are running.
+void RunRequests() {
+	if (detached_running.load(std::memory_order_relaxed) != 0u) {
+		return;
+	}
+
+	if (IsRolloverRequested()) {
+		// Either this thread performs the rollover or it waits for the thread that does in EnterActivity
+		TryRunQuiesced(Rollover, true);
+	}
+
+	if (IsRemapRequested()) {
+		// Hot stripes are split up the same way, new transactions see the new mapping right away
+		TryRunQuiesced(RemapHotStripes, true);
+	}
+}
+
+/**
+ * Publishes the start version of a new transaction in start. Performs a pending rollover or
+ * remapping first and blocks while the active algorithm is being switched.
+ */
+void EnterActivity(std::atomic<uint64_t>& start) {
+	if (IsRolloverRequested() || IsRemapRequested()) {
+		RunRequests();
+	}
+
+	while (true) {
+		// The one fence of every begin orders the start before the check of switching and the reads
+		// of the transaction. Either a quiescent operation or privatization fence sees the start, or
+		// this transaction sees the operation and everything committed before the fence was called.
+		start.store(privatization_clock.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!switching.load(std::memory_order_acquire)) {
+			break;
+		}
+
+		start.store(kNotRunning, std::memory_order_relaxed);
+		while (switching.load()) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+// Forgets the locations accessed by the previous attempt of detached
+void ResetDetachedAttempt(DetachedTransaction& detached) {
+	if (detached.writes != 0u) {
+		std::fill(std::begin(detached.written), std::end(detached.written), 0u);
+		detached.writes = 0u;
+	}
+	detached.reads.clear();
+	detached.retry_requested = false;
+}
+
+// Marks detached as no longer running after its transaction has terminated
+void LeaveDetached(DetachedTransaction& detached) {
+	start_versions[detached.engine.GetId()].version.store(kNotRunning, std::memory_order_release);
+	detached.active = false;
+	detached_running.fetch_sub(1u, std::memory_order_relaxed);
+}
+
+/**
+ * Replaces the active table once no transaction is running. Returns false if another switch is in
+ * progress, or if an automatic switch gave up because of a running detached transaction.
+ */
+bool TrySwitch(const Dispatch* table, bool automatic) {
+	return TryRunQuiesced([table]() {
+		active_dispatch.store(table, std::memory_order_relaxed);
+	}, automatic);
+}
+
+// Runs func once no transaction is running. Waits for other threads doing the same.
+template<class _Fn>
+void RunQuiesced(_Fn&& func) {
+	if (thread_state.active) {
+		throw TransactionError{ "Cannot wait for all transactions to finish inside a transaction", false };
+	}
+
+	while (!TryRunQuiesced(func, false)) {
+		std::this_thread::yield();
+	}
+}
+
+// Adds the statistics of this thread to the current window and reevaluates the algorithm once it is full
+void PublishStats() {
+	AlgorithmStats& stats{ thread_state.stats };
+	window_commits.fetch_add(stats.commits, std::memory_order_relaxed);
+	window_aborts.fetch_add(stats.aborts, std::memory_order_relaxed);
+	window_reads.fetch_add(stats.reads, std::memory_order_relaxed);
+	window_writes.fetch_add(stats.writes, std::memory_order_relaxed);
+
+	const uint64_t count{ thread_state.pending };
+	stats = AlgorithmStats{};
+	thread_state.pending = 0u;
+
+	const uint64_t old_count{ window_count.fetch_add(count) };
+	if ((old_count / kStatsWindow) == ((old_count + count) / kStatsWindow)) {
+		return;
+	}
+
+	AlgorithmStats window;
+	window.commits = window_commits.exchange(0u, std::memory_order_relaxed);
+	window.aborts = window_aborts.exchange(0u, std::memory_order_relaxed);
+	window.reads = window_reads.exchange(0u, std::memory_order_relaxed);
+	window.writes = window_writes.exchange(0u, std::memory_order_relaxed);
+
+	// Only the thread that completed the window gets here. Concurrent evaluations of later windows
+	// may interleave, the hold counters only need to be roughly right.
+	const Algorithm current{ GetDispatch().algorithm };
+	if (current == Algorithm::SERIAL) {
+		// Never decremented below zero by concurrent evaluations
+		uint32_t remaining{ serial_remaining.load(std::memory_order_relaxed) };
+		while ((remaining > 0u) && !serial_remaining.compare_exchange_weak(remaining, remaining - 1u, std::memory_order_relaxed)) {
+		}
+		if (remaining > 0u) {
+			return;
+		}
+	}
+
+	Algorithm next{ SelectAlgorithm(window) };
+	if (next == Algorithm::SERIAL) {
+		// Serial mode hides conflicts. Stay longer every time it is selected again right after leaving it.
+		if (current != Algorithm::SERIAL) {
+			const uint32_t hold{ serial_hold.load(std::memory_order_relaxed) };
+			serial_remaining.store(hold, std::memory_order_relaxed);
+			serial_hold.store(hold < 64u ? hold * 2u : hold, std::memory_order_relaxed);
+		}
+	} else if (current != Algorithm::SERIAL) {
+		serial_hold.store(1u, std::memory_order_relaxed);
+	}
+
+	if (next != current && adaptive.load(std::memory_order_relaxed)) {
+		TrySwitch(GetTable(next, true), true);
+	}
+}
+
+// Undoes the side effects of the aborted attempt of this thread. The thread is still inside the transaction.
+void RollBackAttempt() {
+	thread_state.stats.aborts++;
+	ReleasePrivateWrites(false);
+	ReleaseCaptured(false);
+	RunActions(false);
+}
+
+// Leaves the transaction after it has called Retry so quiescent operations can proceed while it waits
+void LeaveForRetry() {
+	GetDispatch().end();
+	GetStartVersion().store(kNotRunning, std::memory_order_release);
+	thread_state.active = false;
+
+	WaitForRetry();
+}
+
+} // namespace
+
+std::atomic<const Dispatch*> active_dispatch{ &dispatch_tables[0] };
+
+Algorithm SelectAlgorithm(const AlgorithmStats& stats) {
+	const uint64_t attempts{ stats.commits + stats.aborts };
+	if (attempts == 0u) {
+		return Algorithm::LOCK_TABLE;
+	}
+
+	const double abort_rate{ static_cast<double>(stats.aborts) / static_cast<double>(attempts) };
+	const double reads{ static_cast<double>(stats.reads) / static_cast<double>(attempts) };
+	const double writes{ static_cast<double>(stats.writes) / static_cast<double>(attempts) };
+
+	if (abort_rate > kSerialAbortRate && writes >= kSerialWrites) {
+		return Algorithm::SERIAL;
+	}
+
+	if (writes < kReadMostlyWrites) {
+		return reads >= kLargeReads ? Algorithm::RING : Algorithm::SEQ_LOCK;
+	}
+
+	return Algorithm::LOCK_TABLE;
+}
+
+void OnTransactionBegin(bool read_only) {
+	if (thread_state.active) {
+		// Restart after an abort
+		RollBackAttempt();
+
+		if (!thread_state.retry_requested) {
+			ResetAttempt();
+			PublishRestart(GetStartVersion());
+			return;
+		}
+		LeaveForRetry();
+	}
+
+	EnterActivity(GetStartVersion());
+	thread_state.active = true;
+	thread_state.read_only = read_only;
+	ResetAttempt();
+}
+
+void OnTransactionEnd(bool committed) {
+	// The write back has finished so fences and quiescent operations can stop waiting for this transaction
+	GetStartVersion().store(kNotRunning, std::memory_order_release);
+
+	thread_state.active = false;
+	thread_state.write_trap = false;
+	thread_state.trapped = false;
+	thread_state.timestamp_writes = 0u;
+
+	ReleasePrivateWrites(committed);
+	ReleaseCaptured(committed);
+
+	if (committed) {
+		thread_state.stats.commits++;
+		thread_state.backoff = 0u;
+		if (thread_state.writes != 0u) {
+			WakeWaiters(thread_state.written);
+		}
+	}
+
+	thread_state.retry_requested = false;
+	if (thread_state.track_reads) {
+		thread_state.track_reads = false;
+		retry_reads.clear();
+	}
+
+	if (adaptive.load(std::memory_order_relaxed) && (++thread_state.pending >= kStatsSampleInterval)) {
+		PublishStats();
+	}
+
+	if (committed && !thread_state.read_only && auto_privatization.load(std::memory_order_relaxed)) {
+		PrivatizationFence();
+	}
+
+	RunActions(committed);
+
+	// Inside a deferral the caller may still hold locks the resumed coroutines need
+	if ((thread_state.num_resumes != 0u) && (thread_state.defer_depth == 0u)) {
+		ResumeDetachedWaiters();
+	}
+}
+
+void BeginDeferral() {
+	thread_state.defer_depth++;
+}
+
+void EndDeferral() noexcept {
+	if (--thread_state.defer_depth != 0u) {
+		return;
+	}
+
+	if (!deferred_actions.empty()) {
+		// Actions may commit transactions that defer actions themselves
+		std::vector<DeferredAction> actions{ std::move(deferred_actions) };
+		deferred_actions.clear();
+		for (DeferredAction& action : actions) {
+			action();
+		}
+
+		actions.clear();
+		if (deferred_actions.empty()) {
+			deferred_actions = std::move(actions);
+		}
+	}
+
+	if (thread_state.num_resumes != 0u) {
+		ResumeDetachedWaiters();
+	}
+}
+
+void AbortAttempt() {
+	if (thread_state.active && thread_state.retry_requested) {
+		// Waits like a restart would and keeps recording the reads for the next attempt
+		RollBackAttempt();
+		LeaveForRetry();
+		return;
+	}
+
+	if (thread_state.active) {
+		thread_state.stats.aborts++;
+		GetDispatch().end();
+		OnTransactionEnd(false);
+	}
+
+	// The engines start over with the next transaction, so the backoff is kept here instead
+	Backoff(thread_state.backoff, backoff_rng);
+}
+
+void PushCommitAction(DeferredAction&& action) {
+	if (!thread_state.active) {
+		throw TransactionError{ "Commit actions can only be registered within a transaction", false };
+	}
+	commit_actions.emplace_back(std::move(action));
+	thread_state.num_actions++;
+}
+
+void PushAbortAction(DeferredAction&& action) {
+	if (!thread_state.active) {
+		throw TransactionError{ "Abort actions can only be registered within a transaction", false };
+	}
+	abort_actions.emplace_back(std::move(action));
+	thread_state.num_actions++;
+}
+
+bool TakeRetryRequest() {
+	const bool requested{ thread_state.retry_requested };
+	thread_state.retry_requested = false;
+	return requested;
+}
+
+void TrapWrite() {
+	if (thread_state.write_trap) {
+		thread_state.trapped = true;
+		throw TransactionError{ "Write in a transaction started read-only", true };
+	}
+}
+
+void SetWriteTrap(bool enabled) {
+	thread_state.write_trap = enabled;
+}
+
+bool TakeTrappedWrite() {
+	const bool trapped{ thread_state.trapped };
+	thread_state.trapped = false;
+	return trapped;
+}
+
+size_t GetAttemptWrites() {
+	return thread_state.writes;
+}
+
+void SetTimestampWrites(size_t writes) {
+	thread_state.timestamp_writes = writes;
+}
+
+size_t GetTimestampWrites() {
+	return thread_state.timestamp_writes;
+}
+
+void PrivatizationFence() {
+	if (thread_state.active) {
+		throw TransactionError{ "Cannot wait for other transactions inside a transaction", false };
+	}
+
+	// Transactions that start from here on get a larger start version
+	const uint64_t fence{ privatization_clock.fetch_add(1u) };
+
+	const size_t bound{ GetThreadIdBound() };
+	for (size_t id{ 0 }; id < bound; id++) {
+		const std::atomic<uint64_t>& start{ start_versions[id].version };
+		uint64_t version{ start.load(std::memory_order_acquire) };
+		while ((version != kNotRunning) && (version <= fence)) {
+			std::this_thread::yield();
+			version = start.load(std::memory_order_acquire);
+		}
+	}
+}
+
+bool IsCaptured(const void* address) {
+	return InCapturedRange(address);
+}
+
+DetachedTransaction* CreateDetached() {
+	{
+		std::lock_guard<std::mutex> lock{ detached_mutex };
+		if (!detached_pool.empty()) {
+			DetachedTransaction* detached{ detached_pool.back() };
+			detached_pool.pop_back();
+			return detached;
+		}
+	}
+
+	DetachedTransaction* detached{ new DetachedTransaction() };
+	detached->engine.Init();
+	return detached;
+}
+
+void DestroyDetached(DetachedTransaction* detached) noexcept {
+	EndDetached(*detached);
+
+	std::lock_guard<std::mutex> lock{ detached_mutex };
+	detached_pool.push_back(detached);
+}
+
+void BeginDetached(DetachedTransaction& detached) {
+	if (detached.active) {
+		// Restart after an abort
+		ResetDetachedAttempt(detached);
+		PublishRestart(start_versions[detached.engine.GetId()].version);
+		detached.engine.BeginReadWrite();
+		return;
+	}
+
+	if (thread_state.active) {
+		throw TransactionError{ "Coroutine transactions can not be started inside a transaction", false };
+	}
+
+	std::atomic<uint64_t>& start{ start_versions[detached.engine.GetId()].version };
+	EnterActivity(start);
+
+	// The engines of the other algorithms are bound to their threads
+	if (GetDispatch().algorithm != Algorithm::LOCK_TABLE) {
+		start.store(kNotRunning, std::memory_order_release);
+		throw TransactionError{ "Coroutine transactions require the lock table algorithm", false };
+	}
+
+	// Counted only once the start is published, automatic operations already waiting on it then give up
+	detached_running.fetch_add(1u);
+	detached.active = true;
+	ResetDetachedAttempt(detached);
+	detached.engine.BeginReadWrite();
+}
+
+void CommitDetached(DetachedTransaction& detached) {
+	detached.engine.Commit();
+	LeaveDetached(detached);
+
+	if (detached.writes != 0u) {
+		WakeWaiters(detached.written);
+		if (auto_privatization.load(std::memory_order_relaxed)) {
+			PrivatizationFence();
+		}
+	}
+
+	if ((thread_state.num_resumes != 0u) && (thread_state.defer_depth == 0u)) {
+		ResumeDetachedWaiters();
+	}
+}
+
+void EndDetached(DetachedTransaction& detached) noexcept {
+	if (detached.active) {
+		detached.engine.End();
+		LeaveDetached(detached);
+	}
+}
+
+Word DetachedReadWord(DetachedTransaction& detached, void* address) {
+	const Word data{ detached.engine.ReadWord(address) };
+	if (!TestStripe(detached.written, GetWaitStripe(address))) {
+		detached.reads.push_back(RetryRead{ address, data });
+	}
+	return data;
+}
+
+void DetachedWriteWord(DetachedTransaction& detached, void* address, Word data, Word mask) {
+	SetStripe(detached.written, GetWaitStripe(address));
+	detached.writes++;
+	detached.engine.WriteWord(address, data, mask);
+}
+
+void RetryDetached(DetachedTransaction& detached) {
+	detached.retry_requested = true;
+	throw TransactionError{ "Retry", true };
+}
+
+bool TakeDetachedRetryRequest(DetachedTransaction& detached) {
+	const bool requested{ detached.retry_requested };
+	detached.retry_requested = false;
+	return requested;
+}
+
+bool SuspendDetached(DetachedTransaction& detached, void (*resume)(void* frame), void* frame) {
+	// The transaction leaves while it waits so quiescent operations can proceed
+	EndDetached(detached);
+
+	if (detached.reads.empty()) {
+		// Nothing could ever wake the transaction up, let it poll instead
+		std::this_thread::yield();
+		return false;
+	}
+
+	std::fill(std::begin(detached.stripes), std::end(detached.stripes), 0u);
+	for (const RetryRead& read : detached.reads) {
+		SetStripe(detached.stripes, GetWaitStripe(read.address));
+	}
+	detached.resume = resume;
+	detached.frame = frame;
+	detached.wait_state.store(WaitState::VALIDATING, std::memory_order_relaxed);
+
+	{
+		std::lock_guard<std::mutex> lock{ detached_mutex };
+		detached_waiters.push_back(&detached);
+		num_detached_waiters.fetch_add(1u, std::memory_order_relaxed);
+		AddWaiter(detached.stripes);
+	}
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	// Commits that did not see the transaction registered have already written back their data.
+	// Once it is waiting the committing thread that wakes it up owns it.
+	WaitState expected{ WaitState::VALIDATING };
+	if (IsUnchanged(detached.reads) && detached.wait_state.compare_exchange_strong(expected, WaitState::WAITING)) {
+		return true;
+	}
+
+	std::lock_guard<std::mutex> lock{ detached_mutex };
+	detached_waiters.erase(std::find(detached_waiters.begin(), detached_waiters.end(), &detached));
+	num_detached_waiters.fetch_sub(1u, std::memory_order_relaxed);
+	RemoveWaiter(detached.stripes);
+	return false;
+}
+
+void SwitchAlgorithm(Algorithm algorithm) {
+	if (thread_state.active) {
+		throw TransactionError{ "Cannot switch the algorithm inside a transaction", false };
+	}
+
+	const Dispatch* table{ GetTable(algorithm, adaptive.load()) };
+	while (!TrySwitch(table, false)) {
+		std::this_thread::yield();
+	}
+}
+
+} // namespace nlane::transactional::detail
+
+namespace nlane::transactional {
+
+void SetAlgorithm(Algorithm algorithm) {
+	detail::SwitchAlgorithm(algorithm);
+}
+
+Algorithm GetAlgorithm() {
+	return detail::GetDispatch().algorithm;
+}
+
+void SetAdaptive(bool enabled) {
+	detail::adaptive.store(enabled);
+	detail::SwitchAlgorithm(GetAlgorithm());
+}
+
+bool IsAdaptive() {
+	return detail::adaptive.load();
+}
+
+Domain CreateDomain(const char* name, size_t num_locks) {
+	size_t domain{ detail::kMaxDomains };
+	bool exists{ false };
+	detail::RunQuiesced([&]() {
+		exists = detail::FindDomain(name) != detail::kMaxDomains;
+		if (!exists) {
+			domain = detail::AddDomain(name, num_locks);
+		}
+	});
+
+	if (exists) {
+		throw TransactionError{ "A domain with the same name already exists", false };
+	}
+	if (domain == detail::kMaxDomains) {
+		throw TransactionError{ "Too many domains", false };
+	}
+	return static_cast<Domain>(domain);
+}
+
+Domain FindDomain(const char* name) {
+	// Domains are never removed so an existing domain is always found
+	const size_t domain{ detail::FindDomain(name) };
+	if (domain == detail::kMaxDomains) {
+		throw TransactionError{ "Unknown domain", false };
+	}
+	return static_cast<Domain>(domain);
+}
+
+void AssignDomain(Domain domain, const void* address, size_t size) {
+	const size_t begin{ reinterpret_cast<size_t>(address) };
+
+	bool added{ false };
+	detail::RunQuiesced([&]() {
+		if (domain < detail::GetNumDomains()) {
+			added = detail::AddDomainRange(domain, begin, begin + size);
+		}
+	});
+
+	if (!added) {
+		throw TransactionError{ "Failed to assign the range to the domain", false };
+	}
+}
+
+void SetDomainNode(Domain domain, size_t node) {
+	bool found{ false };
+	detail::RunQuiesced([&]() {
+		if (domain < detail::GetNumDomains()) {
+			detail::BindDomainLocks(domain, node);
+			found = true;
+		}
+	});
+
+	if (!found) {
+		throw TransactionError{ "Domain does not exist", false };
+	}
+}
+
+void PrivatizationFence() {
+	detail::PrivatizationFence();
+}
+
+void Retry() {
+	if (!detail::thread_state.active) {
+		throw TransactionError{ "Retry can only be called within a transaction", false };
+	}
+	detail::thread_state.retry_requested = true;
+	throw TransactionError{ "Retry", true };
+}
+
+void SetAutoPrivatization(bool enabled) {
+	detail::auto_privatization.store(enabled);
+}
+
+bool IsAutoPrivatization() {
+	return detail::auto_privatization.load();
+}
+
+void SetContentionRemapping(bool enabled) {
+	detail::RunQuiesced([enabled]() {
+		detail::SetConflictProfiling(enabled);
+		if (!enabled) {
+			detail::ClearHotAddresses();
+		}
+	});
+}
+
+void SetVisibleReaders(const void* address, size_t size) {
+	const size_t begin{ reinterpret_cast<size_t>(address) & ~kWordAlignMask };
+	const size_t end{ reinterpret_cast<size_t>(address) + size };
+
+	bool full{ false };
+	detail::RunQuiesced([&]() {
+		for (size_t addr{ begin }; (addr < end) && !full; addr += sizeof(Word)) {
+			full = !detail::AddVisibleStripe(detail::GetLockIndex(reinterpret_cast<void*>(addr)));
+		}
+	});
+
+	if (full) {
+		throw TransactionError{ "Too many visible stripes", false };
+	}
+}
+
+void ClearVisibleReaders() {
+	detail::RunQuiesced(detail::ClearVisibleStripes);
+}
+
+void RegisterRegion(const void* address, size_t size, RegionKind kind) {
+	const size_t begin{ reinterpret_cast<size_t>(address) };
+	if (((begin | size) & kWordAlignMask) != 0u) {
+		throw TransactionError{ "Regions must consist of whole words", false };
+	}
+
+	bool full{ false };
+	detail::RunQuiesced([&]() {
+		if (detail::num_regions == detail::kMaxRegions) {
+			full = true;
+			return;
+		}
+
+		detail::Region& region{ detail::regions[detail::num_regions] };
+		region.begin = begin;
+		region.end = begin + size;
+		region.kind = kind;
+		region.owner = &detail::thread_state;
+		region.checksum = detail::verify_regions.load() ? detail::Checksum(region.begin, region.end) : 0u;
+		detail::num_regions++;
+	});
+
+	if (full) {
+		throw TransactionError{ "Too many registered regions", false };
+	}
+}
+
+void UnregisterRegion(const void* address) {
+	const size_t begin{ reinterpret_cast<size_t>(address) };
+
+	bool modified{ false };
+	detail::RunQuiesced([&]() {
+		for (size_t i{ 0 }; i < detail::num_regions; i++) {
+			detail::Region& region{ detail::regions[i] };
+			if (region.begin != begin) {
+				continue;
+			}
+
+			if (detail::verify_regions.load() && (region.kind == RegionKind::IMMUTABLE)) {
+				modified = detail::Checksum(region.begin, region.end) != region.checksum;
+			}
+
+			region = detail::regions[--detail::num_regions];
+			return;
+		}
+	});
+
+	if (modified) {
+		throw TransactionError{ "Immutable region has been modified", false };
+	}
+}
+
+void SetRegionVerification(bool enabled) {
+	// Checksums of regions registered before are computed here so they are valid at all times
+	detail::RunQuiesced([enabled]() {
+		if (enabled && !detail::verify_regions.load()) {
+			for (size_t i{ 0 }; i < detail::num_regions; i++) {
+				detail::Region& region{ detail::regions[i] };
+				region.checksum = detail::Checksum(region.begin, region.end);
+			}
+		}
+		detail::verify_regions.store(enabled);
+	});
+}
+
+void* Allocate(size_t size) {
+	// Whole words so accesses to the last word never touch memory of another allocation
+	const size_t words{ (size + kWordAlignMask) / sizeof(Word) };
+	void* memory{ ::operator new(words * sizeof(Word)) };
+
+	if (detail::thread_state.active) {
+		const size_t begin{ reinterpret_cast<size_t>(memory) };
+		detail::captured_ranges.push_back(detail::CapturedRange{ begin, begin + (words * sizeof(Word)) });
+		detail::thread_state.num_captured = detail::captured_ranges.size();
+	}
+	return memory;
+}
+
+void SetResumeExecutor(ResumeExecutor executor) {
+	detail::resume_executor.store(executor, std::memory_order_release);
+}
+
+} // namespace nlane::transactional
@@ -0,0 +1,57 @@
+/**
+ * Copyright 2020 Lorenzo Rai
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <nlane/transactional/ring_engine.hpp>
+
+namespace nlane::transactional::detail {
+
+thread_local RingEngine thread_ring_engine;
+
+RingEntry global_ring[kRingSize];
+
+alignas(64) std::atomic<Version> global_ring_index{ 0u };
+
+RingEntry* GetCommitRing() {
+	return global_ring;
+}
+
+std::atomic<Version>& GetRingIndex() {
+	return global_ring_index;
+}
+
+RingEngine::RingEngine() {
+}
+
+RingEngine::~RingEngine() {
+}
+
+size_t RingEngine::GetAllocatedBytes() const {
+	return write_data_.GetAllocatedBytes();
+}
+
+void RingEngine::Init() {
+	if(state_ != State::UNINITIALIZED) {
+		return;
+	}
+
+	ring_ = GetCommitRing();
+
+	// The log is allocated once it is first written to
+	rng_ = CreateEngineRng();
+
+	state_ = State::INITIALIZED;
+}
+}
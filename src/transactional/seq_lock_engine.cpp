@@ -0,0 +1,49 @@
+/**
+ * Copyright 2020 Lorenzo Rai
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <nlane/transactional/seq_lock_engine.hpp>
+
+namespace nlane::transactional::detail {
+
+thread_local SeqLockEngine thread_seq_lock_engine;
+
+alignas(64) std::atomic<Version> global_sequence_lock{ 0u };
+
+std::atomic<Version>& GetSequenceLock() {
+	return global_sequence_lock;
+}
+
+SeqLockEngine::SeqLockEngine() {
+}
+
+SeqLockEngine::~SeqLockEngine() {
+}
+
+size_t SeqLockEngine::GetAllocatedBytes() const {
+	return read_log_.GetAllocatedBytes() + write_data_.GetAllocatedBytes();
+}
+
+void SeqLockEngine::Init() {
+	if(state_ != State::UNINITIALIZED) {
+		return;
+	}
+
+	// The logs are allocated once they are first written to
+	rng_ = CreateEngineRng();
+
+	state_ = State::INITIALIZED;
+}
+}
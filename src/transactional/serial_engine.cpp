@@ -0,0 +1,46 @@
+/**
+ * Copyright 2020 Lorenzo Rai
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <nlane/transactional/serial_engine.hpp>
+
+namespace nlane::transactional::detail {
+
+thread_local SerialEngine thread_serial_engine;
+
+std::mutex serial_mutex;
+
+std::mutex& GetSerialMutex() {
+	return serial_mutex;
+}
+
+SerialEngine::SerialEngine() {
+}
+
+SerialEngine::~SerialEngine() {
+}
+
+size_t SerialEngine::GetAllocatedBytes() const {
+	return log_.GetAllocatedBytes();
+}
+
+void SerialEngine::Init() {
+	if(state_ != State::UNINITIALIZED) {
+		return;
+	}
+
+	state_ = State::INITIALIZED;
+}
+}
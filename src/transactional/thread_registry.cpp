@@ -0,0 +1,78 @@
+/**
+ * Copyright 2020 Lorenzo Rai
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdexcept>
+#include <thread>
+
+#include <nlane/transactional/thread_registry.hpp>
+
+namespace nlane::transactional::detail {
+
+namespace {
+
+constexpr size_t kBitmapWords{ kMaxThreads / 64u };
+
+// A set bit marks a used id. Id 0 is always marked as used.
+std::atomic<uint64_t> used_ids[kBitmapWords]{ { 1u } };
+
+std::atomic<size_t> num_registered{ 0u };
+
+} // namespace
+
+std::atomic<void*> registered_engines[kMaxThreads]{};
+
+std::atomic<uint32_t> engine_pins[kMaxThreads]{};
+
+std::atomic<size_t> thread_id_bound{ 1u };
+
+ThreadId RegisterThread(void* engine) {
+	for (size_t i{ 0 }; i < kBitmapWords; i++) {
+		uint64_t used{ used_ids[i].load() };
+		while (used != ~static_cast<uint64_t>(0u)) {
+			const uint64_t bit{ ~used & (used + 1u) };
+			if (used_ids[i].compare_exchange_weak(used, used | bit)) {
+				const ThreadId id{ static_cast<ThreadId>((i * 64u) + __builtin_ctzll(bit)) };
+				registered_engines[id].store(engine, std::memory_order_release);
+
+				size_t bound{ thread_id_bound.load() };
+				while ((bound <= id) && !thread_id_bound.compare_exchange_weak(bound, id + 1u)) {
+				}
+				num_registered.fetch_add(1u, std::memory_order_relaxed);
+				return id;
+			}
+		}
+	}
+
+	throw std::runtime_error{ "Too many threads" };
+}
+
+void UnregisterThread(ThreadId id) {
+	registered_engines[id].store(nullptr);
+
+	// Pins taken before the engine was unregistered may still reference it
+	while (engine_pins[id].load(std::memory_order_acquire) != 0u) {
+		std::this_thread::yield();
+	}
+
+	used_ids[id / 64u].fetch_and(~(static_cast<uint64_t>(1u) << (id % 64u)));
+	num_registered.fetch_sub(1u, std::memory_order_relaxed);
+}
+
+size_t GetNumRegisteredThreads() {
+	return num_registered.load(std::memory_order_relaxed);
+}
+
+} // namespace nlane::transactional::detail
@@ -20,39 +20,49 @@
 
 namespace nlane::transactional::detail {
 
+// Only the configuration selected for this build is instantiated
+template class BasicTransactionEngine<TransactionEngine::Clock, TransactionEngine::Locks, TransactionEngine::Locking, TransactionEngine::Log, TransactionEngine::Cm>;
+
 thread_local TransactionEngine thread_engine;
 
 
 std::once_flag init_flag;
 
-TransactionEngine::TransactionEngine() {
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::BasicTransactionEngine() {
 	std::call_once(init_flag, InitSupport);
 }
 
-TransactionEngine::~TransactionEngine() {
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::~BasicTransactionEngine() {
+	if(id_ != kNoThread) {
+		UnregisterThread(id_);
+	}
+	if(meta_ != nullptr) {
+		ReleaseStorage(meta_, sizeof(Metadata));
+	}
 }
 
-void TransactionEngine::Init() {
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+size_t BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::GetAllocatedBytes() const {
+	const size_t meta_bytes{ meta_ != nullptr ? sizeof(Metadata) : 0u };
+	return meta_bytes + read_set_.GetAllocatedBytes() + write_set_.GetAllocatedBytes() + log_.GetAllocatedBytes();
+}
+
+template<class _Clock, class _Locks, class _Locking, class _Log, class _Cm>
+void BasicTransactionEngine<_Clock, _Locks, _Locking, _Log, _Cm>::Init() {
 	if(state_ != State::UNINITIALIZED) {
 		// TODO add error log once logging system is added
 		return;
 	}
 
-	lock_table_ = GetLockTable();
-
-	read_set_.Init();
-	write_set_.Init();
-	write_data_.Init();
+	lock_table_ = _Locks::GetTable();
+	meta_ = new (AcquireStorage(sizeof(Metadata))) Metadata{};
+	id_ = RegisterThread(this);
 
-	// Generate different states for each rng
-	static std::atomic<uint32_t> curr_offset{ 0 };
+	// The sets and the log are allocated once they are first written to
+	rng_ = CreateEngineRng();
 
-	uint32_t nr{ curr_offset.fetch_add(1u) };
-	nr &= (0xFFu); // To prevent long looping during initialization if many threads have been created
-	for(uint32_t i{ 0 }; i < nr; i++) {
-		rng_.Jump();
-	}
-	
 	state_ = State::INITIALIZED;
 }
 }
\ No newline at end of file
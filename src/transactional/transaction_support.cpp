@@ -15,24 +15,66 @@
  */
 
 #include <atomic>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
 
 #include <nlane/transactional/transaction_support.hpp>
+#include <nlane/util/numa.hpp>
 
 namespace nlane::transactional::detail {
-std::atomic<Version> global_version{ 0 };
+DomainClock domain_clocks[kMaxDomains];
+DomainLayout domain_layouts[kMaxDomains]{ { 0u, kLockTableMask } };
+DomainRange domain_ranges[kMaxDomainRanges];
+size_t num_domains{ 1u };
+size_t num_domain_ranges{ 0u };
 
-Version GetGlobalVersion() {
-	return global_version.load();
+std::string domain_names[kMaxDomains]{ "default" };
+
+ReaderIndicator reader_indicators[kMaxVisibleStripes];
+VisibleStripe visible_stripes[kVisibleTableSize];
+size_t num_visible_stripes{ 0u };
+
+HotAddress hot_addresses[kHotTableSize];
+size_t num_hot_addresses{ 0u };
+
+std::atomic<bool> conflict_profiling{ true };
+std::atomic<bool> remap_requested{ false };
+std::atomic<uint64_t> profiled_conflicts{ 0u };
+
+// Indexed by the lock index of the stripe. Pages are only touched once stripes conflict.
+StripeProfile stripe_profiles[kLockTableSize];
+
+std::atomic<Version> max_version{ kMaxVersion };
+std::atomic<uint64_t> version_epoch{ 0u };
+std::atomic<bool> rollover_requested{ false };
+
+std::atomic<void (*)()> write_back_hook{ nullptr };
+
+Version GetMaxVersion() {
+	return max_version.load();
+}
+
+void SetWriteBackHook(void (*hook)()) {
+	write_back_hook.store(hook);
+}
+
+void SetMaxVersion(Version version) {
+	if (version > kMaxVersion) {
+		throw std::invalid_argument{ "Maximum version must be at most kMaxVersion" };
+	}
+	max_version.store(version);
 }
 
-Version GetIncGlobalVersion() {
-	return global_version.fetch_add(1u) + 1u;
+uint64_t GetVersionEpoch() {
+	return version_epoch.load();
 }
 
 std::atomic<Version> greedy_version{ 0 };
 
 Version GetIncGreedyVersion() {
-	return greedy_version.fetch_add(1u);
+	return greedy_version.fetch_add(1u, std::memory_order_relaxed);
 }
 
 LockEntry* global_lock_table{ nullptr };
@@ -41,11 +83,249 @@ LockEntry* GetLockTable() {
 	return global_lock_table;
 }
 
+VersionedLock* global_versioned_lock_table{ nullptr };
+
+VersionedLock* GetVersionedLockTable() {
+	return global_versioned_lock_table;
+}
+
+size_t AddDomain(const char* name, size_t num_locks) {
+	if (num_domains == kMaxDomains) {
+		return kMaxDomains;
+	}
+
+	size_t size{ 64u };
+	while ((size < num_locks) && (size < kMaxDomainLocks)) {
+		size <<= 1u;
+	}
+
+	const size_t domain{ num_domains++ };
+	domain_layouts[domain] = DomainLayout{ 3u, size - 1u };
+	domain_names[domain] = name;
+	domain_clocks[domain].version.store(0u);
+	return domain;
+}
+
+size_t FindDomain(const char* name) {
+	for (size_t i{ 0 }; i < num_domains; i++) {
+		if (domain_names[i] == name) {
+			return i;
+		}
+	}
+	return kMaxDomains;
+}
+
+bool AddDomainRange(size_t domain, size_t begin, size_t end) {
+	if (num_domain_ranges == kMaxDomainRanges) {
+		return false;
+	}
+
+	domain_ranges[num_domain_ranges++] = DomainRange{ begin, end, domain };
+	return true;
+}
+
+void BindDomainLocks(size_t domain, size_t node) {
+	const size_t base{ domain << kDomainShift };
+	util::BindToNode(global_lock_table + base, kMaxDomainLocks * sizeof(LockEntry), node);
+	util::BindToNode(global_versioned_lock_table + base, kMaxDomainLocks * sizeof(VersionedLock), node);
+}
+
+bool AddVisibleStripe(LockIndex index) {
+	VisibleStripe& stripe{ visible_stripes[GetVisibleSlot(index + 1u)] };
+	if (stripe.key != 0u) {
+		return true;
+	}
+	if (num_visible_stripes == kMaxVisibleStripes) {
+		return false;
+	}
+
+	// No transaction is running so every indicator is back at 0
+	stripe.key = index + 1u;
+	stripe.indicator = &reader_indicators[num_visible_stripes++];
+	return true;
+}
+
+void ClearVisibleStripes() {
+	for (VisibleStripe& stripe : visible_stripes) {
+		stripe = VisibleStripe{};
+	}
+	num_visible_stripes = 0u;
+}
+
+void SetConflictProfiling(bool enabled) {
+	conflict_profiling.store(enabled);
+}
+
+void RecordConflict(LockIndex index, const void* address) {
+	if (index >= kLockTableSize) {
+		// Other domains map every word to its own lock and dedicated locks have a single address
+		return;
+	}
+
+	StripeProfile& profile{ stripe_profiles[index] };
+	profile.conflicts.fetch_add(1u, std::memory_order_relaxed);
+
+	const size_t word{ reinterpret_cast<size_t>(address) & ~kWordAlignMask };
+	for (size_t i{ 0 }; i < kProfileCandidates; i++) {
+		size_t candidate{ profile.addresses[i].load(std::memory_order_relaxed) };
+		if ((candidate == 0u) && profile.addresses[i].compare_exchange_strong(candidate, word, std::memory_order_relaxed)) {
+			candidate = word;
+		}
+
+		if (candidate == word) {
+			profile.counts[i].fetch_add(1u, std::memory_order_relaxed);
+			break;
+		}
+	}
+
+	const uint64_t count{ profiled_conflicts.fetch_add(1u, std::memory_order_relaxed) + 1u };
+	if ((count % kConflictWindow) == 0u) {
+		remap_requested.store(true, std::memory_order_relaxed);
+	}
+}
+
+size_t RemapHotStripes() {
+	remap_requested.store(false);
+
+	size_t remapped{ 0u };
+	for (StripeProfile& profile : stripe_profiles) {
+		if (profile.conflicts.load(std::memory_order_relaxed) == 0u) {
+			continue;
+		}
+
+		if (profile.conflicts.load(std::memory_order_relaxed) >= kHotStripeConflicts) {
+			size_t num_addresses{ 0u };
+			size_t hottest{ 0u };
+			for (size_t i{ 0 }; i < kProfileCandidates; i++) {
+				if (profile.addresses[i].load(std::memory_order_relaxed) == 0u) {
+					continue;
+				}
+
+				num_addresses++;
+				if (profile.counts[i].load(std::memory_order_relaxed) > profile.counts[hottest].load(std::memory_order_relaxed)) {
+					hottest = i;
+				}
+			}
+
+			// A stripe whose conflicts all stem from the same word is contended for real
+			if ((num_addresses > 1u) && AddHotAddress(reinterpret_cast<void*>(profile.addresses[hottest].load(std::memory_order_relaxed)))) {
+				remapped++;
+			}
+		}
+
+		profile.conflicts.store(0u, std::memory_order_relaxed);
+		for (size_t i{ 0 }; i < kProfileCandidates; i++) {
+			profile.counts[i].store(0u, std::memory_order_relaxed);
+			profile.addresses[i].store(0u, std::memory_order_relaxed);
+		}
+	}
+	return remapped;
+}
+
+bool AddHotAddress(const void* address) {
+	const size_t word{ reinterpret_cast<size_t>(address) & ~kWordAlignMask };
+	if ((num_hot_addresses == kMaxHotAddresses) || (word == 0u)) {
+		return false;
+	}
+
+	HotAddress& hot{ hot_addresses[GetHotSlot(word)] };
+	if (hot.address == word) {
+		return false;
+	}
+
+	// Dedicated locks are not in use while they are unassigned so their versions are still valid
+	hot.address = word;
+	hot.index = kLockTableSize + num_hot_addresses;
+	num_hot_addresses++;
+	return true;
+}
+
+void ClearHotAddresses() {
+	for (HotAddress& hot : hot_addresses) {
+		hot = HotAddress{};
+	}
+	num_hot_addresses = 0u;
+}
+
+// Storage of destroyed engines. Threads are created and destroyed often by some applications.
+struct PooledStorage {
+	void* storage;
+	size_t size;
+	size_t node;
+};
+
+std::mutex storage_mutex;
+PooledStorage pooled_storage[kMaxPooledStorage];
+size_t num_pooled_storage{ 0u };
+size_t pooled_storage_bytes{ 0u };
+
+void* AcquireStorage(size_t size) {
+	const size_t node{ util::GetCurrentNode() };
+	{
+		std::lock_guard<std::mutex> lock{ storage_mutex };
+		for (size_t i{ 0 }; i < num_pooled_storage; i++) {
+			PooledStorage& pooled{ pooled_storage[i] };
+			if ((pooled.size == size) && (pooled.node == node)) {
+				void* storage{ pooled.storage };
+				pooled_storage_bytes -= size;
+				pooled = pooled_storage[--num_pooled_storage];
+				return storage;
+			}
+		}
+	}
+	return util::AllocateOnNode(size, node);
+}
+
+void ReleaseStorage(void* storage, size_t size) {
+	{
+		std::lock_guard<std::mutex> lock{ storage_mutex };
+		if (num_pooled_storage < kMaxPooledStorage) {
+			pooled_storage[num_pooled_storage++] = PooledStorage{ storage, size, util::GetCurrentNode() };
+			pooled_storage_bytes += size;
+			return;
+		}
+	}
+	util::Free(storage, size);
+}
+
+size_t GetPooledStorage() {
+	std::lock_guard<std::mutex> lock{ storage_mutex };
+	return pooled_storage_bytes;
+}
+
+void Rollover() {
+	if (!rollover_requested.load() || (global_lock_table == nullptr)) {
+		return;
+	}
+
+	for (size_t domain{ 0 }; domain < num_domains; domain++) {
+		const size_t base{ domain << kDomainShift };
+		for (size_t i{ 0 }; i <= domain_layouts[domain].mask; i++) {
+			global_lock_table[base + i].r_lock.Unlock(0u);
+			global_versioned_lock_table[base + i].Unlock(0u);
+		}
+		domain_clocks[domain].version.store(0u);
+	}
+
+	// Dedicated locks belong to the default domain
+	for (size_t i{ 0 }; i < kMaxHotAddresses; i++) {
+		global_lock_table[kLockTableSize + i].r_lock.Unlock(0u);
+		global_versioned_lock_table[kLockTableSize + i].Unlock(0u);
+	}
+
+	version_epoch.fetch_add(1u);
+	rollover_requested.store(false);
+}
+
 void InitSupport() {
-	// TODO better allocation?
 	if(global_lock_table != nullptr) {
 		throw std::runtime_error{"This shouldnt happen"};
 	}
-	global_lock_table = new LockEntry[kLockTableSize];
+
+	// Room for every domain is reserved up front so lock indices stay valid. Zeroed memory holds
+	// unlocked locks of version 0 and the pages of unused domains are never touched. The tables are
+	// shared by all threads so their pages are interleaved over all nodes unless a domain is bound.
+	global_lock_table = static_cast<LockEntry*>(util::AllocateInterleaved(kMaxDomains * kMaxDomainLocks * sizeof(LockEntry)));
+	global_versioned_lock_table = static_cast<VersionedLock*>(util::AllocateInterleaved(kMaxDomains * kMaxDomainLocks * sizeof(VersionedLock)));
 }
 }
\ No newline at end of file
@@ -14,6 +14,13 @@
  * limitations under the License. 
  */
 
+#include <algorithm>
+#include <cassert>
+
+#include <nlane/transactional/dispatch.hpp>
+#include <nlane/transactional/ring_engine.hpp>
+#include <nlane/transactional/seq_lock_engine.hpp>
+#include <nlane/transactional/serial_engine.hpp>
 #include <nlane/transactional/transaction_engine.hpp>
 #include <nlane/transactional/transaction_support.hpp>
 #include <nlane/transactional/transactional.hpp>
@@ -45,49 +52,256 @@ bool TransactionError::shouldRetry() const noexcept {
 namespace detail {
 
 PromotionState IsReadWriteCompatible() {
-    return TransactionEngine::GetThreadEngine().IsReadWriteCompatible();
+    const PromotionState state{ GetDispatch().is_read_write_compatible() };
+    if (state == PromotionState::INCOMPATIBLE) {
+        // A nested read-write transaction inside a transaction that was only started read-only
+        TrapWrite();
+    }
+    return state;
 }
 
 PromotionState IsReadOnlyCompatible() {
-    return TransactionEngine::GetThreadEngine().IsReadOnlyCompatible();
+    return GetDispatch().is_read_only_compatible();
 }
 
 void BeginReadWrite() {
-    TransactionEngine::GetThreadEngine().BeginReadWrite();
+    OnTransactionBegin(false);
+    GetDispatch().begin_read_write();
 }
 
 void BeginReadOnly() {
-    TransactionEngine::GetThreadEngine().BeginReadOnly();
+    OnTransactionBegin(true);
+    GetDispatch().begin_read_only();
+}
+
+void BeginElastic() {
+    OnTransactionBegin(false);
+    GetDispatch().begin_elastic();
+}
+
+void BeginSnapshot() {
+    OnTransactionBegin(false);
+    GetDispatch().begin_snapshot();
 }
 
 void RestartReadWrite() {
-    TransactionEngine::GetThreadEngine().BeginReadWrite();
+    BeginReadWrite();
 }
 
 void RestartReadOnly() {
-    TransactionEngine::GetThreadEngine().BeginReadOnly();
+    BeginReadOnly();
 }
 
 void Commit() {
-    TransactionEngine::GetThreadEngine().Commit();
+    GetDispatch().commit();
+    OnTransactionEnd(true);
 }
 
 void End() {
-    TransactionEngine::GetThreadEngine().End();
+    GetDispatch().end();
+    OnTransactionEnd(false);
+}
+
+Transaction CurrentTransaction() {
+    const Dispatch& dispatch{ GetDispatch() };
+    return Transaction{ dispatch.get_engine(), dispatch.engine_read_word, dispatch.engine_write_word };
 }
 
 } // namespace detail
 
+Batch::Batch(size_t max_group, bool adaptive) : max_group_{ std::max<size_t>(max_group, 1u) }, group_size_{ max_group_ }, adaptive_{ adaptive } {
+    queue_.reserve(max_group_);
+}
+
+Batch::~Batch() {
+    assert(queue_.empty());
+}
+
+void Batch::RunGroup(size_t first, size_t count) {
+    if (count == 1u) {
+        Atomic([&]() {
+            queue_[first]();
+        });
+    }
+    else {
+        try {
+            detail::BeginReadWrite();
+            for (size_t i{ first }; i < first + count; i++) {
+                queue_[i]();
+            }
+            detail::Commit();
+        }
+        catch (TransactionError& err) {
+            if (!err.shouldRetry()) {
+                detail::End();
+                throw;
+            }
+
+            // Smaller groups only avoid conflicts with the writes of the group itself
+            const bool wrote{ detail::GetAttemptWrites() != 0u };
+
+            // Backs off like a restart before the halves run again
+            detail::AbortAttempt();
+
+            // Only the conflicting half has to abort again
+            const size_t half{ count / 2u };
+            if (adaptive_ && wrote) {
+                group_size_ = std::max<size_t>(std::min(group_size_, count) / 2u, 1u);
+            }
+            RunGroup(first, half);
+            RunGroup(first + half, count - half);
+            return;
+        }
+        catch (...) {
+            detail::End();
+            throw;
+        }
+    }
+
+    if (adaptive_ && (group_size_ < max_group_)) {
+        group_size_++;
+    }
+}
+
+void Batch::Flush() {
+    // Commit actions and woken coroutines run once all groups have finished
+    detail::ActionDeferral deferral;
+
+    size_t first{ 0u };
+    try {
+        while (first < queue_.size()) {
+            const size_t count{ std::min(group_size_, queue_.size() - first) };
+            RunGroup(first, count);
+            first += count;
+        }
+    }
+    catch (...) {
+        queue_.clear();
+        throw;
+    }
+    queue_.clear();
+}
+
+size_t Batch::GetGroupSize() const {
+    return group_size_;
+}
+
+size_t Batch::GetPending() const {
+    return queue_.size();
+}
+
+Site::Site(const char* name) : name_{ name } {
+}
+
+const char* Site::GetName() const {
+    return name_;
+}
+
+uint64_t Site::GetCommits() const {
+    return commits_.load(std::memory_order_relaxed);
+}
+
+uint64_t Site::GetAborts() const {
+    return aborts_.load(std::memory_order_relaxed);
+}
+
+uint64_t Site::GetWrites() const {
+    return writes_.load(std::memory_order_relaxed);
+}
+
+bool Site::IsReadOnly() const {
+    return read_only_.load(std::memory_order_relaxed);
+}
+
+bool Site::IsSerialized() const {
+    return serialized_.load(std::memory_order_relaxed);
+}
+
+size_t Site::GetTimestampWrites() const {
+    return timestamp_writes_.load(std::memory_order_relaxed);
+}
+
+void Site::OnCommit(size_t writes) {
+    if (writes != 0u) {
+        writes_.fetch_add(writes, std::memory_order_relaxed);
+    }
+    if (((commits_.fetch_add(1u, std::memory_order_relaxed) + 1u) % kWindow) == 0u) {
+        Reevaluate();
+    }
+}
+
+void Site::OnAbort() {
+    if (((aborts_.fetch_add(1u, std::memory_order_relaxed) + 1u) % kWindow) == 0u) {
+        Reevaluate();
+    }
+}
+
+void Site::OnUpgrade() {
+    read_only_.store(false, std::memory_order_relaxed);
+}
+
+void Site::Reevaluate() {
+    // Evaluations of the same site are kWindow transactions apart so races only skew one window
+    const uint64_t total_commits{ commits_.load(std::memory_order_relaxed) };
+    const uint64_t total_aborts{ aborts_.load(std::memory_order_relaxed) };
+    const uint64_t total_writes{ writes_.load(std::memory_order_relaxed) };
+    const uint64_t commits{ total_commits - last_commits_.load(std::memory_order_relaxed) };
+    const uint64_t aborts{ total_aborts - last_aborts_.load(std::memory_order_relaxed) };
+    const uint64_t writes{ total_writes - last_writes_.load(std::memory_order_relaxed) };
+    if (commits + aborts < kWindow) {
+        // Commits and aborts trigger evaluations independently, short windows are merged into the next one
+        return;
+    }
+    last_commits_.store(total_commits, std::memory_order_relaxed);
+    last_aborts_.store(total_aborts, std::memory_order_relaxed);
+    last_writes_.store(total_writes, std::memory_order_relaxed);
+
+    read_only_.store((commits != 0u) && (writes == 0u), std::memory_order_relaxed);
+
+    if (aborts > kSerializeAborts * commits) {
+        serialized_.store(true, std::memory_order_relaxed);
+    }
+    else if (aborts <= commits) {
+        serialized_.store(false, std::memory_order_relaxed);
+    }
+
+    if (aborts > commits) {
+        const uint64_t average{ (commits != 0u) ? (writes / commits) : 0u };
+        timestamp_writes_.store(std::clamp<uint64_t>(average / 2u, 1u, detail::GreedyCm::kTimestampWrites), std::memory_order_relaxed);
+    }
+    else {
+        timestamp_writes_.store(0u, std::memory_order_relaxed);
+    }
+}
+
 void ThreadInit() {
     detail::TransactionEngine::GetThreadEngine().Init();
+    detail::RingEngine::GetThreadEngine().Init();
+    detail::SeqLockEngine::GetThreadEngine().Init();
+    detail::SerialEngine::GetThreadEngine().Init();
+}
+
+MemoryFootprint GetMemoryFootprint() {
+    MemoryFootprint footprint{};
+    footprint.engine_bytes = sizeof(detail::TransactionEngine) + sizeof(detail::RingEngine) + sizeof(detail::SeqLockEngine) + sizeof(detail::SerialEngine);
+    footprint.log_bytes = detail::TransactionEngine::GetThreadEngine().GetAllocatedBytes()
+        + detail::RingEngine::GetThreadEngine().GetAllocatedBytes()
+        + detail::SeqLockEngine::GetThreadEngine().GetAllocatedBytes()
+        + detail::SerialEngine::GetThreadEngine().GetAllocatedBytes();
+    footprint.pooled_bytes = detail::GetPooledStorage();
+    return footprint;
 }
 
 Word ReadWord(void* address) {
-	return detail::TransactionEngine::GetThreadEngine().ReadWord(address);
+	return detail::GetDispatch().read_word(address);
 }
 
 void WriteWord(void* address, Word data, Word mask) {
-	detail::TransactionEngine::GetThreadEngine().WriteWord(address, data, mask);
+	detail::GetDispatch().write_word(address, data, mask);
+}
+
+void Release(void* address) {
+	detail::GetDispatch().release(detail::WordAlignedAddress(address));
 }
 
 } // namespace nlane::transactional
@@ -0,0 +1,144 @@
+/**
+ * Copyright 2020 Lorenzo Rai
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software 
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. 
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if defined(NLANE_NUMA)
+#include <numa.h>
+#include <sched.h>
+#endif
+
+#include <nlane/util/numa.hpp>
+
+namespace nlane::util {
+
+namespace {
+
+// Zeroed memory aligned to cache lines, used whenever libnuma is not used
+void* AllocateAligned(size_t size) {
+    const size_t aligned_size{ (size + 63u) & ~static_cast<size_t>(63u) };
+    void* memory{ std::aligned_alloc(64u, aligned_size) };
+    if (memory == nullptr) {
+        throw std::bad_alloc{};
+    }
+    std::memset(memory, 0, aligned_size);
+    return memory;
+}
+
+} // namespace
+
+#if defined(NLANE_NUMA)
+
+namespace {
+
+bool IsAvailable() {
+    static const bool available{ numa_available() >= 0 };
+    return available;
+}
+
+} // namespace
+
+size_t GetNumNodes() {
+    return IsAvailable() ? static_cast<size_t>(numa_max_node() + 1) : 1u;
+}
+
+size_t GetCurrentNode() {
+    if (!IsAvailable()) {
+        return 0u;
+    }
+
+    const int node{ numa_node_of_cpu(sched_getcpu()) };
+    return node < 0 ? 0u : static_cast<size_t>(node);
+}
+
+void* AllocateOnNode(size_t size, size_t node) {
+    if (!IsAvailable()) {
+        return AllocateAligned(size);
+    }
+
+    // Memory from libnuma is page aligned and zeroed by the kernel
+    void* memory{ numa_alloc_onnode(size, static_cast<int>(node)) };
+    if (memory == nullptr) {
+        throw std::bad_alloc{};
+    }
+    return memory;
+}
+
+void* AllocateInterleaved(size_t size) {
+    if (!IsAvailable()) {
+        return AllocateAligned(size);
+    }
+
+    void* memory{ numa_alloc_interleaved(size) };
+    if (memory == nullptr) {
+        throw std::bad_alloc{};
+    }
+    return memory;
+}
+
+void Free(void* memory, size_t size) {
+    if (IsAvailable()) {
+        numa_free(memory, size);
+    } else {
+        std::free(memory);
+    }
+}
+
+void BindToNode(void* memory, size_t size, size_t node) {
+    if (IsAvailable()) {
+        numa_tonode_memory(memory, size, static_cast<int>(node));
+    }
+}
+
+void RunOnNode(size_t node) {
+    if (IsAvailable()) {
+        numa_run_on_node(node == kAnyNode ? -1 : static_cast<int>(node));
+    }
+}
+
+#else
+
+size_t GetNumNodes() {
+    return 1u;
+}
+
+size_t GetCurrentNode() {
+    return 0u;
+}
+
+void* AllocateOnNode(size_t size, size_t) {
+    return AllocateAligned(size);
+}
+
+void* AllocateInterleaved(size_t size) {
+    return AllocateAligned(size);
+}
+
+void Free(void* memory, size_t) {
+    std::free(memory);
+}
+
+void BindToNode(void*, size_t, size_t) {
+}
+
+void RunOnNode(size_t) {
+}
+
+#endif
+
+} // namespace nlane::util
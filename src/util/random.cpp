@@ -14,6 +14,7 @@
  * limitations under the License. 
  */
 
+#include <cstring>
 #include <mutex>
 
 #include <nlane/util/random.hpp>
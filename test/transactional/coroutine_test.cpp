@@ -0,0 +1,393 @@
+/**
+ * Copyright 2020 Lorenzo Rai
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <nlane/transactional/coroutine.hpp>
+#include <nlane/transactional/transaction_support.hpp>
+#include <nlane/transactional/transactional.hpp>
+
+namespace nlane_test::transactional {
+
+using namespace nlane;
+
+namespace {
+
+// Starts a coroutine right away and destroys it once it has finished
+struct Spawned {
+    struct promise_type {
+        Spawned get_return_object() noexcept {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() const noexcept {
+            return {};
+        }
+
+        std::suspend_never final_suspend() const noexcept {
+            return {};
+        }
+
+        void return_void() const noexcept {
+        }
+
+        void unhandled_exception() const noexcept {
+            std::terminate();
+        }
+    };
+};
+
+// Resumes the coroutines scheduled on it on its own thread
+class Worker {
+  private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::coroutine_handle<>> queue_;
+    bool stop_{ false };
+    std::thread thread_;
+
+  public:
+    struct Awaiter {
+        Worker& worker;
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) const {
+            std::lock_guard<std::mutex> lock{ worker.mutex_ };
+            worker.queue_.push_back(handle);
+            worker.cv_.notify_one();
+        }
+
+        void await_resume() const noexcept {
+        }
+    };
+
+    Worker() : thread_{ [this]() {
+        tr::ThreadInit();
+        std::unique_lock<std::mutex> lock{ mutex_ };
+        while (true) {
+            cv_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return;
+            }
+
+            std::coroutine_handle<> handle{ queue_.front() };
+            queue_.pop_front();
+            lock.unlock();
+            handle.resume();
+            lock.lock();
+        }
+    } } {
+    }
+
+    ~Worker() {
+        {
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            stop_ = true;
+        }
+        cv_.notify_one();
+        thread_.join();
+    }
+
+    // Continues the awaiting coroutine on the thread of this worker
+    Awaiter Schedule() {
+        return Awaiter{ *this };
+    }
+};
+
+// Keeps the awaiting coroutine suspended until it is resumed explicitly
+struct Parked {
+    std::coroutine_handle<>& handle;
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> awaiting) const noexcept {
+        handle = awaiting;
+    }
+
+    void await_resume() const noexcept {
+    }
+};
+
+} // namespace
+
+class CoroutineTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        tr::SetAlgorithm(tr::Algorithm::LOCK_TABLE);
+        tr::ThreadInit();
+    }
+};
+
+TEST_F(CoroutineTest, ResumesOnAnotherThread) {
+    uint64_t words[2]{};
+    std::thread::id read_thread;
+    std::thread::id write_thread;
+    std::promise<void> done;
+
+    Worker first;
+    Worker second;
+    [&]() -> Spawned {
+        co_await first.Schedule();
+        co_await tr::CoAtomic([&](tr::CoTransaction& transaction) -> tr::CoTask<> {
+            const uint64_t v{ transaction.Read(&words[0]) };
+            read_thread = std::this_thread::get_id();
+
+            co_await second.Schedule();
+            write_thread = std::this_thread::get_id();
+            transaction.Write(&words[0], v + 1u);
+            transaction.Write(&words[1], v + 2u);
+        });
+        done.set_value();
+    }();
+    done.get_future().wait();
+
+    ASSERT_NE(read_thread, write_thread);
+    ASSERT_EQ(words[0], 1u);
+    ASSERT_EQ(words[1], 2u);
+}
+
+TEST_F(CoroutineTest, AtomicAcrossSuspensions) {
+    constexpr size_t kCoroutines{ 8u };
+    constexpr size_t kIncrements{ 100u };
+
+    uint64_t counter{ 0u };
+    std::atomic<size_t> running{ kCoroutines };
+    std::promise<void> done;
+
+    Worker first;
+    Worker second;
+    for (size_t c{ 0 }; c < kCoroutines; c++) {
+        [&]() -> Spawned {
+            for (size_t i{ 0 }; i < kIncrements; i++) {
+                co_await first.Schedule();
+                co_await tr::CoAtomic([&](tr::CoTransaction& transaction) -> tr::CoTask<> {
+                    const uint64_t v{ transaction.Read(&counter) };
+                    co_await second.Schedule();
+                    transaction.Write(&counter, v + 1u);
+                });
+            }
+            if (--running == 0u) {
+                done.set_value();
+            }
+        }();
+    }
+
+    // Thread transactions conflict with the suspended ones like with any other transaction
+    for (size_t i{ 0 }; i < kIncrements; i++) {
+        tr::Atomic([&]() {
+            tr::Write(&counter, tr::Read(&counter) + 1u);
+        });
+    }
+    done.get_future().wait();
+
+    ASSERT_EQ(counter, (kCoroutines + 1u) * kIncrements);
+}
+
+TEST_F(CoroutineTest, RetrySuspends) {
+    uint64_t words[16]{};
+
+    size_t attempts{ 0u };
+    uint64_t taken{ 0u };
+    bool finished{ false };
+    [&]() -> Spawned {
+        co_await tr::CoAtomic([&](tr::CoTransaction& transaction) -> tr::CoTask<> {
+            attempts++;
+            const uint64_t v{ transaction.Read(&words[0]) };
+            if (v == 0u) {
+                co_await transaction.Retry();
+            }
+            transaction.Write(&words[0], static_cast<uint64_t>(0u));
+            taken = v;
+        });
+        finished = true;
+    }();
+
+    // The coroutine is suspended and this thread keeps running
+    ASSERT_FALSE(finished);
+    ASSERT_EQ(attempts, 1u);
+
+    // Unrelated commits do not resume the coroutine
+    tr::Atomic([&]() {
+        tr::Write(&words[8], static_cast<uint64_t>(1u));
+    });
+    ASSERT_EQ(attempts, 1u);
+
+    // The committing thread resumes the coroutine once its transaction has finished
+    tr::Atomic([&]() {
+        tr::Write(&words[0], static_cast<uint64_t>(5u));
+    });
+    ASSERT_TRUE(finished);
+    ASSERT_EQ(attempts, 2u);
+    ASSERT_EQ(taken, 5u);
+    ASSERT_EQ(words[0], 0u);
+}
+
+TEST_F(CoroutineTest, SuspendedDuringRollover) {
+    uint64_t word{ 0u };
+    uint64_t other{ 0u };
+
+    std::coroutine_handle<> parked;
+    bool finished{ false };
+    [&]() -> Spawned {
+        co_await tr::CoAtomic([&](tr::CoTransaction& transaction) -> tr::CoTask<> {
+            const uint64_t v{ transaction.Read(&word) };
+            co_await Parked{ parked };
+            transaction.Write(&word, v + 1u);
+        });
+        finished = true;
+    }();
+    ASSERT_FALSE(finished);
+
+    // Thread transactions request a rollover while the detached transaction is suspended
+    const uint64_t epoch{ tr::detail::GetVersionEpoch() };
+    tr::detail::SetMaxVersion(tr::detail::GetGlobalVersion() + 1u);
+    for (size_t i{ 0 }; i < 16u; i++) {
+        tr::Atomic([&]() {
+            tr::Write(&other, tr::Read(&other) + 1u);
+        });
+    }
+    ASSERT_TRUE(tr::detail::IsRolloverRequested());
+    ASSERT_EQ(tr::detail::GetVersionEpoch(), epoch);
+
+    // Restarts park the coroutine again
+    while (!finished) {
+        parked.resume();
+    }
+
+    // The pending rollover is performed by the next transaction
+    tr::Atomic([&]() {
+        tr::Write(&other, tr::Read(&other) + 1u);
+    });
+    tr::detail::SetMaxVersion(tr::kMaxVersion);
+
+    ASSERT_GT(tr::detail::GetVersionEpoch(), epoch);
+    ASSERT_EQ(word, 1u);
+    ASSERT_EQ(other, 17u);
+}
+
+TEST_F(CoroutineTest, ResultsAndErrors) {
+    uint64_t word{ 3u };
+
+    uint64_t result{ 0u };
+    bool failed{ false };
+    [&]() -> Spawned {
+        result = co_await tr::CoAtomic([&](tr::CoTransaction& transaction) -> tr::CoTask<uint64_t> {
+            co_return transaction.Read(&word) * 2u;
+        });
+
+        try {
+            co_await tr::CoAtomic([&](tr::CoTransaction& transaction) -> tr::CoTask<> {
+                transaction.Write(&word, static_cast<uint64_t>(7u));
+                throw std::runtime_error{ "Failed" };
+                co_return;
+            });
+        }
+        catch (std::runtime_error&) {
+            failed = true;
+        }
+    }();
+
+    ASSERT_EQ(result, 6u);
+    ASSERT_TRUE(failed);
+    ASSERT_EQ(word, 3u);
+}
+
+TEST_F(CoroutineTest, ResumedAfterSerializedSite) {
+    static tr::Site site{ "ResumedAfterSerializedSite" };
+    uint64_t words[2]{};
+
+    size_t attempts{ 0u };
+    while (!site.IsSerialized()) {
+        tr::Atomic(site, [&]() {
+            if ((++attempts % 6u) != 0u) {
+                throw tr::TransactionError{ "Forced abort", true };
+            }
+            tr::Write(&words[1], tr::Read(&words[1]) + 1u);
+        });
+    }
+
+    bool finished{ false };
+    [&]() -> Spawned {
+        co_await tr::CoAtomic([&](tr::CoTransaction& transaction) -> tr::CoTask<> {
+            if (transaction.Read(&words[0]) == 0u) {
+                co_await transaction.Retry();
+            }
+        });
+
+        // Runs at the site the committer has used, which has released it by now
+        tr::Atomic(site, [&]() {
+            tr::Write(&words[0], tr::Read(&words[0]) + 1u);
+        });
+        finished = true;
+    }();
+    ASSERT_FALSE(finished);
+
+    ASSERT_TRUE(site.IsSerialized());
+    tr::Atomic(site, [&]() {
+        tr::Write(&words[0], static_cast<uint64_t>(5u));
+        ASSERT_FALSE(finished);
+    });
+    ASSERT_TRUE(finished);
+    ASSERT_EQ(words[0], 6u);
+}
+
+TEST_F(CoroutineTest, ResumeExecutor) {
+    static std::vector<std::pair<void (*)(void*), void*>> queued;
+    tr::SetResumeExecutor([](void (*resume)(void* frame), void* frame) {
+        queued.emplace_back(resume, frame);
+    });
+
+    uint64_t word{ 0u };
+    bool finished{ false };
+    [&]() -> Spawned {
+        co_await tr::CoAtomic([&](tr::CoTransaction& transaction) -> tr::CoTask<> {
+            if (transaction.Read(&word) == 0u) {
+                co_await transaction.Retry();
+            }
+        });
+        finished = true;
+    }();
+
+    // The committing thread leaves the woken coroutine to the executor
+    tr::Atomic([&]() {
+        tr::Write(&word, static_cast<uint64_t>(1u));
+    });
+    tr::SetResumeExecutor(nullptr);
+    ASSERT_FALSE(finished);
+    ASSERT_EQ(queued.size(), 1u);
+
+    queued[0].first(queued[0].second);
+    queued.clear();
+    ASSERT_TRUE(finished);
+}
+
+} // namespace nlane_test::transactional
@@ -0,0 +1,214 @@
+/**
+ * Copyright 2020 Lorenzo Rai
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software 
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. 
+ */
+
+
+/**
+ * Litmus style tests of the memory model guaranteed by transactions. Every test runs a small
+ * program on a few threads many times and checks that no forbidden outcome is ever observed.
+ * Build with NLANE_SANITIZE_THREAD to additionally check for data races.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+#include <nlane/transactional/transactional.hpp>
+
+namespace nlane_test::transactional {
+
+using namespace nlane;
+
+namespace {
+
+constexpr size_t kIterations{ 2000u };
+
+/**
+ * Runs body(thread_index) on _Threads threads for iterations rounds. Every round starts with
+ * reset() on the calling thread, then all threads run body once and finally check() is called.
+ */
+template<size_t _Threads, class _Reset, class _Body, class _Check>
+void RunLitmus(size_t iterations, _Reset reset, _Body body, _Check check) {
+    std::atomic<size_t> round{ 0u };
+    std::atomic<size_t> done{ 0u };
+
+    std::thread threads[_Threads];
+    for(size_t i{ 0 }; i < _Threads; i++) {
+        threads[i] = std::thread{[&, i]() {
+            tr::ThreadInit();
+
+            for(size_t r{ 1 }; r <= iterations; r++) {
+                while(round.load(std::memory_order_acquire) != r) {
+                    std::this_thread::yield();
+                }
+                body(i);
+                done.fetch_add(1u, std::memory_order_release);
+            }
+        }};
+    }
+
+    for(size_t r{ 1 }; r <= iterations; r++) {
+        reset();
+        round.store(r, std::memory_order_release);
+
+        while(done.load(std::memory_order_acquire) != r * _Threads) {
+            std::this_thread::yield();
+        }
+        check();
+    }
+
+    for(std::thread& t : threads) {
+        t.join();
+    }
+}
+
+} // namespace
+
+class LitmusTest : public ::testing::TestWithParam<tr::Algorithm> {
+  protected:
+    void SetUp() override {
+        tr::SetAlgorithm(GetParam());
+        tr::ThreadInit();
+    }
+
+    void TearDown() override {
+        tr::SetAlgorithm(tr::Algorithm::LOCK_TABLE);
+    }
+};
+
+// A reader that sees the second of two ordered writes must also see the first
+TEST_P(LitmusTest, MessagePassing) {
+    uint64_t data;
+    uint64_t flag;
+    uint64_t r_flag;
+    uint64_t r_data;
+
+    RunLitmus<2>(kIterations, [&]() {
+        data = 0u;
+        flag = 0u;
+    }, [&](size_t i) {
+        if(i == 0u) {
+            tr::Atomic([&]() { tr::Write(&data, static_cast<uint64_t>(1u)); });
+            tr::Atomic([&]() { tr::Write(&flag, static_cast<uint64_t>(1u)); });
+        } else {
+            tr::AtomicRead([&]() {
+                r_flag = tr::Read(&flag);
+                r_data = tr::Read(&data);
+            });
+        }
+    }, [&]() {
+        ASSERT_FALSE(r_flag == 1u && r_data == 0u);
+    });
+}
+
+// Two transactions that each write one word and read the other can not both miss the other write
+TEST_P(LitmusTest, StoreBuffering) {
+    uint64_t x;
+    uint64_t y;
+    uint64_t r[2];
+
+    RunLitmus<2>(kIterations, [&]() {
+        x = 0u;
+        y = 0u;
+    }, [&](size_t i) {
+        uint64_t* mine{ i == 0u ? &x : &y };
+        uint64_t* other{ i == 0u ? &y : &x };
+        tr::Atomic([&]() {
+            tr::Write(mine, static_cast<uint64_t>(1u));
+            r[i] = tr::Read(other);
+        });
+    }, [&]() {
+        ASSERT_FALSE(r[0] == 0u && r[1] == 0u);
+    });
+}
+
+// Transactions are serializable, so write skew is impossible
+TEST_P(LitmusTest, WriteSkew) {
+    uint64_t x;
+    uint64_t y;
+
+    RunLitmus<2>(kIterations, [&]() {
+        x = 0u;
+        y = 0u;
+    }, [&](size_t i) {
+        uint64_t* mine{ i == 0u ? &x : &y };
+        tr::Atomic([&]() {
+            if(tr::Read(&x) + tr::Read(&y) == 0u) {
+                tr::Write(mine, static_cast<uint64_t>(1u));
+            }
+        });
+    }, [&]() {
+        ASSERT_EQ(x + y, 1u);
+    });
+}
+
+// Independent writes are observed in the same order by all readers
+TEST_P(LitmusTest, IndependentReadsOfIndependentWrites) {
+    uint64_t x;
+    uint64_t y;
+    uint64_t r[4];
+
+    RunLitmus<4>(kIterations, [&]() {
+        x = 0u;
+        y = 0u;
+    }, [&](size_t i) {
+        switch(i) {
+        case 0:
+            tr::Atomic([&]() { tr::Write(&x, static_cast<uint64_t>(1u)); });
+            break;
+        case 1:
+            tr::Atomic([&]() { tr::Write(&y, static_cast<uint64_t>(1u)); });
+            break;
+        case 2:
+            tr::AtomicRead([&]() {
+                r[0] = tr::Read(&x);
+                r[1] = tr::Read(&y);
+            });
+            break;
+        default:
+            tr::AtomicRead([&]() {
+                r[2] = tr::Read(&y);
+                r[3] = tr::Read(&x);
+            });
+            break;
+        }
+    }, [&]() {
+        ASSERT_FALSE(r[0] == 1u && r[1] == 0u && r[2] == 1u && r[3] == 0u);
+    });
+}
+
+// Concurrent read-modify-write transactions never lose an update
+TEST_P(LitmusTest, NoLostUpdate) {
+    constexpr uint64_t kIncrements{ 16u };
+    uint64_t counter;
+
+    RunLitmus<2>(kIterations / 4u, [&]() {
+        counter = 0u;
+    }, [&](size_t) {
+        for(uint64_t n{ 0 }; n < kIncrements; n++) {
+            tr::Atomic([&]() {
+                tr::Write(&counter, tr::Read(&counter) + 1u);
+            });
+        }
+    }, [&]() {
+        ASSERT_EQ(counter, 2u * kIncrements);
+    });
+}
+
+INSTANTIATE_TEST_SUITE_P(Algorithms, LitmusTest, ::testing::Values(
+    tr::Algorithm::LOCK_TABLE, tr::Algorithm::RING, tr::Algorithm::SEQ_LOCK, tr::Algorithm::SERIAL));
+
+} // namespace nlane_test::transactional
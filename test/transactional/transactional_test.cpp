@@ -18,8 +18,16 @@
 
 #include <atomic>
 #include <chrono>
+#include <memory>
+#include <stdexcept>
 #include <thread>
+#include <vector>
 
+#include <nlane/transactional/dispatch.hpp>
+#include <nlane/transactional/thread_registry.hpp>
+#include <nlane/transactional/transaction_data.hpp>
+#include <nlane/transactional/transaction_engine.hpp>
+#include <nlane/transactional/transaction_support.hpp>
 #include <nlane/transactional/transactional.hpp>
 #include <nlane/util/random.hpp>
 
@@ -27,7 +35,7 @@ namespace nlane_test::transactional {
 
 using namespace nlane;
 
-class TransactionalTest : public ::testing::Test {
+class TransactionalTest : public ::testing::TestWithParam<tr::Algorithm> {
   protected:
     TransactionalTest() {
     }
@@ -36,6 +44,7 @@ class TransactionalTest : public ::testing::Test {
     }
 
     void SetUp() override {
+        tr::SetAlgorithm(GetParam());
         tr::ThreadInit();
     }
 
@@ -43,7 +52,7 @@ class TransactionalTest : public ::testing::Test {
     }
 };
 
-TEST_F(TransactionalTest, WordReadOnly) {
+TEST_P(TransactionalTest, WordReadOnly) {
     constexpr size_t kEntries{ 16u };
     tr::Word words[kEntries];
     
@@ -58,7 +67,7 @@ TEST_F(TransactionalTest, WordReadOnly) {
     });
 }
 
-TEST_F(TransactionalTest, WordReadWrite) {
+TEST_P(TransactionalTest, WordReadWrite) {
     constexpr size_t kEntries{ 16u };
     tr::Word words[kEntries];
 
@@ -107,6 +116,36 @@ TEST_F(TransactionalTest, WordReadWrite) {
     }
 }
 
+TEST_P(TransactionalTest, RepeatedReads) {
+    constexpr size_t kEntries{ 16u };
+    constexpr size_t kReads{ 1000u };
+    tr::Word words[kEntries];
+
+    for(size_t i{ 0 }; i < kEntries; i++) {
+        words[i] = static_cast<tr::Word>(i);
+    }
+
+    // More reads than any log holds entries, repeated reads must not be logged again
+    tr::Word sum{ 0u };
+    tr::AtomicRead([&]() {
+        sum = 0u;
+        for(size_t i{ 0 }; i < kReads; i++) {
+            sum += tr::ReadWord(words + (i % kEntries));
+        }
+    });
+    ASSERT_EQ(sum, (kReads / kEntries) * (kEntries * (kEntries - 1u) / 2u) + ((kReads % kEntries) * ((kReads % kEntries) - 1u) / 2u));
+
+    tr::Atomic([&]() {
+        for(size_t i{ 0 }; i < kReads; i++) {
+            const size_t index{ i % kEntries };
+            tr::WriteWord(words + index, tr::ReadWord(words + index) + 1u, ~static_cast<tr::Word>(0u));
+        }
+    });
+    for(size_t i{ 0 }; i < kEntries; i++) {
+        ASSERT_EQ(words[i], i + (kReads / kEntries) + (i < (kReads % kEntries) ? 1u : 0u));
+    }
+}
+
 template<class _Ty, size_t kEntries>
 inline void SimpleNumberRead() {
     _Ty words[kEntries];
@@ -171,71 +210,71 @@ inline void SimpleNumberReadWrite() {
     }
 }
 
-TEST_F(TransactionalTest, UI64ReadOnly) {
+TEST_P(TransactionalTest, UI64ReadOnly) {
     SimpleNumberRead<uint64_t, 16>();
 }
 
-TEST_F(TransactionalTest, UI64ReadWrite) {
+TEST_P(TransactionalTest, UI64ReadWrite) {
     SimpleNumberReadWrite<uint64_t, 16>();
 }
 
-TEST_F(TransactionalTest, I64ReadOnly) {
+TEST_P(TransactionalTest, I64ReadOnly) {
     SimpleNumberRead<int64_t, 16>();
 }
 
-TEST_F(TransactionalTest, I64ReadWrite) {
+TEST_P(TransactionalTest, I64ReadWrite) {
     SimpleNumberReadWrite<int64_t, 16>();
 }
 
-TEST_F(TransactionalTest, UI32ReadOnly) {
+TEST_P(TransactionalTest, UI32ReadOnly) {
     SimpleNumberRead<uint32_t, 32>();
 }
 
-TEST_F(TransactionalTest, UI32ReadWrite) {
+TEST_P(TransactionalTest, UI32ReadWrite) {
     SimpleNumberReadWrite<uint32_t, 32>();
 }
 
-TEST_F(TransactionalTest, I32ReadOnly) {
+TEST_P(TransactionalTest, I32ReadOnly) {
     SimpleNumberRead<int32_t, 32>();
 }
 
-TEST_F(TransactionalTest, I32ReadWrite) {
+TEST_P(TransactionalTest, I32ReadWrite) {
     SimpleNumberReadWrite<int32_t, 32>();
 }
 
-TEST_F(TransactionalTest, UI16ReadOnly) {
+TEST_P(TransactionalTest, UI16ReadOnly) {
     SimpleNumberRead<uint16_t, 64>();
 }
 
-TEST_F(TransactionalTest, UI16ReadWrite) {
+TEST_P(TransactionalTest, UI16ReadWrite) {
     SimpleNumberReadWrite<uint16_t, 64>();
 }
 
-TEST_F(TransactionalTest, I16ReadOnly) {
+TEST_P(TransactionalTest, I16ReadOnly) {
     SimpleNumberRead<int16_t, 64>();
 }
 
-TEST_F(TransactionalTest, I16ReadWrite) {
+TEST_P(TransactionalTest, I16ReadWrite) {
     SimpleNumberReadWrite<int16_t, 64>();
 }
 
-TEST_F(TransactionalTest, UI8ReadOnly) {
+TEST_P(TransactionalTest, UI8ReadOnly) {
     SimpleNumberRead<uint16_t, 128>();
 }
 
-TEST_F(TransactionalTest, UI8ReadWrite) {
+TEST_P(TransactionalTest, UI8ReadWrite) {
     SimpleNumberReadWrite<uint16_t, 128>();
 }
 
-TEST_F(TransactionalTest, I8ReadOnly) {
+TEST_P(TransactionalTest, I8ReadOnly) {
     SimpleNumberRead<int16_t, 128>();
 }
 
-TEST_F(TransactionalTest, I8ReadWrite) {
+TEST_P(TransactionalTest, I8ReadWrite) {
     SimpleNumberReadWrite<int16_t, 128>();
 }
 
-TEST_F(TransactionalTest, HammerCorrectness) {
+TEST_P(TransactionalTest, HammerCorrectness) {
     constexpr size_t kNumEntries{ 4u };
     constexpr size_t kNumThreads{ 8u };
 
@@ -300,4 +339,1619 @@ TEST_F(TransactionalTest, HammerCorrectness) {
     ASSERT_EQ(sum, 64u * kNumEntries);
 }
 
+TEST_P(TransactionalTest, SharedStripe) {
+    // Words that are 4096 bytes apart are protected by the same lock
+    constexpr size_t kStride{ 4096u / sizeof(uint64_t) };
+    std::unique_ptr<uint64_t[]> words{ new uint64_t[kStride * 2u] };
+
+    words[0] = 1u;
+    words[kStride] = 2u;
+
+    tr::Atomic([&]() {
+        tr::Write(&words[0], tr::Read(&words[0]) + 10u);
+        ASSERT_EQ(tr::Read(&words[kStride]), 2u);
+
+        tr::Write(&words[kStride], tr::Read(&words[kStride]) + 10u);
+        ASSERT_EQ(tr::Read(&words[0]), 11u);
+    });
+
+    ASSERT_EQ(words[0], 11u);
+    ASSERT_EQ(words[kStride], 12u);
+}
+
+TEST_P(TransactionalTest, ContiguousBlock) {
+    struct alignas(64) Block {
+        uint64_t words[24];
+        uint8_t bytes[16];
+    };
+    std::unique_ptr<Block> block{ new Block{} };
+
+    tr::Atomic([&]() {
+        for(size_t i{ 0 }; i < 24u; i++) {
+            tr::Write(&block->words[i], static_cast<uint64_t>(i));
+        }
+        for(size_t i{ 0 }; i < 16u; i += 2u) {
+            tr::Write(&block->bytes[i], static_cast<uint8_t>(i + 1u));
+        }
+
+        for(size_t i{ 0 }; i < 24u; i++) {
+            ASSERT_EQ(tr::Read(&block->words[i]), i);
+        }
+        for(size_t i{ 0 }; i < 16u; i++) {
+            ASSERT_EQ(tr::Read(&block->bytes[i]), (i % 2u) == 0u ? i + 1u : 0u);
+        }
+    });
+
+    for(size_t i{ 0 }; i < 24u; i++) {
+        ASSERT_EQ(block->words[i], i);
+    }
+    for(size_t i{ 0 }; i < 16u; i++) {
+        ASSERT_EQ(block->bytes[i], (i % 2u) == 0u ? i + 1u : 0u);
+    }
+}
+
+TEST_P(TransactionalTest, RingLargeReadSet) {
+    if(GetParam() != tr::Algorithm::RING) {
+        GTEST_SKIP();
+    }
+
+    // Larger than any per stripe read set could hold
+    constexpr size_t kEntries{ 4096u };
+    std::unique_ptr<uint64_t[]> words{ new uint64_t[kEntries] };
+
+    for(size_t i{ 0 }; i < kEntries; i++) {
+        words[i] = static_cast<uint64_t>(i);
+    }
+
+    tr::Atomic([&]() {
+        uint64_t sum{ 0u };
+        for(size_t i{ 0 }; i < kEntries; i++) {
+            sum += tr::Read(&words[i]);
+        }
+        tr::Write(&words[0], sum);
+    });
+
+    ASSERT_EQ(words[0], (kEntries * (kEntries - 1u)) / 2u);
+}
+
+TEST_P(TransactionalTest, TransactionHandle) {
+    constexpr size_t kEntries{ 16u };
+    uint64_t words[kEntries];
+    uint16_t halves[kEntries];
+    double value{ 1.5 };
+
+    for(size_t i{ 0 }; i < kEntries; i++) {
+        words[i] = static_cast<uint64_t>(i);
+        halves[i] = static_cast<uint16_t>(i);
+    }
+
+    tr::Atomic([&](tr::Transaction& tx) {
+        for(size_t i{ 0 }; i < kEntries; i++) {
+            tx.Write(words + i, tx.Read(words + i) * 2u);
+            tx.Write(halves + i, static_cast<uint16_t>(tx.Read(halves + i) + 1u));
+        }
+        tx.Write(&value, tx.Read(&value) * 2.0);
+
+        // The free functions see the writes of the handle and the other way around
+        for(size_t i{ 0 }; i < kEntries; i++) {
+            ASSERT_EQ(tr::Read(words + i), i * 2u);
+        }
+        tr::Write(words, static_cast<uint64_t>(100u));
+        ASSERT_EQ(tx.Read(words), 100u);
+
+        // Nested transactions get a handle to the same transaction
+        tr::Atomic([&](tr::Transaction& inner) {
+            inner.Write(words + 1, inner.Read(words) + 1u);
+        });
+        ASSERT_EQ(tx.Read(words + 1), 101u);
+    });
+
+    ASSERT_EQ(words[0], 100u);
+    ASSERT_EQ(words[1], 101u);
+    for(size_t i{ 2 }; i < kEntries; i++) {
+        ASSERT_EQ(words[i], i * 2u);
+    }
+    for(size_t i{ 0 }; i < kEntries; i++) {
+        ASSERT_EQ(halves[i], i + 1u);
+    }
+    ASSERT_EQ(value, 3.0);
+
+    uint64_t* pointer{ nullptr };
+    tr::Atomic([&](tr::Transaction& tx) {
+        tx.Write(&pointer, words + 3);
+    });
+
+    tr::AtomicRead([&](tr::Transaction& tx) {
+        ASSERT_EQ(tx.Read(&pointer), words + 3);
+        ASSERT_EQ(tx.Read(tx.Read(&pointer)), 6u);
+    });
+}
+
+TEST_P(TransactionalTest, TransactionHandleHammer) {
+    constexpr size_t kNumEntries{ 4u };
+    constexpr size_t kNumThreads{ 8u };
+
+    uint64_t entries[kNumEntries];
+    std::thread threads[kNumThreads];
+
+    for(uint64_t& v : entries) {
+        v = 64u;
+    }
+
+    std::atomic<bool> run{ false };
+    for(std::thread& t : threads) {
+        t = std::thread{[&]() {
+            tr::ThreadInit();
+
+            while(run.load() == false) {
+            }
+
+            uint64_t* e{ entries };
+            while(run.load()) {
+                size_t e1{ util::Rand() % kNumEntries };
+                size_t e2{ (e1 + 1u + (util::Rand() % (kNumEntries - 1u))) % kNumEntries };
+                uint64_t amount{ util::Rand() % 32u };
+
+                tr::Atomic([&](tr::Transaction& tx) {
+                    uint64_t v1{ tx.Read(e + e1) };
+
+                    if(v1 >= amount) {
+                        tx.Write(e + e1, v1 - amount);
+                        tx.Write(e + e2, tx.Read(e + e2) + amount);
+                    }
+                });
+            }
+        }};
+    }
+
+    auto end{ std::chrono::steady_clock::now() + std::chrono::seconds(1) };
+
+    run.store(true);
+    std::this_thread::sleep_until(end);
+
+    run.store(false);
+    for(std::thread& t : threads) {
+        t.join();
+    }
+
+    uint64_t sum{ 0u };
+    tr::AtomicRead([&](tr::Transaction& tx) {
+        sum = 0u;
+        for(uint64_t& v : entries) {
+            sum += tx.Read(&v);
+        }
+    });
+
+    ASSERT_EQ(sum, 64u * kNumEntries);
+}
+
+// Commits a write to word from another thread while the calling thread is inside a transaction
+inline void CommitConcurrently(uint64_t* word, uint64_t value) {
+    std::thread other{[=]() {
+        tr::ThreadInit();
+        tr::Atomic([&]() {
+            tr::Write(word, value);
+        });
+    }};
+    other.join();
+}
+
+TEST_P(TransactionalTest, EarlyRelease) {
+    if(GetParam() == tr::Algorithm::RING || GetParam() == tr::Algorithm::SERIAL) {
+        GTEST_SKIP();
+    }
+
+    // Adjacent words are protected by different stripes
+    uint64_t words[16]{};
+
+    for(bool release : { false, true }) {
+        size_t attempts{ 0u };
+        tr::Atomic([&]() {
+            attempts++;
+            uint64_t v{ tr::Read(&words[0]) };
+            if(release) {
+                tr::Release(&words[0]);
+            }
+
+            if(attempts == 1u) {
+                CommitConcurrently(&words[0], words[0] + 1u);
+            }
+            tr::Write(&words[8], v + 1u);
+        });
+
+        ASSERT_EQ(attempts, release ? 1u : 2u);
+    }
+
+    ASSERT_EQ(words[0], 2u);
+}
+
+TEST_P(TransactionalTest, ElasticWindow) {
+    if(GetParam() == tr::Algorithm::RING || GetParam() == tr::Algorithm::SERIAL) {
+        GTEST_SKIP();
+    }
+
+    uint64_t words[32]{};
+
+    // Updates of reads that left the window do not conflict
+    size_t attempts{ 0u };
+    tr::AtomicElastic([&]() {
+        attempts++;
+        uint64_t sum{ tr::Read(&words[0]) + tr::Read(&words[8]) + tr::Read(&words[16]) };
+
+        if(attempts == 1u) {
+            CommitConcurrently(&words[0], 1u);
+        }
+        tr::Write(&words[24], sum + 1u);
+    });
+    ASSERT_EQ(attempts, 1u);
+
+    // The most recent reads are still validated
+    attempts = 0u;
+    tr::AtomicElastic([&](tr::Transaction& tx) {
+        attempts++;
+        uint64_t sum{ tx.Read(&words[0]) + tx.Read(&words[8]) + tx.Read(&words[16]) };
+
+        if(attempts == 1u) {
+            CommitConcurrently(&words[16], 1u);
+        }
+        tx.Write(&words[24], sum);
+    });
+    ASSERT_EQ(attempts, 2u);
+    ASSERT_EQ(words[24], 2u);
+
+    // Reads after the first write are tracked like in any other transaction
+    attempts = 0u;
+    tr::AtomicElastic([&]() {
+        attempts++;
+        tr::Write(&words[24], static_cast<uint64_t>(0u));
+        uint64_t sum{ tr::Read(&words[0]) + tr::Read(&words[8]) + tr::Read(&words[16]) };
+
+        if(attempts == 1u) {
+            CommitConcurrently(&words[0], 2u);
+        }
+        tr::Write(&words[24], sum);
+    });
+    ASSERT_EQ(attempts, 2u);
+    ASSERT_EQ(words[24], 3u);
+}
+
+TEST_P(TransactionalTest, SnapshotIsolation) {
+    if(GetParam() == tr::Algorithm::SERIAL) {
+        GTEST_SKIP();
+    }
+
+    uint64_t words[16]{};
+
+    // Updates of locations that have only been read are only conflicts for serializable algorithms
+    size_t attempts{ 0u };
+    tr::AtomicSnapshot([&]() {
+        attempts++;
+        uint64_t v{ tr::Read(&words[0]) };
+
+        if(attempts == 1u) {
+            CommitConcurrently(&words[0], 1u);
+        }
+        tr::Write(&words[8], v + 1u);
+    });
+    ASSERT_EQ(attempts, (GetParam() == tr::Algorithm::LOCK_TABLE) ? 1u : 2u);
+
+    // Write-write conflicts always abort
+    attempts = 0u;
+    tr::AtomicSnapshot([&](tr::Transaction& tx) {
+        attempts++;
+        uint64_t v{ tx.Read(&words[8]) };
+
+        if(attempts == 1u) {
+            CommitConcurrently(&words[8], 10u);
+        }
+        tx.Write(&words[8], v + 1u);
+    });
+    ASSERT_EQ(attempts, 2u);
+    ASSERT_EQ(words[8], 11u);
+}
+
+TEST_P(TransactionalTest, DeferredActions) {
+    uint64_t word{ 0u };
+    size_t attempts{ 0u };
+    size_t commits{ 0u };
+    size_t aborts{ 0u };
+    std::vector<int> order;
+
+    // Does not fit into the inline storage of an action
+    uint64_t large[16]{};
+    large[15] = 5u;
+
+    tr::Atomic([&]() {
+        attempts++;
+        tr::OnCommit([&]() {
+            commits++;
+            order.push_back(1);
+
+            // Actions run outside of the transaction
+            tr::Atomic([&]() {
+                tr::Write(&word, tr::Read(&word) + 1u);
+            });
+        });
+        tr::OnAbort([&]() {
+            aborts++;
+        });
+
+        // Nested blocks add to the queues of the outer most transaction
+        tr::Atomic([&]() {
+            tr::OnCommit([&, large]() {
+                commits += large[15];
+                order.push_back(2);
+            });
+        });
+
+        if(attempts == 1u) {
+            throw tr::TransactionError{ "Forced abort", true };
+        }
+        tr::Write(&word, tr::Read(&word) + 1u);
+        ASSERT_EQ(commits, 0u);
+    });
+
+    ASSERT_EQ(attempts, 2u);
+    ASSERT_EQ(aborts, 1u);
+    ASSERT_EQ(commits, 6u);
+    ASSERT_EQ(order, (std::vector<int>{ 1, 2 }));
+    ASSERT_EQ(word, 2u);
+
+    // Terminating errors run the abort actions and drop the commit actions
+    ASSERT_THROW(tr::AtomicRead([&]() {
+        tr::OnCommit([&]() {
+            commits++;
+        });
+        tr::OnAbort([&]() {
+            aborts++;
+        });
+        throw tr::TransactionError{ "Fatal", false };
+    }), tr::TransactionError);
+    ASSERT_EQ(commits, 6u);
+    ASSERT_EQ(aborts, 2u);
+
+    ASSERT_THROW(tr::OnCommit([]() {}), tr::TransactionError);
+}
+
+TEST_P(TransactionalTest, RetryBlocksUntilWrite) {
+    uint64_t words[16]{};
+
+    std::atomic<size_t> attempts{ 0u };
+    uint64_t taken{ 0u };
+    std::thread consumer{[&]() {
+        tr::ThreadInit();
+        tr::Atomic([&]() {
+            attempts++;
+            uint64_t v{ tr::Read(&words[0]) };
+            if(v == 0u) {
+                tr::Retry();
+            }
+            tr::Write(&words[0], static_cast<uint64_t>(0u));
+            taken = v;
+        });
+    }};
+
+    // Unrelated commits do not wake the consumer up
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    tr::Atomic([&]() {
+        tr::Write(&words[8], static_cast<uint64_t>(1u));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_EQ(attempts.load(), 2u);
+
+    tr::Atomic([&]() {
+        tr::Write(&words[0], static_cast<uint64_t>(5u));
+    });
+    consumer.join();
+
+    ASSERT_EQ(attempts.load(), 3u);
+    ASSERT_EQ(taken, 5u);
+    ASSERT_EQ(words[0], 0u);
+}
+
+TEST_P(TransactionalTest, OrElse) {
+    uint64_t words[16]{};
+    words[8] = 7u;
+
+    auto take{ [&](uint64_t* word) {
+        return [&, word]() {
+            uint64_t v{ tr::Read(word) };
+            if(v == 0u) {
+                tr::Retry();
+            }
+            tr::Write(word, static_cast<uint64_t>(0u));
+            words[15] = v;
+        };
+    } };
+
+    tr::OrElse(take(&words[0]), take(&words[8]));
+    ASSERT_EQ(words[15], 7u);
+    ASSERT_EQ(words[8], 0u);
+
+    // The first alternative can not be undone after it has written
+    ASSERT_THROW(tr::OrElse([&]() {
+        tr::Write(&words[0], static_cast<uint64_t>(1u));
+        tr::Retry();
+    }, take(&words[8])), tr::TransactionError);
+    ASSERT_EQ(words[0], 0u);
+
+    ASSERT_THROW(tr::Retry(), tr::TransactionError);
+}
+
+TEST_P(TransactionalTest, CapturedAllocation) {
+    struct Node {
+        uint64_t value;
+        Node* next;
+    };
+
+    Node* head{ nullptr };
+    uint64_t words[16]{};
+
+    size_t attempts{ 0u };
+    tr::Atomic([&]() {
+        attempts++;
+        Node* node{ static_cast<Node*>(tr::Allocate(sizeof(Node))) };
+        ASSERT_TRUE(tr::detail::IsCaptured(node));
+        ASSERT_TRUE(tr::detail::IsCaptured(&node->next));
+        ASSERT_FALSE(tr::detail::IsCaptured(&head));
+
+        tr::Write(&node->value, tr::Read(&words[0]) + 1u);
+        tr::Write(&node->next, tr::Read(&head));
+        ASSERT_EQ(tr::Read(&node->value), words[0] + 1u);
+
+        // Memory allocated by an aborted attempt is freed and captured again by the next one
+        if((attempts == 1u) && (GetParam() != tr::Algorithm::SERIAL)) {
+            CommitConcurrently(&words[0], 10u);
+        }
+        tr::Write(&head, node);
+    });
+
+    ASSERT_EQ(attempts, GetParam() == tr::Algorithm::SERIAL ? 1u : 2u);
+    ASSERT_NE(head, nullptr);
+    ASSERT_FALSE(tr::detail::IsCaptured(head));
+    ASSERT_EQ(head->value, GetParam() == tr::Algorithm::SERIAL ? 1u : 11u);
+    ASSERT_EQ(head->next, nullptr);
+
+    // Committed memory is accessed like any other shared memory
+    tr::Atomic([&]() {
+        ASSERT_FALSE(tr::detail::IsCaptured(head));
+        tr::Write(&head->value, tr::Read(&head->value) * 2u);
+    });
+    ASSERT_EQ(head->value, GetParam() == tr::Algorithm::SERIAL ? 2u : 22u);
+
+    ::operator delete(head);
+}
+
+TEST_P(TransactionalTest, CapturedAllocationHammer) {
+    struct Node {
+        uint64_t value;
+        Node* next;
+    };
+
+    constexpr size_t kNumThreads{ 4u };
+    constexpr size_t kPushesPerThread{ 2000u };
+
+    Node* head{ nullptr };
+    std::thread threads[kNumThreads];
+
+    for(std::thread& t : threads) {
+        t = std::thread{[&]() {
+            tr::ThreadInit();
+
+            for(size_t i{ 0 }; i < kPushesPerThread; i++) {
+                tr::Atomic([&](tr::Transaction& tx) {
+                    Node* node{ static_cast<Node*>(tr::Allocate(sizeof(Node))) };
+                    Node* next{ tx.Read(&head) };
+
+                    tx.Write(&node->value, next != nullptr ? tx.Read(&next->value) + 1u : static_cast<uint64_t>(1u));
+                    tx.Write(&node->next, next);
+                    tx.Write(&head, node);
+                });
+            }
+        }};
+    }
+
+    for(std::thread& t : threads) {
+        t.join();
+    }
+
+    // Every node counts the nodes up to the end of the stack
+    uint64_t expected{ kNumThreads * kPushesPerThread };
+    while(head != nullptr) {
+        ASSERT_EQ(head->value, expected--);
+
+        Node* next{ head->next };
+        ::operator delete(head);
+        head = next;
+    }
+    ASSERT_EQ(expected, 0u);
+}
+
+TEST_P(TransactionalTest, RegisteredRegions) {
+    uint64_t table[8];
+    uint64_t owned[8]{};
+    uint64_t words[16]{};
+
+    for(size_t i{ 0 }; i < 8u; i++) {
+        table[i] = static_cast<uint64_t>(i);
+    }
+
+    tr::RegisterRegion(table, sizeof(table), tr::RegionKind::IMMUTABLE);
+    tr::RegisterRegion(owned, sizeof(owned), tr::RegionKind::PRIVATE);
+
+    // Private writes are performed in place and undone by aborts
+    size_t attempts{ 0u };
+    tr::Atomic([&]() {
+        attempts++;
+        uint64_t sum{ tr::Read(&words[0]) };
+        for(size_t i{ 0 }; i < 8u; i++) {
+            sum += tr::Read(&table[i]);
+        }
+        tr::Write(&owned[0], tr::Read(&owned[0]) + 1u);
+
+        if((attempts == 1u) && (GetParam() != tr::Algorithm::SERIAL)) {
+            CommitConcurrently(&words[0], 1u);
+        }
+        tr::Write(&words[8], sum);
+    });
+
+    const size_t expected_attempts{ GetParam() == tr::Algorithm::SERIAL ? 1u : 2u };
+    ASSERT_EQ(attempts, expected_attempts);
+    ASSERT_EQ(owned[0], 1u);
+    ASSERT_EQ(words[8], 28u + words[0]);
+
+    // Rolled back together with the transaction
+    ASSERT_THROW(tr::Atomic([&]() {
+        tr::Write(&owned[1], static_cast<uint64_t>(3u));
+        tr::Write(&owned[1], static_cast<uint64_t>(4u));
+        throw std::runtime_error{ "Failed" };
+    }), std::runtime_error);
+    ASSERT_EQ(owned[1], 0u);
+
+    // Immutable regions are never written, even without verification
+    ASSERT_THROW(tr::Atomic([&]() {
+        tr::Write(&table[0], static_cast<uint64_t>(1u));
+    }), tr::TransactionError);
+    ASSERT_EQ(table[0], 0u);
+
+    tr::UnregisterRegion(owned);
+    tr::UnregisterRegion(table);
+
+    ASSERT_THROW(tr::RegisterRegion(&table[0], 12u, tr::RegionKind::IMMUTABLE), tr::TransactionError);
+    tr::Atomic([&]() {
+        ASSERT_THROW(tr::RegisterRegion(table, sizeof(table), tr::RegionKind::IMMUTABLE), tr::TransactionError);
+    });
+}
+
+TEST_P(TransactionalTest, RegionVerification) {
+    uint64_t table[8]{};
+    uint64_t owned[8]{};
+
+    tr::SetRegionVerification(true);
+    tr::RegisterRegion(table, sizeof(table), tr::RegionKind::IMMUTABLE);
+    tr::RegisterRegion(owned, sizeof(owned), tr::RegionKind::PRIVATE);
+
+    ASSERT_THROW(tr::Atomic([&]() {
+        tr::Write(&table[0], static_cast<uint64_t>(1u));
+    }), tr::TransactionError);
+
+    tr::Atomic([&]() {
+        tr::Write(&owned[0], tr::Read(&table[1]) + 1u);
+    });
+    ASSERT_EQ(owned[0], 1u);
+
+    bool thrown{ false };
+    std::thread other{[&]() {
+        tr::ThreadInit();
+        try {
+            tr::AtomicRead([&]() {
+                tr::Read(&owned[0]);
+            });
+        } catch(const tr::TransactionError&) {
+            thrown = true;
+        }
+    }};
+    other.join();
+    ASSERT_TRUE(thrown);
+
+    // Modifications outside of transactions are detected when the region is unregistered
+    table[2] = 5u;
+    tr::UnregisterRegion(owned);
+    ASSERT_THROW(tr::UnregisterRegion(table), tr::TransactionError);
+
+    tr::SetRegionVerification(false);
+}
+
+INSTANTIATE_TEST_SUITE_P(Algorithms, TransactionalTest, ::testing::Values(
+    tr::Algorithm::LOCK_TABLE, tr::Algorithm::RING, tr::Algorithm::SEQ_LOCK, tr::Algorithm::SERIAL));
+
+TEST(VersionedLockTest, LockUnlock) {
+    constexpr tr::detail::ThreadId owner_a{ 1u };
+    constexpr tr::detail::ThreadId owner_b{ tr::detail::kMaxThreads - 1u };
+    tr::detail::VersionedLock lock;
+
+    lock.Unlock(42u);
+    ASSERT_FALSE(lock.IsLocked());
+    ASSERT_EQ(lock.GetOwner(), tr::detail::kNoThread);
+    ASSERT_EQ(tr::detail::VersionedLock::GetVersion(lock.Get()), 42u);
+
+    tr::Version version{ 0u };
+    ASSERT_TRUE(lock.TryLock(owner_a, version));
+    ASSERT_EQ(version, 42u);
+    ASSERT_TRUE(lock.IsLocked());
+    ASSERT_TRUE(lock.IsLockedBy(owner_a));
+    ASSERT_FALSE(lock.IsLockedBy(owner_b));
+    ASSERT_EQ(lock.GetOwner(), owner_a);
+    ASSERT_FALSE(lock.TryLock(owner_b, version));
+
+    lock.Unlock(43u);
+    ASSERT_FALSE(lock.IsLocked());
+    ASSERT_EQ(tr::detail::VersionedLock::GetVersion(lock.Get()), 43u);
+}
+
+TEST(CommitDescriptorTest, LastFinisherReleases) {
+    tr::detail::CommitDescriptor descriptor;
+    ASSERT_FALSE(descriptor.Enter());
+
+    const tr::Version versions[]{ 7u, 9u };
+    descriptor.Publish(versions);
+    ASSERT_TRUE(descriptor.Enter());
+    ASSERT_TRUE(descriptor.Enter());
+    ASSERT_EQ(descriptor.GetVersion(0u), 7u);
+    ASSERT_EQ(descriptor.GetVersion(1u), 9u);
+
+    // The first finished write back closes the descriptor, the last one releases
+    ASSERT_FALSE(descriptor.Finish());
+    ASSERT_FALSE(descriptor.Enter());
+
+    std::atomic<bool> released{ false };
+    std::thread committer{[&]() {
+        descriptor.WaitReleased();
+        released.store(true);
+    }};
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_FALSE(released.load());
+
+    ASSERT_TRUE(descriptor.Finish());
+    descriptor.MarkReleased();
+    committer.join();
+    ASSERT_TRUE(released.load());
+    ASSERT_FALSE(descriptor.Enter());
+}
+
+namespace {
+
+// Set while the committer on the thread that set stall_write_back is stalled before its write back
+thread_local bool stall_write_back{ false };
+std::atomic<bool> write_back_stalled{ false };
+std::atomic<bool> write_back_resumed{ false };
+
+void StallWriteBack() {
+    if (!stall_write_back) {
+        return;
+    }
+    write_back_stalled.store(true);
+    while (!write_back_resumed.load()) {
+        std::this_thread::yield();
+    }
+}
+
+} // namespace
+
+TEST(CommitDescriptorTest, HelpersReleasePreemptedCommitter) {
+    if constexpr (!tr::detail::TransactionEngine::kHelping) {
+        GTEST_SKIP() << "The write back can not be helped in this configuration";
+    }
+    tr::SetAlgorithm(tr::Algorithm::LOCK_TABLE);
+    tr::ThreadInit();
+
+    uint64_t words[16]{};
+    tr::detail::SetWriteBackHook(StallWriteBack);
+
+    std::thread committer{[&]() {
+        tr::ThreadInit();
+        stall_write_back = true;
+        tr::Atomic([&]() {
+            tr::Write(&words[0], static_cast<uint64_t>(1u));
+        });
+    }};
+    while (!write_back_stalled.load()) {
+        std::this_thread::yield();
+    }
+
+    // Readers and writers finish the write back and take over the stripes of the stalled committer
+    uint64_t read{ 0u };
+    tr::AtomicRead([&]() {
+        read = tr::Read(&words[0]);
+    });
+    ASSERT_EQ(read, 1u);
+
+    tr::Atomic([&]() {
+        tr::Write(&words[0], tr::Read(&words[0]) + 1u);
+    });
+    ASSERT_EQ(words[0], 2u);
+
+    // The committer neither writes back again nor releases the stripes a second time
+    write_back_resumed.store(true);
+    committer.join();
+    tr::detail::SetWriteBackHook(nullptr);
+
+    tr::Atomic([&]() {
+        tr::Write(&words[0], tr::Read(&words[0]) + 1u);
+    });
+    ASSERT_EQ(words[0], 3u);
+}
+
+TEST(ThreadRegistryTest, DenseIdsAreReused) {
+    int engines[3];
+
+    // Ids of exited threads may still be free, so only compare ids relative to each other
+    tr::detail::ThreadId a{ tr::detail::RegisterThread(&engines[0]) };
+    tr::detail::ThreadId b{ tr::detail::RegisterThread(&engines[1]) };
+    ASSERT_NE(a, tr::detail::kNoThread);
+    ASSERT_NE(b, tr::detail::kNoThread);
+    ASSERT_NE(a, b);
+    ASSERT_EQ(tr::detail::GetRegisteredEngine(a), &engines[0]);
+    ASSERT_EQ(tr::detail::GetRegisteredEngine(b), &engines[1]);
+
+    tr::detail::UnregisterThread(a);
+    ASSERT_EQ(tr::detail::GetRegisteredEngine(a), nullptr);
+
+    tr::detail::ThreadId c{ tr::detail::RegisterThread(&engines[2]) };
+    ASSERT_LE(c, a);
+    ASSERT_EQ(tr::detail::GetRegisteredEngine(c), &engines[2]);
+
+    tr::detail::UnregisterThread(b);
+    tr::detail::UnregisterThread(c);
+}
+
+TEST(ThreadRegistryTest, PinsDelayUnregistering) {
+    int engine;
+    tr::detail::ThreadId id{ tr::detail::RegisterThread(&engine) };
+
+    std::atomic<bool> unregistered{ false };
+    std::thread exiting;
+    {
+        const tr::detail::PinnedEngine pin{ id };
+        ASSERT_EQ(pin.Get(), &engine);
+
+        exiting = std::thread{[&]() {
+            tr::detail::UnregisterThread(id);
+            unregistered = true;
+        }};
+
+        // The engine is no longer found but can not be destroyed while it is pinned
+        while(tr::detail::GetRegisteredEngine(id) != nullptr) {
+            std::this_thread::yield();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ASSERT_FALSE(unregistered.load());
+
+        const tr::detail::PinnedEngine late{ id };
+        ASSERT_EQ(late.Get(), nullptr);
+    }
+    exiting.join();
+    ASSERT_TRUE(unregistered.load());
+}
+
+TEST(ThreadRegistryTest, ExitedThreadsReleaseIds) {
+    tr::ThreadInit();
+    const size_t registered{ tr::detail::GetNumRegisteredThreads() };
+
+    std::thread threads[4];
+    for(std::thread& t : threads) {
+        t = std::thread{[]() {
+            tr::ThreadInit();
+        }};
+    }
+    for(std::thread& t : threads) {
+        t.join();
+    }
+
+    ASSERT_EQ(tr::detail::GetNumRegisteredThreads(), registered);
+}
+
+TEST(RolloverTest, HammerWithSmallMaxVersion) {
+    constexpr size_t kNumEntries{ 4u };
+    constexpr size_t kNumThreads{ 4u };
+
+    uint64_t entries[kNumEntries];
+    std::thread threads[kNumThreads];
+
+    for(uint64_t& v : entries) {
+        v = 64u;
+    }
+
+    tr::SetAlgorithm(tr::Algorithm::LOCK_TABLE);
+    tr::ThreadInit();
+
+    const uint64_t epoch{ tr::detail::GetVersionEpoch() };
+    tr::detail::SetMaxVersion(256u);
+
+    std::atomic<bool> run{ false };
+    for(std::thread& t : threads) {
+        t = std::thread{[&]() {
+            tr::ThreadInit();
+
+            while(run.load() == false) {
+            }
+
+            uint64_t* e{ entries };
+            while(run.load()) {
+                size_t e1{ util::Rand() % kNumEntries };
+                size_t e2{ (e1 + 1u) % kNumEntries };
+                uint64_t amount{ util::Rand() % 32u };
+
+                tr::Atomic([&]() {
+                    uint64_t v1{ tr::Read(e + e1) };
+
+                    if(v1 >= amount) {
+                        tr::Write(e + e1, v1 - amount);
+                        tr::Write(e + e2, tr::Read(e + e2) + amount);
+                    }
+                });
+
+                uint64_t sum{ 0u };
+                tr::AtomicRead([&]() {
+                    sum = 0u;
+                    for(size_t i{ 0 }; i < kNumEntries; i++) {
+                        sum += tr::Read(e + i);
+                    }
+                });
+                ASSERT_EQ(sum, 64u * kNumEntries);
+            }
+        }};
+    }
+
+    run.store(true);
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    run.store(false);
+    for(std::thread& t : threads) {
+        t.join();
+    }
+
+    tr::detail::SetMaxVersion(tr::kMaxVersion);
+
+    ASSERT_GT(tr::detail::GetVersionEpoch(), epoch);
+
+    uint64_t sum{ 0u };
+    for(uint64_t v : entries) {
+        sum += v;
+    }
+
+    ASSERT_EQ(sum, 64u * kNumEntries);
+}
+
+TEST(DomainTest, SeparateLocksAndClocks) {
+    // Assigned ranges stay assigned so they must never be reused for other memory
+    static uint64_t words[64];
+    static uint64_t other[8];
+
+    tr::SetAlgorithm(tr::Algorithm::LOCK_TABLE);
+    tr::ThreadInit();
+
+    const tr::Domain domain{ tr::CreateDomain("DomainTest.SeparateLocksAndClocks", 100u) };
+    tr::AssignDomain(domain, words, sizeof(words));
+    ASSERT_NE(domain, tr::kDefaultDomain);
+    ASSERT_EQ(tr::FindDomain("DomainTest.SeparateLocksAndClocks"), domain);
+    ASSERT_THROW(tr::FindDomain("DomainTest.Unknown"), tr::TransactionError);
+    ASSERT_THROW(tr::CreateDomain("DomainTest.SeparateLocksAndClocks", 16u), tr::TransactionError);
+
+    // Every word of the domain has its own lock
+    ASSERT_EQ(tr::detail::GetDomain(tr::detail::GetLockIndex(&words[0])), domain);
+    ASSERT_EQ(tr::detail::GetDomain(tr::detail::GetLockIndex(&other[0])), tr::kDefaultDomain);
+    ASSERT_NE(tr::detail::GetLockIndex(&words[0]), tr::detail::GetLockIndex(&words[1]));
+    ASSERT_NE(tr::detail::GetLockIndex(&words[0]), tr::detail::GetLockIndex(&words[63]));
+
+    const tr::Version domain_version{ tr::detail::GetDomainVersion(domain) };
+    const tr::Version global_version{ tr::detail::GetGlobalVersion() };
+
+    tr::Atomic([&]() {
+        tr::Write(&words[0], tr::Read(&words[1]) + 1u);
+    });
+    ASSERT_EQ(tr::detail::GetDomainVersion(domain), domain_version + 1u);
+    ASSERT_EQ(tr::detail::GetGlobalVersion(), global_version);
+
+    tr::Atomic([&]() {
+        tr::Write(&other[0], tr::Read(&words[0]) + 1u);
+    });
+    ASSERT_EQ(tr::detail::GetDomainVersion(domain), domain_version + 1u);
+    ASSERT_EQ(tr::detail::GetGlobalVersion(), global_version + 1u);
+    ASSERT_EQ(other[0], 2u);
+
+    // Reads of a domain that has been committed to in the meantime are validated
+    size_t attempts{ 0u };
+    tr::Atomic([&]() {
+        attempts++;
+        uint64_t v{ tr::Read(&words[0]) };
+
+        if(attempts == 1u) {
+            std::thread writer{[&]() {
+                tr::ThreadInit();
+                tr::Atomic([&]() {
+                    tr::Write(&words[0], static_cast<uint64_t>(10u));
+                });
+            }};
+            writer.join();
+        }
+        tr::Write(&other[1], v);
+    });
+    ASSERT_EQ(attempts, 2u);
+    ASSERT_EQ(other[1], 10u);
+}
+
+TEST(DomainTest, HammerAcrossDomains) {
+    constexpr size_t kNumEntries{ 4u };
+    constexpr size_t kNumThreads{ 4u };
+
+    static uint64_t physics[kNumEntries];
+    static uint64_t economy[kNumEntries];
+    uint64_t shared[kNumEntries];
+
+    uint64_t* const groups[]{ physics, economy, shared };
+    for(uint64_t* group : groups) {
+        for(size_t i{ 0 }; i < kNumEntries; i++) {
+            group[i] = 64u;
+        }
+    }
+
+    tr::SetAlgorithm(tr::Algorithm::LOCK_TABLE);
+    tr::ThreadInit();
+
+    tr::AssignDomain(tr::CreateDomain("DomainTest.Physics", 64u), physics, sizeof(physics));
+    tr::AssignDomain(tr::CreateDomain("DomainTest.Economy", 64u), economy, sizeof(economy));
+
+    std::atomic<bool> run{ false };
+    std::thread threads[kNumThreads];
+    for(std::thread& t : threads) {
+        t = std::thread{[&]() {
+            tr::ThreadInit();
+
+            while(run.load() == false) {
+            }
+
+            while(run.load()) {
+                uint64_t* from{ groups[util::Rand() % 3u] + (util::Rand() % kNumEntries) };
+                uint64_t* to{ groups[util::Rand() % 3u] + (util::Rand() % kNumEntries) };
+                uint64_t amount{ util::Rand() % 32u };
+
+                if(from != to) {
+                    tr::Atomic([&]() {
+                        uint64_t v{ tr::Read(from) };
+                        if(v >= amount) {
+                            tr::Write(from, v - amount);
+                            tr::Write(to, tr::Read(to) + amount);
+                        }
+                    });
+                }
+
+                // Transactions spanning all domains always see a consistent snapshot
+                uint64_t sum{ 0u };
+                tr::AtomicRead([&]() {
+                    sum = 0u;
+                    for(uint64_t* group : groups) {
+                        for(size_t i{ 0 }; i < kNumEntries; i++) {
+                            sum += tr::Read(group + i);
+                        }
+                    }
+                });
+                ASSERT_EQ(sum, 3u * 64u * kNumEntries);
+            }
+        }};
+    }
+
+    run.store(true);
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    run.store(false);
+    for(std::thread& t : threads) {
+        t.join();
+    }
+}
+
+TEST(RemapTest, HotAddressGetsOwnLock) {
+    // The default domain maps addresses 4096 bytes apart to the same stripe
+    alignas(64) static uint64_t words[tr::detail::kLockTableSize / sizeof(uint64_t) + 8u];
+    uint64_t* const hot{ &words[0] };
+    uint64_t* const cold{ &words[tr::detail::kLockTableSize / sizeof(uint64_t)] };
+
+    tr::SetAlgorithm(tr::Algorithm::LOCK_TABLE);
+    tr::ThreadInit();
+
+    // Drops the conflicts profiled and the addresses remapped by earlier tests
+    tr::detail::RemapHotStripes();
+    tr::SetContentionRemapping(false);
+    tr::SetContentionRemapping(true);
+
+    const tr::detail::LockIndex stripe{ tr::detail::GetLockIndex(hot) };
+    ASSERT_EQ(tr::detail::GetLockIndex(cold), stripe);
+
+    // Commits to the hot word abort readers of the cold one
+    for(size_t expected : { 2u, 1u }) {
+        size_t attempts{ 0u };
+        tr::Atomic([&]() {
+            attempts++;
+            uint64_t v{ tr::Read(cold) };
+            if(attempts == 1u) {
+                CommitConcurrently(hot, *hot + 1u);
+            }
+            tr::Write(&words[1], v + 1u);
+        });
+        ASSERT_EQ(attempts, expected);
+
+        if(expected == 2u) {
+            for(uint32_t i{ 0 }; i < tr::detail::kHotStripeConflicts; i++) {
+                tr::detail::RecordConflict(stripe, hot);
+            }
+            tr::detail::RecordConflict(stripe, cold);
+
+            ASSERT_GE(tr::detail::RemapHotStripes(), 1u);
+            ASSERT_GE(tr::detail::GetLockIndex(hot), tr::detail::kLockTableSize);
+            ASSERT_EQ(tr::detail::GetLockIndex(cold), stripe);
+        }
+    }
+
+    ASSERT_EQ(*hot, 2u);
+    ASSERT_EQ(words[1], 1u);
+
+    tr::SetContentionRemapping(false);
+    ASSERT_EQ(tr::detail::GetNumHotAddresses(), 0u);
+    ASSERT_EQ(tr::detail::GetLockIndex(hot), stripe);
+    tr::SetContentionRemapping(true);
+}
+
+TEST(VisibleReaderTest, WritersWaitForReaders) {
+    static uint64_t words[16];
+
+    tr::SetAlgorithm(tr::Algorithm::LOCK_TABLE);
+    tr::ThreadInit();
+    tr::SetVisibleReaders(&words[0], sizeof(uint64_t));
+    ASSERT_NE(tr::detail::GetReaderIndicator(tr::detail::GetLockIndex(&words[0])), nullptr);
+    ASSERT_EQ(tr::detail::GetReaderIndicator(tr::detail::GetLockIndex(&words[8])), nullptr);
+
+    // The writer commits while the reader is running but can not invalidate it
+    std::atomic<bool> started{ false };
+    std::thread writer;
+    size_t attempts{ 0u };
+    tr::Atomic([&]() {
+        attempts++;
+        uint64_t v{ tr::Read(&words[0]) };
+
+        if(attempts == 1u) {
+            writer = std::thread{[&]() {
+                tr::ThreadInit();
+                started.store(true);
+                tr::Atomic([&]() {
+                    tr::Write(&words[0], static_cast<uint64_t>(5u));
+                });
+            }};
+            while(!started.load()) {
+                std::this_thread::yield();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        tr::Write(&words[8], v + 1u);
+    });
+    writer.join();
+
+    ASSERT_EQ(attempts, 1u);
+    ASSERT_EQ(words[0], 5u);
+    ASSERT_EQ(words[8], 1u);
+
+    tr::ClearVisibleReaders();
+    ASSERT_EQ(tr::detail::GetReaderIndicator(tr::detail::GetLockIndex(&words[0])), nullptr);
+}
+
+TEST(VisibleReaderTest, Hammer) {
+    constexpr size_t kNumThreads{ 4u };
+
+    static uint64_t counter;
+    static uint64_t entries[kNumThreads];
+
+    tr::SetAlgorithm(tr::Algorithm::LOCK_TABLE);
+    tr::ThreadInit();
+    tr::SetVisibleReaders(&counter, sizeof(counter));
+
+    std::atomic<bool> run{ false };
+    std::thread threads[kNumThreads];
+    for(size_t i{ 0 }; i < kNumThreads; i++) {
+        threads[i] = std::thread{[&, i]() {
+            tr::ThreadInit();
+            while(!run.load()) {
+                std::this_thread::yield();
+            }
+
+            for(size_t n{ 0 }; run.load(); n++) {
+                tr::Atomic([&]() {
+                    // Mostly reads of the counter, every 16th transaction increments it
+                    uint64_t c{ tr::Read(&counter) };
+                    if((n % 16u) == 0u) {
+                        tr::Write(&counter, c + 1u);
+                        tr::Write(&entries[i], tr::Read(&entries[i]) + 1u);
+                    }
+                });
+            }
+        }};
+    }
+
+    run.store(true);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    run.store(false);
+    for(std::thread& t : threads) {
+        t.join();
+    }
+    tr::ClearVisibleReaders();
+
+    uint64_t sum{ 0u };
+    for(uint64_t v : entries) {
+        sum += v;
+    }
+    ASSERT_EQ(counter, sum);
+}
+
+TEST(MemoryTest, LazyLogsAndPooledStorage) {
+    uint64_t words[8]{};
+
+    tr::SetAlgorithm(tr::Algorithm::LOCK_TABLE);
+
+    // Runs a transaction on a new thread and returns the footprints before it, after it and after the thread exited
+    auto run_thread = [&]() {
+        tr::MemoryFootprint footprints[2];
+        std::thread thread{[&]() {
+            tr::ThreadInit();
+            footprints[0] = tr::GetMemoryFootprint();
+            tr::Atomic([&]() {
+                tr::Write(&words[0], tr::Read(&words[0]) + 1u);
+            });
+            footprints[1] = tr::GetMemoryFootprint();
+        }};
+        thread.join();
+        return std::make_pair(footprints[0], footprints[1]);
+    };
+
+    const auto [initial, used] = run_thread();
+    ASSERT_GT(initial.engine_bytes, 0u);
+
+    // Only the logs of the algorithm in use are allocated
+    ASSERT_GT(used.log_bytes, initial.log_bytes);
+    ASSERT_LT(initial.log_bytes, 4096u);
+
+    // The storage of the exited thread is reused by the next one
+    const size_t pooled{ tr::GetMemoryFootprint().pooled_bytes };
+    ASSERT_GE(pooled, used.log_bytes);
+
+    const auto [reused_initial, reused] = run_thread();
+    ASSERT_EQ(reused_initial.pooled_bytes + reused_initial.log_bytes, pooled);
+    ASSERT_EQ(reused.pooled_bytes + reused.log_bytes, pooled);
+    ASSERT_EQ(words[0], 2u);
+}
+
+TEST(PrivatizationTest, FenceWaitsForRunningTransactions) {
+    uint64_t words[8]{};
+
+    tr::SetAlgorithm(tr::Algorithm::LOCK_TABLE);
+    tr::ThreadInit();
+
+    std::atomic<bool> running{ false };
+    std::atomic<bool> release{ false };
+    std::thread writer{[&]() {
+        tr::ThreadInit();
+        tr::Atomic([&]() {
+            tr::Write(&words[0], tr::Read(&words[0]) + 1u);
+            running.store(true);
+            while(!release.load()) {
+                std::this_thread::yield();
+            }
+        });
+    }};
+    while(!running.load()) {
+        std::this_thread::yield();
+    }
+
+    std::atomic<bool> fenced{ false };
+    std::thread fence{[&]() {
+        tr::ThreadInit();
+        tr::PrivatizationFence();
+        fenced.store(true);
+    }};
+
+    // Transactions started after the fence are not waited for
+    tr::Atomic([&]() {
+        tr::Write(&words[4], tr::Read(&words[4]) + 1u);
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_FALSE(fenced.load());
+
+    release.store(true);
+    writer.join();
+    fence.join();
+    ASSERT_TRUE(fenced.load());
+    ASSERT_EQ(words[0], 1u);
+
+    ASSERT_THROW(tr::Atomic([&]() {
+        tr::PrivatizationFence();
+    }), tr::TransactionError);
+}
+
+TEST(PrivatizationTest, AutomaticFence) {
+    uint64_t words[8]{};
+
+    tr::SetAlgorithm(tr::Algorithm::LOCK_TABLE);
+    tr::ThreadInit();
+    tr::SetAutoPrivatization(true);
+    ASSERT_TRUE(tr::IsAutoPrivatization());
+
+    // Every writer fences after its commit so the words can be read directly as soon as it returned
+    std::thread threads[4];
+    for(size_t i{ 0 }; i < 4u; i++) {
+        threads[i] = std::thread{[&, i]() {
+            tr::ThreadInit();
+            for(size_t n{ 0 }; n < 1000u; n++) {
+                tr::Atomic([&]() {
+                    tr::Write(&words[i], tr::Read(&words[i]) + 1u);
+                    tr::Write(&words[4], tr::Read(&words[4]) + 1u);
+                });
+                ASSERT_EQ(words[i], n + 1u);
+            }
+        }};
+    }
+    for(std::thread& t : threads) {
+        t.join();
+    }
+
+    tr::SetAutoPrivatization(false);
+    ASSERT_EQ(words[4], 4000u);
+}
+
+TEST(SiteTest, ReadOnlyStartAndUpgrade) {
+    static tr::Site site{ "ReadOnlyStartAndUpgrade" };
+    uint64_t words[2]{ 1u, 0u };
+
+    tr::SetAlgorithm(tr::Algorithm::LOCK_TABLE);
+    tr::ThreadInit();
+
+    uint64_t sum{ 0u };
+    for(size_t n{ 0 }; n < tr::Site::kWindow; n++) {
+        tr::Atomic(site, [&]() {
+            sum += tr::Read(&words[0]);
+        });
+    }
+    ASSERT_EQ(sum, tr::Site::kWindow);
+    ASSERT_TRUE(site.IsReadOnly());
+
+    // The write restarts the transaction as read-write, also through a nested read-write block
+    tr::Atomic(site, [&]() {
+        tr::Write(&words[1], tr::Read(&words[0]) + 1u);
+    });
+    ASSERT_EQ(words[1], 2u);
+    ASSERT_FALSE(site.IsReadOnly());
+    ASSERT_EQ(site.GetWrites(), 1u);
+
+    // The window with the write has to pass before the site starts read-only again
+    while (site.GetCommits() < 3u * tr::Site::kWindow) {
+        tr::Atomic(site, [&]() {
+            tr::Read(&words[0]);
+        });
+    }
+    ASSERT_TRUE(site.IsReadOnly());
+    tr::Atomic(site, [&]() {
+        tr::Atomic([&]() {
+            tr::Write(&words[1], tr::Read(&words[1]) + 1u);
+        });
+    });
+    ASSERT_EQ(words[1], 3u);
+    ASSERT_EQ(site.GetCommits(), 3u * tr::Site::kWindow + 1u);
+}
+
+TEST(SiteTest, AbortingSiteIsSerialized) {
+    static tr::Site site{ "AbortingSiteIsSerialized" };
+    uint64_t words[2]{};
+
+    tr::SetAlgorithm(tr::Algorithm::LOCK_TABLE);
+    tr::ThreadInit();
+    ASSERT_FALSE(site.IsSerialized());
+    ASSERT_EQ(site.GetTimestampWrites(), 0u);
+
+    // Every commit needs 6 attempts
+    size_t attempts{ 0u };
+    for(size_t n{ 0 }; n < 2u * tr::Site::kWindow; n++) {
+        tr::Atomic(site, [&]() {
+            if ((++attempts % 6u) != 0u) {
+                throw tr::TransactionError{ "Forced abort", true };
+            }
+            tr::Write(&words[0], tr::Read(&words[0]) + 1u);
+            tr::Write(&words[1], tr::Read(&words[1]) + 1u);
+        });
+    }
+    ASSERT_EQ(words[0], 2u * tr::Site::kWindow);
+    ASSERT_EQ(site.GetAborts(), 10u * tr::Site::kWindow);
+    ASSERT_TRUE(site.IsSerialized());
+    ASSERT_FALSE(site.IsReadOnly());
+    ASSERT_EQ(site.GetTimestampWrites(), 1u);
+
+    for(size_t n{ 0 }; n < tr::Site::kWindow; n++) {
+        tr::Atomic(site, [&]() {
+            tr::Write(&words[0], tr::Read(&words[0]) + 1u);
+        });
+    }
+    ASSERT_FALSE(site.IsSerialized());
+    ASSERT_EQ(site.GetTimestampWrites(), 0u);
+}
+
+TEST(SiteTest, ActionsRunUnlocked) {
+    static tr::Site site{ "ActionsRunUnlocked" };
+    uint64_t words[2]{};
+
+    tr::SetAlgorithm(tr::Algorithm::LOCK_TABLE);
+    tr::ThreadInit();
+
+    size_t attempts{ 0u };
+    while (!site.IsSerialized()) {
+        tr::Atomic(site, [&]() {
+            if ((++attempts % 6u) != 0u) {
+                throw tr::TransactionError{ "Forced abort", true };
+            }
+            tr::Write(&words[0], tr::Read(&words[0]) + 1u);
+        });
+    }
+
+    // The actions run transactions at the same site, which is only possible once it is unlocked
+    bool aborted{ false };
+    tr::Atomic(site, [&]() {
+        tr::OnAbort([&]() {
+            tr::Atomic(site, [&]() {
+                tr::Write(&words[1], tr::Read(&words[1]) + 1u);
+            });
+        });
+        tr::OnCommit([&]() {
+            tr::Atomic(site, [&]() {
+                tr::Write(&words[1], tr::Read(&words[1]) + 10u);
+            });
+        });
+
+        if (!aborted) {
+            aborted = true;
+            throw tr::TransactionError{ "Forced abort", true };
+        }
+    });
+    ASSERT_EQ(words[1], 11u);
+}
+
+TEST(SiteTest, RetryAtSerializedSite) {
+    static tr::Site site{ "RetryAtSerializedSite" };
+    uint64_t words[2]{};
+
+    tr::SetAlgorithm(tr::Algorithm::LOCK_TABLE);
+    tr::ThreadInit();
+
+    size_t attempts{ 0u };
+    while (!site.IsSerialized()) {
+        tr::Atomic(site, [&]() {
+            if ((++attempts % 6u) != 0u) {
+                throw tr::TransactionError{ "Forced abort", true };
+            }
+            tr::Write(&words[1], tr::Read(&words[1]) + 1u);
+        });
+    }
+
+    // The consumer blocks in Retry without holding the site, so the producer can run there
+    uint64_t taken{ 0u };
+    std::thread consumer{[&]() {
+        tr::ThreadInit();
+        tr::Atomic(site, [&]() {
+            const uint64_t v{ tr::Read(&words[0]) };
+            if (v == 0u) {
+                tr::Retry();
+            }
+            tr::Write(&words[0], static_cast<uint64_t>(0u));
+            taken = v;
+        });
+    }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    ASSERT_TRUE(site.IsSerialized());
+    tr::Atomic(site, [&]() {
+        tr::Write(&words[0], static_cast<uint64_t>(5u));
+    });
+    consumer.join();
+
+    ASSERT_EQ(taken, 5u);
+    ASSERT_EQ(words[0], 0u);
+}
+
+TEST(BatchTest, SplitOnAbort) {
+    uint64_t words[2]{};
+
+    tr::SetAlgorithm(tr::Algorithm::LOCK_TABLE);
+    tr::ThreadInit();
+
+    tr::Batch batch{};
+    bool aborted{ false };
+    for(size_t n{ 0 }; n < tr::Batch::kMaxGroup; n++) {
+        batch.Add([&, n]() {
+            if ((n == 5u) && !aborted) {
+                aborted = true;
+                throw tr::TransactionError{ "Forced abort", true };
+            }
+            tr::Write(&words[0], tr::Read(&words[0]) + 1u);
+        });
+    }
+
+    // The full queue has been flushed. The group was split and every function committed once.
+    ASSERT_EQ(batch.GetPending(), 0u);
+    ASSERT_TRUE(aborted);
+    ASSERT_EQ(words[0], tr::Batch::kMaxGroup);
+    ASSERT_LT(batch.GetGroupSize(), tr::Batch::kMaxGroup);
+
+    batch.Add([&](tr::Transaction& tx) {
+        tx.Write(&words[1], tx.Read(&words[0]));
+    });
+    batch.Flush();
+    ASSERT_EQ(words[1], tr::Batch::kMaxGroup);
+}
+
+TEST(BatchTest, ReadOnlyAbortKeepsGroupSize) {
+    uint64_t word{ 1u };
+
+    tr::SetAlgorithm(tr::Algorithm::LOCK_TABLE);
+    tr::ThreadInit();
+
+    tr::Batch batch{};
+    bool aborted{ false };
+    uint64_t sum{ 0u };
+    for(size_t n{ 0 }; n < tr::Batch::kMaxGroup; n++) {
+        batch.Add([&, n]() {
+            if ((n == 5u) && !aborted) {
+                aborted = true;
+                throw tr::TransactionError{ "Forced abort", true };
+            }
+            sum += tr::Read(&word);
+        });
+    }
+
+    // The group has been split without writing, so smaller groups would not have helped
+    ASSERT_TRUE(aborted);
+    ASSERT_GE(sum, tr::Batch::kMaxGroup);
+    ASSERT_EQ(batch.GetGroupSize(), tr::Batch::kMaxGroup);
+}
+
+TEST(BatchTest, Hammer) {
+    uint64_t words[5]{};
+
+    tr::SetAlgorithm(tr::Algorithm::LOCK_TABLE);
+    tr::ThreadInit();
+
+    std::thread threads[4];
+    for(size_t i{ 0 }; i < 4u; i++) {
+        threads[i] = std::thread{[&, i]() {
+            tr::ThreadInit();
+            tr::Batch batch{ 16u };
+            for(size_t n{ 0 }; n < 1000u; n++) {
+                batch.Add([&, i]() {
+                    tr::Write(&words[i], tr::Read(&words[i]) + 1u);
+                    tr::Write(&words[4], tr::Read(&words[4]) + 1u);
+                });
+            }
+            batch.Flush();
+        }};
+    }
+    for(std::thread& t : threads) {
+        t.join();
+    }
+
+    for(size_t i{ 0 }; i < 4u; i++) {
+        ASSERT_EQ(words[i], 1000u);
+    }
+    ASSERT_EQ(words[4], 4000u);
+}
+
+TEST(AdaptiveTest, SelectAlgorithm) {
+    using tr::detail::AlgorithmStats;
+    using tr::detail::SelectAlgorithm;
+
+    // commits, aborts, reads, writes
+    ASSERT_EQ(SelectAlgorithm(AlgorithmStats{ 0u, 0u, 0u, 0u }), tr::Algorithm::LOCK_TABLE);
+    ASSERT_EQ(SelectAlgorithm(AlgorithmStats{ 100u, 0u, 800u, 200u }), tr::Algorithm::LOCK_TABLE);
+    ASSERT_EQ(SelectAlgorithm(AlgorithmStats{ 100u, 0u, 800u, 0u }), tr::Algorithm::SEQ_LOCK);
+    ASSERT_EQ(SelectAlgorithm(AlgorithmStats{ 100u, 0u, 12800u, 1u }), tr::Algorithm::RING);
+    ASSERT_EQ(SelectAlgorithm(AlgorithmStats{ 100u, 300u, 3200u, 4000u }), tr::Algorithm::SERIAL);
+    ASSERT_EQ(SelectAlgorithm(AlgorithmStats{ 100u, 300u, 3200u, 400u }), tr::Algorithm::LOCK_TABLE);
+}
+
+TEST(AdaptiveTest, SwitchInsideTransaction) {
+    tr::SetAlgorithm(tr::Algorithm::LOCK_TABLE);
+    tr::ThreadInit();
+
+    bool thrown{ false };
+    tr::AtomicRead([&]() {
+        try {
+            tr::SetAlgorithm(tr::Algorithm::RING);
+        } catch (const tr::TransactionError&) {
+            thrown = true;
+        }
+    });
+
+    ASSERT_TRUE(thrown);
+    ASSERT_EQ(tr::GetAlgorithm(), tr::Algorithm::LOCK_TABLE);
+}
+
+TEST(AdaptiveTest, HammerCorrectness) {
+    constexpr size_t kNumEntries{ 64u };
+    constexpr size_t kNumThreads{ 8u };
+
+    uint64_t entries[kNumEntries];
+    std::thread threads[kNumThreads];
+
+    for(uint64_t& v : entries) {
+        v = 64u;
+    }
+
+    tr::SetAlgorithm(tr::Algorithm::LOCK_TABLE);
+    tr::SetAdaptive(true);
+
+    // Alternates between read only and contended write phases so the algorithm is switched under load
+    std::atomic<bool> run{ false };
+    std::atomic<bool> write_phase{ false };
+    for(std::thread& t : threads) {
+        t = std::thread{[&]() {
+            tr::ThreadInit();
+
+            while(run.load() == false) {
+            }
+
+            uint64_t* e{ entries };
+            while(run.load()) {
+                if(write_phase.load(std::memory_order_relaxed)) {
+                    size_t e1{ util::Rand() % 4u };
+                    size_t e2{ (e1 + 1u) % 4u };
+                    uint64_t amount{ util::Rand() % 32u };
+
+                    tr::Atomic([&]() {
+                        uint64_t v1{ tr::Read(e + e1) };
+
+                        if(v1 >= amount) {
+                            tr::Write(e + e1, v1 - amount);
+                            tr::Write(e + e2, tr::Read(e + e2) + amount);
+                        }
+                    });
+                } else {
+                    uint64_t sum{ 0u };
+                    tr::AtomicRead([&]() {
+                        sum = 0u;
+                        for(size_t i{ 0 }; i < kNumEntries; i++) {
+                            sum += tr::Read(e + i);
+                        }
+                    });
+                    ASSERT_EQ(sum, 64u * kNumEntries);
+                }
+            }
+        }};
+    }
+
+    run.store(true);
+    for(size_t i{ 0 }; i < 8u; i++) {
+        write_phase.store((i % 2u) != 0u);
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    }
+
+    run.store(false);
+    for(std::thread& t : threads) {
+        t.join();
+    }
+
+    tr::SetAdaptive(false);
+    tr::SetAlgorithm(tr::Algorithm::LOCK_TABLE);
+
+    uint64_t sum{ 0u };
+    for(uint64_t v : entries) {
+        sum += v;
+    }
+
+    ASSERT_EQ(sum, 64u * kNumEntries);
+}
+
 } // namespace nlane_test::transactional
\ No newline at end of file